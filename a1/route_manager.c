@@ -11,6 +11,9 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/stat.h>
 
 /**
  * Function: main
@@ -24,7 +27,7 @@
  */
 
 char line[256];
-char fileToRead[20];
+char fileToRead[256];
 
 char airline[20];
 char to_country[20];
@@ -35,17 +38,33 @@ char to_country[20];
 
 char from_city[20];
 
+char queriesFile[256];
+
 // Function Prototypes
 void get_arguments(int a, char *arguments[]);
 
 void two_arguments();
 void three_arguments();
 void four_arguments();
+void batch_queries();
+
+void bloom_open();
+int definite_miss(int type, char *fields[]);
+void bloom_note_route(char routes[][256], int counter);
+void bloom_save();
 
 // Main function
 int main(int argc, char *argv[])
 {
     get_arguments(argc, argv);
+    bloom_open();
+
+    // Batch mode: every query of the --QUERIES file is answered in one scan
+    if (argc == 3 && queriesFile[0] != '\0')
+    {
+        batch_queries();
+        return 1;
+    }
 
     // Use Case 1: There are 2 user arguments to filter
     if (argc == 4)
@@ -75,7 +94,7 @@ int main(int argc, char *argv[])
 /*Function to get arguments from the command line and stores it into variables*/
 void get_arguments(int no_of_args, char *argv[])
 {
-    sscanf(argv[1], "--DATA=%s", fileToRead);
+    sscanf(argv[1], "--DATA=%255s", fileToRead);
 
     // Prints Out an error message if no file is given to access the data
     if (no_of_args < 2)
@@ -89,6 +108,12 @@ void get_arguments(int no_of_args, char *argv[])
         printf("Not enough arguments\n");
     }
 
+    // Takes the file of queries to answer in batch mode.
+    if (no_of_args == 3)
+    {
+        sscanf(argv[2], "--QUERIES=%255s", queriesFile);
+    }
+
     // Takes input from command line of airline, Dest_country to search for.
     if (no_of_args == 4)
     {
@@ -125,6 +150,15 @@ void two_arguments()
     FILE *fw;
     fw = fopen("output.txt", "w");
 
+    // a key the Bloom filter lacks matches no route, so the data is not read
+    char *fields[] = {airline, to_country};
+    if (definite_miss(2, fields))
+    {
+        fputs("NO RESULTS FOUND.\n", fw);
+        fclose(fw);
+        return;
+    }
+
     FILE *file = fopen(fileToRead, "r");
     if (file == NULL)
     {
@@ -152,6 +186,8 @@ void two_arguments()
             token = strtok(NULL, ",");
         }
 
+        bloom_note_route(routes, counter);
+
         // Comparing the inputted data with the array of data
         if (strcmp(airline, routes[1]) == 0)
         {
@@ -174,6 +210,8 @@ void two_arguments()
         fputs("NO RESULTS FOUND.\n", fw);
     }
 
+    bloom_save();
+
     // closing the files after use
     fclose(file);
     fclose(fw);
@@ -190,6 +228,14 @@ void three_arguments()
     FILE *fw;
     fw = fopen("output.txt", "w");
 
+    char *fields[] = {from_country, to_city, to_country};
+    if (definite_miss(3, fields))
+    {
+        fprintf(fw, "NO RESULTS FOUND.\n");
+        fclose(fw);
+        return;
+    }
+
     FILE *file = fopen(fileToRead, "r");
     if (file == NULL)
     {
@@ -216,6 +262,8 @@ void three_arguments()
             token = strtok(NULL, ",");
         }
 
+        bloom_note_route(routes, counter);
+
         // Comparing the inputted data with the array of data
         if (strcmp(from_country, routes[5]) == 0)
         {
@@ -239,6 +287,8 @@ void three_arguments()
         fprintf(fw, "NO RESULTS FOUND.\n");
     }
 
+    bloom_save();
+
     // closing the files after use
     fclose(file);
     fclose(fw);
@@ -258,6 +308,14 @@ void four_arguments()
     int test = 0;
     int count_routes_found = 0;
 
+    char *fields[] = {from_city, from_country, to_city, to_country};
+    if (definite_miss(4, fields))
+    {
+        fprintf(fw, "NO RESULTS FOUND.\n");
+        fclose(fw);
+        return;
+    }
+
     FILE *file = fopen(fileToRead, "r");
     if (file == NULL)
     {
@@ -279,6 +337,8 @@ void four_arguments()
             token = strtok(NULL, ",");
         }
 
+        bloom_note_route(routes, counter);
+
         // Comparing the inputted data with the array of data
         if (strcmp(from_city, routes[4]) == 0)
         {
@@ -305,7 +365,656 @@ void four_arguments()
         fprintf(fw, "NO RESULTS FOUND.\n");
     }
 
+    bloom_save();
+
     // closing the files after use
     fclose(file);
     fclose(fw);
 }
+
+/*
+ * A query read from the --QUERIES file. type is the number of filter
+ * arguments (2, 3 or 4), matching the use cases of the single-query mode,
+ * and key is the composite key its filters select (see composite_key()).
+ * The lines it matches are buffered in out until the scan is over.
+ */
+typedef struct query_t
+{
+    int type;
+    char *airline;
+    char *src_city;
+    char *src_country;
+    char *dest_city;
+    char *dest_country;
+    char *key;
+    unsigned long hash;
+    char *out;
+    size_t len;
+    size_t cap;
+    int invalid;          // the line did not parse
+    struct query_t *next; // next query in the same hash bucket
+} query_t;
+
+#define KEY_SEPARATOR "\x1f"
+
+/*
+ * FNV-1a hash of a string, used to place composite keys in buckets.
+ */
+unsigned long hash_key(const char *key)
+{
+    unsigned long h = 2166136261UL;
+
+    for (; *key != '\0'; key++)
+    {
+        h ^= (unsigned char)*key;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+/*
+ * Builds the composite key for a query type from its filter values, e.g.
+ * "2<US>SWR<US>Argentina". The type prefix keeps keys of different query
+ * types apart. fields holds the values in command-line order.
+ */
+char *composite_key(int type, char *fields[])
+{
+    size_t n = 2;
+    int i;
+
+    for (i = 0; i < type; i++)
+    {
+        n += strlen(fields[i]) + 1;
+    }
+
+    char *key = malloc(n);
+    sprintf(key, "%d", type);
+    for (i = 0; i < type; i++)
+    {
+        strcat(key, KEY_SEPARATOR);
+        strcat(key, fields[i]);
+    }
+    return key;
+}
+
+/*
+ * Builds the composite key of a query type that a route line would match,
+ * from its fields split as in the scans.
+ */
+char *route_key(int type, char routes[][256])
+{
+    char *fields2[] = {routes[1], routes[10]};
+    char *fields3[] = {routes[5], routes[9], routes[10]};
+    char *fields4[] = {routes[4], routes[5], routes[9], routes[10]};
+    char **fields[] = {NULL, NULL, fields2, fields3, fields4};
+
+    return composite_key(type, fields[type]);
+}
+
+/*
+ * Appends formatted text to the buffered output of a query.
+ */
+void query_printf(query_t *q, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (q->len + n + 1 > q->cap)
+    {
+        q->cap = (q->len + n + 1) * 2;
+        q->out = realloc(q->out, q->cap);
+    }
+
+    va_start(args, fmt);
+    vsnprintf(q->out + q->len, n + 1, fmt, args);
+    va_end(args);
+    q->len += n;
+}
+
+/*
+ * Strips surrounding blanks and double quotes from a query value in place.
+ */
+char *trim_value(char *value)
+{
+    char *end;
+
+    while (*value == ' ' || *value == '"')
+    {
+        value++;
+    }
+    end = value + strlen(value);
+    while (end > value && (end[-1] == ' ' || end[-1] == '"' || end[-1] == '\n' || end[-1] == '\r'))
+    {
+        end--;
+    }
+    *end = '\0';
+    return value;
+}
+
+/*
+ * Parses one line of the --QUERIES file, written like the command line of
+ * the single-query mode, e.g.
+ *     --AIRLINE="SWR" --DEST_COUNTRY="Argentina"
+ * Returns 0 if the line does not hold one of the three filter combinations.
+ */
+int parse_query(char *text, query_t *q)
+{
+    char *arg = strstr(text, "--");
+    char *next, *value;
+
+    memset(q, 0, sizeof(query_t));
+
+    while (arg != NULL)
+    {
+        arg += 2;
+        next = strstr(arg, " --");
+        if (next != NULL)
+        {
+            *next = '\0';
+            next++;
+        }
+
+        value = strchr(arg, '=');
+        if (value == NULL)
+        {
+            return 0;
+        }
+        *value++ = '\0';
+        value = strdup(trim_value(value));
+
+        if (strcmp(arg, "AIRLINE") == 0)
+            q->airline = value;
+        else if (strcmp(arg, "SRC_CITY") == 0)
+            q->src_city = value;
+        else if (strcmp(arg, "SRC_COUNTRY") == 0)
+            q->src_country = value;
+        else if (strcmp(arg, "DEST_CITY") == 0)
+            q->dest_city = value;
+        else if (strcmp(arg, "DEST_COUNTRY") == 0)
+            q->dest_country = value;
+        else
+        {
+            free(value);
+            return 0;
+        }
+        arg = next;
+    }
+
+    if (q->dest_country == NULL)
+    {
+        return 0;
+    }
+    if (q->airline != NULL && q->src_city == NULL && q->src_country == NULL && q->dest_city == NULL)
+    {
+        char *fields[] = {q->airline, q->dest_country};
+        q->type = 2;
+        q->key = composite_key(2, fields);
+    }
+    else if (q->airline == NULL && q->src_city == NULL && q->src_country != NULL && q->dest_city != NULL)
+    {
+        char *fields[] = {q->src_country, q->dest_city, q->dest_country};
+        q->type = 3;
+        q->key = composite_key(3, fields);
+    }
+    else if (q->airline == NULL && q->src_city != NULL && q->src_country != NULL && q->dest_city != NULL)
+    {
+        char *fields[] = {q->src_city, q->src_country, q->dest_city, q->dest_country};
+        q->type = 4;
+        q->key = composite_key(4, fields);
+    }
+    else
+    {
+        return 0;
+    }
+
+    q->hash = hash_key(q->key);
+    return 1;
+}
+
+/*
+ * Adds one matching route line to the output of a query, writing the
+ * heading first just like the single-query use cases do.
+ */
+void record_match(query_t *q, char routes[][256])
+{
+    if (q->type == 2)
+    {
+        if (q->len == 0)
+        {
+            query_printf(q, "FLIGHTS TO %s BY %s (%s):\n", q->dest_country, routes[0], q->airline);
+        }
+        query_printf(q, "FROM: %s, %s, %s TO: %s (%s), %s\n", routes[6], routes[4], routes[5], routes[8], routes[11], routes[9]);
+    }
+    else if (q->type == 3)
+    {
+        if (q->len == 0)
+        {
+            query_printf(q, "FLIGHTS FROM %s TO %s, %s:\n", q->src_country, q->dest_city, q->dest_country);
+        }
+        query_printf(q, "AIRLINE: %s (%s) ORIGIN: %s (%s), %s\n", routes[0], routes[1], routes[3], routes[6], routes[4]);
+    }
+    else
+    {
+        if (q->len == 0)
+        {
+            query_printf(q, "FLIGHTS FROM %s, %s TO %s, %s:\n", q->src_city, q->src_country, q->dest_city, q->dest_country);
+        }
+        query_printf(q, "AIRLINE: %s (%s) ROUTE: %s-%s\n", routes[0], routes[1], routes[6], routes[11]);
+    }
+}
+
+/*
+ * A Bloom filter over the composite keys of every route in the data file,
+ * kept beside it as <data>.bloom. A query whose key the filter lacks
+ * matches no route, so it is answered "NO RESULTS FOUND." without reading
+ * the data. The filter records the size and modification time of the data
+ * it was built from; when it is missing or they no longer match, the next
+ * scan of the data notes the keys of every line and writes a new one.
+ *
+ * File layout: BLOOM_MAGIC, then size, mtime seconds, mtime nanoseconds,
+ * the number of bits and the number of hashes (each 8 bytes), then the
+ * bits as 64-bit words.
+ */
+#define BLOOM_MAGIC "A1BLOOM1"
+#define BLOOM_BITS_PER_KEY 10 // with 7 hashes, about 1 false positive in 100
+#define BLOOM_HASHES 7
+
+#define BLOOM_NONE 0     // no filter: every query scans the data
+#define BLOOM_LOADED 1   // an up-to-date filter was read
+#define BLOOM_BUILDING 2 // the next scan builds the filter
+
+typedef struct bloom_t
+{
+    uint64_t header[5]; // size, mtime seconds, mtime nanoseconds, bits, hashes
+    uint64_t *bits;
+    uint64_t *keys; // while building: the hash of every key noted so far
+    size_t nkeys;
+    size_t cap;
+} bloom_t;
+
+bloom_t bloom;
+int bloom_state = BLOOM_NONE;
+char bloomFile[272];
+
+/*
+ * 64-bit FNV-1a hash of a composite key; the filter derives all of its bit
+ * positions from it.
+ */
+uint64_t bloom_hash(const char *key)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (; *key != '\0'; key++)
+    {
+        h ^= (unsigned char)*key;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * The i-th bit position of a key hash (double hashing: low + i * high).
+ */
+uint64_t bloom_bit(uint64_t h, int i)
+{
+    return ((h & 0xffffffffULL) + (uint64_t)i * ((h >> 32) | 1)) % bloom.header[3];
+}
+
+/*
+ * Reads the filter of the data file if it is up to date, and otherwise
+ * arranges for the next scan to build it.
+ */
+void bloom_open()
+{
+    struct stat st;
+    uint64_t header[5];
+    char magic[8];
+
+    if (stat(fileToRead, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return;
+    }
+    bloom.header[0] = (uint64_t)st.st_size;
+    bloom.header[1] = (uint64_t)st.st_mtim.tv_sec;
+    bloom.header[2] = (uint64_t)st.st_mtim.tv_nsec;
+    sprintf(bloomFile, "%s.bloom", fileToRead);
+    bloom_state = BLOOM_BUILDING;
+
+    FILE *bf = fopen(bloomFile, "rb");
+    if (bf == NULL)
+    {
+        return;
+    }
+    if (fread(magic, 1, 8, bf) == 8 && memcmp(magic, BLOOM_MAGIC, 8) == 0 &&
+        fread(header, sizeof(uint64_t), 5, bf) == 5 && memcmp(header, bloom.header, 3 * sizeof(uint64_t)) == 0 &&
+        header[3] > 0 && header[3] % 64 == 0 && header[4] > 0)
+    {
+        bloom.bits = malloc(header[3] / 8);
+        if (fread(bloom.bits, 8, header[3] / 64, bf) == header[3] / 64)
+        {
+            memcpy(bloom.header, header, sizeof(header));
+            bloom_state = BLOOM_LOADED;
+        }
+        else
+        {
+            free(bloom.bits);
+            bloom.bits = NULL;
+        }
+    }
+    fclose(bf);
+}
+
+/*
+ * Returns 0 if no route has the key, 1 if one may (or there is no filter).
+ */
+int bloom_may_contain(const char *key)
+{
+    if (bloom_state != BLOOM_LOADED)
+    {
+        return 1;
+    }
+
+    uint64_t h = bloom_hash(key);
+    for (int i = 0; i < (int)bloom.header[4]; i++)
+    {
+        uint64_t bit = bloom_bit(h, i);
+        if (!(bloom.bits[bit / 64] & (1ULL << (bit % 64))))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Returns 1 if the filter proves that no route matches a single query of
+ * the given type, whose filter values are in command-line order.
+ */
+int definite_miss(int type, char *fields[])
+{
+    char *key = composite_key(type, fields);
+    int miss = !bloom_may_contain(key);
+
+    free(key);
+    return miss;
+}
+
+/*
+ * Notes the composite keys of one route line while the filter is being
+ * built. counter is the number of fields the line was split into.
+ */
+void bloom_note_route(char routes[][256], int counter)
+{
+    if (bloom_state != BLOOM_BUILDING || counter < 12)
+    {
+        return;
+    }
+    for (int type = 2; type <= 4; type++)
+    {
+        if (bloom.nkeys == bloom.cap)
+        {
+            bloom.cap = bloom.cap == 0 ? 4096 : bloom.cap * 2;
+            bloom.keys = realloc(bloom.keys, bloom.cap * sizeof(uint64_t));
+        }
+        char *key = route_key(type, routes);
+        bloom.keys[bloom.nkeys++] = bloom_hash(key);
+        free(key);
+    }
+}
+
+/*
+ * qsort() comparator for key hashes.
+ */
+int compare_hashes(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Once a scan has noted every line, sizes the filter to the distinct keys
+ * seen, sets their bits and writes it beside the data file (through a
+ * temporary file, so a reader never sees half of one). A filter that
+ * cannot be written is simply not kept.
+ */
+void bloom_save()
+{
+    size_t distinct = 0;
+    char tmpFile[280];
+
+    if (bloom_state != BLOOM_BUILDING)
+    {
+        return;
+    }
+    bloom_state = BLOOM_NONE;
+
+    qsort(bloom.keys, bloom.nkeys, sizeof(uint64_t), compare_hashes);
+    for (size_t i = 0; i < bloom.nkeys; i++)
+    {
+        if (i == 0 || bloom.keys[i] != bloom.keys[i - 1])
+        {
+            bloom.keys[distinct++] = bloom.keys[i];
+        }
+    }
+
+    bloom.header[3] = (distinct * BLOOM_BITS_PER_KEY + 63) / 64 * 64;
+    if (bloom.header[3] == 0)
+    {
+        bloom.header[3] = 64;
+    }
+    bloom.header[4] = BLOOM_HASHES;
+    bloom.bits = calloc(bloom.header[3] / 64, sizeof(uint64_t));
+    for (size_t i = 0; i < distinct; i++)
+    {
+        for (int j = 0; j < BLOOM_HASHES; j++)
+        {
+            uint64_t bit = bloom_bit(bloom.keys[i], j);
+            bloom.bits[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+    free(bloom.keys);
+    bloom.keys = NULL;
+
+    sprintf(tmpFile, "%s.tmp", bloomFile);
+    FILE *bf = fopen(tmpFile, "wb");
+    if (bf != NULL)
+    {
+        int ok = fwrite(BLOOM_MAGIC, 1, 8, bf) == 8 && fwrite(bloom.header, sizeof(uint64_t), 5, bf) == 5 &&
+                 fwrite(bloom.bits, 8, bloom.header[3] / 64, bf) == bloom.header[3] / 64;
+        if (fclose(bf) == 0 && ok)
+        {
+            rename(tmpFile, bloomFile);
+        }
+        else
+        {
+            remove(tmpFile);
+        }
+    }
+    free(bloom.bits);
+    bloom.bits = NULL;
+}
+
+/*
+ * Frees the queries of the --QUERIES file and the strings each one holds.
+ */
+void free_queries(query_t *queries, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        free(queries[i].airline);
+        free(queries[i].src_city);
+        free(queries[i].src_country);
+        free(queries[i].dest_city);
+        free(queries[i].dest_country);
+        free(queries[i].key);
+        free(queries[i].out);
+    }
+    free(queries);
+}
+
+/*
+ * This function answers every query of the --QUERIES file in a single pass
+ * over the .csv file. The queries are put in a hash table keyed by their
+ * composite key; each route line builds the (at most three) composite keys
+ * it could match and looks them up, so the scan costs O(1) per line however
+ * many queries there are. The output of query i (counting from 1) is
+ * written to output_i.txt in the same format as output.txt, or reads
+ * "INVALID QUERY." if its line did not parse.
+ */
+void batch_queries()
+{
+    FILE *qf = fopen(queriesFile, "r");
+    if (qf == NULL)
+    {
+        printf("Error: Unable to open file\n");
+        return;
+    }
+
+    query_t *queries = NULL;
+    int count = 0;
+    int cap = 0;
+    int live = 0;
+    int has_type[5] = {0};
+    char text[1024];
+
+    // load every query; blank lines and lines starting with # are ignored
+    while (fgets(text, sizeof(text), qf))
+    {
+        if (strspn(text, " \t\r\n") == strlen(text) || text[0] == '#')
+        {
+            continue;
+        }
+        if (count == cap)
+        {
+            cap = cap == 0 ? 64 : cap * 2;
+            queries = realloc(queries, cap * sizeof(query_t));
+        }
+        if (!parse_query(text, &queries[count]))
+        {
+            printf("Error: Invalid query %d in %s\n", count + 1, queriesFile);
+            queries[count].invalid = 1;
+        }
+        count++;
+    }
+    fclose(qf);
+
+    // queries the Bloom filter rules out are left out of the scan
+    for (int i = 0; i < count; i++)
+    {
+        if (queries[i].type != 0 && bloom_may_contain(queries[i].key))
+        {
+            has_type[queries[i].type] = 1;
+            live++;
+        }
+        else
+        {
+            queries[i].type = 0;
+        }
+    }
+
+    // bucket the queries by composite key
+    size_t nbuckets = 1;
+    while (nbuckets < 2 * (size_t)count)
+    {
+        nbuckets *= 2;
+    }
+    query_t **buckets = calloc(nbuckets, sizeof(query_t *));
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (queries[i].type != 0)
+        {
+            query_t **b = &buckets[queries[i].hash & (nbuckets - 1)];
+            queries[i].next = *b;
+            *b = &queries[i];
+        }
+    }
+
+    // the data is only read if some query may match (or the filter is being built)
+    FILE *file = NULL;
+    if (live > 0 || bloom_state != BLOOM_LOADED)
+    {
+        file = fopen(fileToRead, "r");
+        if (file == NULL)
+        {
+            printf("Error: Unable to open file\n");
+            free_queries(queries, count);
+            free(buckets);
+            return;
+        }
+    }
+
+    // loop to read the csv file line by line
+    while (file != NULL && fgets(line, sizeof(line), file))
+    {
+        int counter = 0;
+        char routes[14][256];
+        char *token = strtok(line, ",");
+
+        // loop seperate the data in to an array
+        while (token != NULL && counter < 14)
+        {
+            strcpy(routes[counter], token);
+            counter++;
+            token = strtok(NULL, ",");
+        }
+        if (counter < 12)
+        {
+            continue;
+        }
+        bloom_note_route(routes, counter);
+
+        for (int type = 2; type <= 4; type++)
+        {
+            if (!has_type[type])
+            {
+                continue;
+            }
+            char *key = route_key(type, routes);
+            unsigned long h = hash_key(key);
+
+            for (query_t *q = buckets[h & (nbuckets - 1)]; q != NULL; q = q->next)
+            {
+                if (q->hash == h && strcmp(q->key, key) == 0)
+                {
+                    record_match(q, routes);
+                }
+            }
+            free(key);
+        }
+    }
+    if (file != NULL)
+    {
+        bloom_save();
+        fclose(file);
+    }
+
+    // one output file per query, in the order of the --QUERIES file
+    for (int i = 0; i < count; i++)
+    {
+        char name[64];
+        sprintf(name, "output_%d.txt", i + 1);
+
+        FILE *fw = fopen(name, "w");
+        if (queries[i].invalid)
+        {
+            fputs("INVALID QUERY.\n", fw);
+        }
+        else if (queries[i].len == 0)
+        {
+            fputs("NO RESULTS FOUND.\n", fw);
+        }
+        else
+        {
+            fwrite(queries[i].out, 1, queries[i].len, fw);
+        }
+        fclose(fw);
+    }
+    free_queries(queries, count);
+    free(buckets);
+}
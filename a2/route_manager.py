@@ -10,8 +10,16 @@ Sample input: --AIRLINES="airlines.yaml" --AIRPORTS="airports.yaml" --ROUTES="ro
 import yaml
 import pandas as pd
 import sys
+import csv
 import matplotlib.pyplot as plt
 
+# The native route engine (built with `make python` in ../a3 and found through
+# PYTHONPATH) answers every question without going through yaml and pandas.
+try:
+    import routemanager
+except ImportError:
+    routemanager = None
+
 def inputData() -> str:
     """Gets the input from command line and stores them in variables
 
@@ -157,6 +165,38 @@ def pieChart(fileToRead:str, fileToWrite:str, title:str) -> None:
 
     plt.savefig(fileToWrite)
 
+def nativeAnswer(question: str, airlinesData: str, airportsData: str, routesData: str) -> bool:
+    """Writes the answer to a question with the native engine, if it is available
+
+    Parameters
+    ----------
+    question: str
+        the question to answer, q1 to q5
+    airlinesData: str
+        contains the name of the datafile airlines.yaml
+    airportsData: str
+        contains the name of the datafile airports.yaml
+    routesData: str
+        contains the name of the datafile routes.yaml
+
+    Returns
+    -------
+    bool
+        True if the answer was written to <question>.csv, False if pandas has to answer it
+
+    """
+    if routemanager is None or airlinesData is None:
+        return False
+
+    dataset = routemanager.load(airlinesData, airportsData, routesData)
+
+    with open(question + '.csv', 'w', newline='') as f:
+        writer = csv.writer(f, lineterminator='\n')
+        writer.writerow(['subject', 'statistic'])
+        writer.writerows(dataset.answer(question))
+
+    return True
+
 def q1(airlinesData: str, airportsData: str, routesData: str, graph_type: str) -> None:
     """This function produces the answer for q1
 
@@ -177,24 +217,26 @@ def q1(airlinesData: str, airportsData: str, routesData: str, graph_type: str) -
 
     """
 
-    # Calling the function readYamlFiles and saving the result in merged_df
-    merged_df = readYamlFiles(airlinesData, airportsData, routesData)
-    merged_df.loc[:, 'airline_name'] = merged_df['airline_name'] + ' (' + merged_df['airline_icao_unique_code'] + ')'
+    # The native engine answers directly when it is available
+    if not nativeAnswer('q1', airlinesData, airportsData, routesData):
+        # Calling the function readYamlFiles and saving the result in merged_df
+        merged_df = readYamlFiles(airlinesData, airportsData, routesData)
+        merged_df.loc[:, 'airline_name'] = merged_df['airline_name'] + ' (' + merged_df['airline_icao_unique_code'] + ')'
 
-    # Dropping the fields not requiered by us to answer the question
-    merged_df.drop(['airline_country', 'route_from_aiport_id', 'airport_name', 'airport_city','route_airline_id', 'airport_altitude', 'airport_icao_unique_code', 'airline_id'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question
+        merged_df.drop(['airline_country', 'route_from_aiport_id', 'airport_name', 'airport_city','route_airline_id', 'airport_altitude', 'airport_icao_unique_code', 'airline_id'], inplace=True, axis=1)
 
-    # Sorting all the countries with destination as canada
-    canada_routes_df = merged_df[merged_df['airport_country'] == 'Canada']
+        # Sorting all the countries with destination as canada
+        canada_routes_df = merged_df[merged_df['airport_country'] == 'Canada']
 
-    # Counting the data from airline_name and sorting it by the number of occorences
-    answer_df = canada_routes_df.groupby(by=['airline_name'], as_index=False).size().sort_values(by=['size', 'airline_name'], ascending=[False, True]).head(20)
+        # Counting the data from airline_name and sorting it by the number of occorences
+        answer_df = canada_routes_df.groupby(by=['airline_name'], as_index=False).size().sort_values(by=['size', 'airline_name'], ascending=[False, True]).head(20)
 
-    # Renaming the columns
-    answer_df = answer_df.rename(columns={'airline_name': 'subject', 'size': 'statistic'})
+        # Renaming the columns
+        answer_df = answer_df.rename(columns={'airline_name': 'subject', 'size': 'statistic'})
 
-    # Print the resulting DataFrame to a .csv file
-    answer_df.to_csv("q1.csv", index=False)
+        # Print the resulting DataFrame to a .csv file
+        answer_df.to_csv("q1.csv", index=False)
 
     #Graphs of Q1
     if (graph_type == 'bar'):
@@ -231,20 +273,22 @@ def q2(airlinesData: str, airportsData: str, routesData: str, graph_type: str) -
 
     """
 
-    # Calling the function readYamlFiles and saving the result in merged_df
-    merged_df = readYamlFiles(airlinesData, airportsData, routesData)
+    # The native engine answers directly when it is available
+    if not nativeAnswer('q2', airlinesData, airportsData, routesData):
+        # Calling the function readYamlFiles and saving the result in merged_df
+        merged_df = readYamlFiles(airlinesData, airportsData, routesData)
 
-    # Dropping the fields not requiered by us to answer the question
-    merged_df.drop(['airline_country', 'airline_icao_unique_code', 'route_from_aiport_id', 'airport_name','airport_city', 'route_airline_id', 'airport_altitude', 'airport_icao_unique_code'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question
+        merged_df.drop(['airline_country', 'airline_icao_unique_code', 'route_from_aiport_id', 'airport_name','airport_city', 'route_airline_id', 'airport_altitude', 'airport_icao_unique_code'], inplace=True, axis=1)
 
-    # Print the resulting DataFrame to a .csv file
-    answer = merged_df.groupby(['airport_country'], as_index=False).size().sort_values(by=['size', 'airport_country'], ascending=[True, True]).head(30)
+        # Print the resulting DataFrame to a .csv file
+        answer = merged_df.groupby(['airport_country'], as_index=False).size().sort_values(by=['size', 'airport_country'], ascending=[True, True]).head(30)
 
-    # Renaming the columns
-    answer = answer.rename(columns={'airport_country': 'subject', 'size': 'statistic'})
+        # Renaming the columns
+        answer = answer.rename(columns={'airport_country': 'subject', 'size': 'statistic'})
 
-    # Print the resulting DataFrame to a .csv file
-    answer.to_csv("q2.csv", index=False)
+        # Print the resulting DataFrame to a .csv file
+        answer.to_csv("q2.csv", index=False)
 
     # Graphs of Q2
     if (graph_type == 'bar'):
@@ -280,23 +324,25 @@ def q3(airlinesData: str, airportsData: str, routesData: str, graph_type: str) -
     None
 
     """
-    # Calling the function readYamlFiles and saving the result in merged_df(pd.DataFrame)
-    merged_df = readYamlFiles(airlinesData, airportsData, routesData)
+    # The native engine answers directly when it is available
+    if not nativeAnswer('q3', airlinesData, airportsData, routesData):
+        # Calling the function readYamlFiles and saving the result in merged_df(pd.DataFrame)
+        merged_df = readYamlFiles(airlinesData, airportsData, routesData)
 
-    # Setting the data in the requiered format
-    merged_df['airport_name'] = merged_df['airport_name'].astype(str) + ' (' + merged_df['airport_icao_unique_code'].astype(str) + '), ' + merged_df['airport_city'].astype(str) + ', ' + merged_df['airport_country'].astype(str)
+        # Setting the data in the requiered format
+        merged_df['airport_name'] = merged_df['airport_name'].astype(str) + ' (' + merged_df['airport_icao_unique_code'].astype(str) + '), ' + merged_df['airport_city'].astype(str) + ', ' + merged_df['airport_country'].astype(str)
 
-    # Dropping the fields not requiered by us to answer the question
-    merged_df.drop(['airline_country', 'airline_icao_unique_code', 'route_from_aiport_id', 'route_airline_id','airport_altitude', 'route_to_airport_id', 'airport_id', 'airline_name'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question
+        merged_df.drop(['airline_country', 'airline_icao_unique_code', 'route_from_aiport_id', 'route_airline_id','airport_altitude', 'route_to_airport_id', 'airport_id', 'airline_name'], inplace=True, axis=1)
 
-    # Grouping the field, counting the no of times it comes and then arranging it in order
-    destination_df = merged_df.groupby(by=['airport_name'], as_index=False).size().sort_values(by=['size', 'airport_name'], ascending=[False, True]).head(10)
+        # Grouping the field, counting the no of times it comes and then arranging it in order
+        destination_df = merged_df.groupby(by=['airport_name'], as_index=False).size().sort_values(by=['size', 'airport_name'], ascending=[False, True]).head(10)
 
-    # Renaming the columns
-    answer_df = destination_df.rename(columns={'airport_name': 'subject', 'size': 'statistic'})
+        # Renaming the columns
+        answer_df = destination_df.rename(columns={'airport_name': 'subject', 'size': 'statistic'})
 
-    # Print the resulting DataFrame to a .csv file
-    answer_df.to_csv("q3.csv", index=False)
+        # Print the resulting DataFrame to a .csv file
+        answer_df.to_csv("q3.csv", index=False)
 
     #Graphs of Q3
     if (graph_type == 'bar'):
@@ -333,26 +379,28 @@ def q4(airlinesData: str, airportsData: str, routesData: str, graph_type: str) -
 
     """
 
-    # Calling the function readYamlFiles and saving the result in merged_df
-    merged_df = readYamlFiles(airlinesData, airportsData, routesData)
+    # The native engine answers directly when it is available
+    if not nativeAnswer('q4', airlinesData, airportsData, routesData):
+        # Calling the function readYamlFiles and saving the result in merged_df
+        merged_df = readYamlFiles(airlinesData, airportsData, routesData)
 
-    # Dropping the fields not requiered by us to answer the question
-    merged_df.drop(['route_from_aiport_id', 'route_airline_id', 'airport_altitude','route_to_airport_id', 'airport_id'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question
+        merged_df.drop(['route_from_aiport_id', 'route_airline_id', 'airport_altitude','route_to_airport_id', 'airport_id'], inplace=True, axis=1)
 
-    # Grouping the field, counting the no of times it comes and then arranging it in order
-    destination_df = merged_df.groupby(['airport_city', 'airport_country'], as_index=False).size().sort_values(by=['size', 'airport_city'], ascending=[False, True]).head(15)
+        # Grouping the field, counting the no of times it comes and then arranging it in order
+        destination_df = merged_df.groupby(['airport_city', 'airport_country'], as_index=False).size().sort_values(by=['size', 'airport_city'], ascending=[False, True]).head(15)
 
-    # Setting the data in the requiered format
-    destination_df.loc[:, 'airport_city'] = destination_df['airport_city'] + ', ' + destination_df['airport_country']
+        # Setting the data in the requiered format
+        destination_df.loc[:, 'airport_city'] = destination_df['airport_city'] + ', ' + destination_df['airport_country']
 
-    # Dropping the fields not requiered by us to answer the question
-    destination_df.drop(['airport_country'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question
+        destination_df.drop(['airport_country'], inplace=True, axis=1)
 
-    # Renaming the columns
-    answer_df = destination_df.rename(columns={'airport_city': 'subject', 'size': 'statistic'})
+        # Renaming the columns
+        answer_df = destination_df.rename(columns={'airport_city': 'subject', 'size': 'statistic'})
 
-    # Print the resulting DataFrame to a .csv file
-    answer_df.to_csv("q4.csv", index=False)
+        # Print the resulting DataFrame to a .csv file
+        answer_df.to_csv("q4.csv", index=False)
 
     #Graphs of Q4
     if (graph_type == 'bar'):
@@ -370,7 +418,7 @@ def q4(airlinesData: str, airportsData: str, routesData: str, graph_type: str) -
         pieChart(csvFile, nameForPDF, title)
 
 
-def q5(airportsData: str, routesData: str, graph_type: str) -> None:
+def q5(airportsData: str, routesData: str, graph_type: str, airlinesData: str = None) -> None:
     """This function produces the answer for q5
 
     Parameters
@@ -381,6 +429,8 @@ def q5(airportsData: str, routesData: str, graph_type: str) -> None:
         contains the name of the datafile routes.yaml
     graph_type: str
         contains information on which graph to make
+    airlinesData: str
+        contains the name of the datafile airlines.yaml (only used by the native engine)
         
     Returns
     -------
@@ -388,59 +438,61 @@ def q5(airportsData: str, routesData: str, graph_type: str) -> None:
 
     """
 
-    with open(airportsData) as f:
-        airports_dict = yaml.safe_load('\n'.join(f.readlines()[1:]))
+    # The native engine answers directly when it is available
+    if not nativeAnswer('q5', airlinesData, airportsData, routesData):
+        with open(airportsData) as f:
+            airports_dict = yaml.safe_load('\n'.join(f.readlines()[1:]))
 
-    with open(routesData) as f:
-        routes_dict = yaml.safe_load('\n'.join(f.readlines()[1:]))
+        with open(routesData) as f:
+            routes_dict = yaml.safe_load('\n'.join(f.readlines()[1:]))
 
-    # Create pandas DataFrames for airports and routes
-    airports_df = pd.DataFrame(airports_dict)
-    routes_df = pd.DataFrame(routes_dict)
+        # Create pandas DataFrames for airports and routes
+        airports_df = pd.DataFrame(airports_dict)
+        routes_df = pd.DataFrame(routes_dict)
 
-    # Join the airports and routes DataFrames to get destination airport altitudes
-    merged_df = pd.merge(routes_df, airports_df,left_on='route_to_airport_id', right_on='airport_id')
-    merged_df = merged_df.rename(columns={'airport_altitude': 'destinition_altitude', 'airport_icao_unique_code': 'dest_code'})
+        # Join the airports and routes DataFrames to get destination airport altitudes
+        merged_df = pd.merge(routes_df, airports_df,left_on='route_to_airport_id', right_on='airport_id')
+        merged_df = merged_df.rename(columns={'airport_altitude': 'destinition_altitude', 'airport_icao_unique_code': 'dest_code'})
 
-    # Sorting the data by only Canada as destination county
-    merged_df = merged_df[merged_df['airport_country'] == 'Canada']
+        # Sorting the data by only Canada as destination county
+        merged_df = merged_df[merged_df['airport_country'] == 'Canada']
 
-    # Dropping the fields not requiered by us to answer the question
-    merged_df.drop(['airport_id', 'airport_city', 'airport_country','route_to_airport_id'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question
+        merged_df.drop(['airport_id', 'airport_city', 'airport_country','route_to_airport_id'], inplace=True, axis=1)
 
-    # Join the previously merged destination and routes DataFrames to get origin airport altitudes
-    routes_with_altitudes = pd.merge(merged_df, airports_df, left_on='route_from_aiport_id', right_on='airport_id')
-    routes_with_altitudes = routes_with_altitudes.rename(columns={'airport_altitude': 'origin_altitude', 'airport_icao_unique_code': 'origin_code'})
+        # Join the previously merged destination and routes DataFrames to get origin airport altitudes
+        routes_with_altitudes = pd.merge(merged_df, airports_df, left_on='route_from_aiport_id', right_on='airport_id')
+        routes_with_altitudes = routes_with_altitudes.rename(columns={'airport_altitude': 'origin_altitude', 'airport_icao_unique_code': 'origin_code'})
 
-    # Changing the datafields datatype to int from str 
-    routes_with_altitudes['destinition_altitude'] = pd.to_numeric(routes_with_altitudes['destinition_altitude'], errors='coerce')
-    routes_with_altitudes['origin_altitude'] = pd.to_numeric(routes_with_altitudes['origin_altitude'], errors='coerce')
+        # Changing the datafields datatype to int from str 
+        routes_with_altitudes['destinition_altitude'] = pd.to_numeric(routes_with_altitudes['destinition_altitude'], errors='coerce')
+        routes_with_altitudes['origin_altitude'] = pd.to_numeric(routes_with_altitudes['origin_altitude'], errors='coerce')
 
-    # Calculating the altitude difference
-    routes_with_altitudes['altitude_diff'] = routes_with_altitudes['destinition_altitude'] - routes_with_altitudes['origin_altitude']
-    routes_with_altitudes['altitude_diff'] = routes_with_altitudes['altitude_diff'].abs()
+        # Calculating the altitude difference
+        routes_with_altitudes['altitude_diff'] = routes_with_altitudes['destinition_altitude'] - routes_with_altitudes['origin_altitude']
+        routes_with_altitudes['altitude_diff'] = routes_with_altitudes['altitude_diff'].abs()
 
-    # Sorting the data by only Canada as destination county
-    routes_with_altitudes = routes_with_altitudes[routes_with_altitudes['airport_country'] == 'Canada']
+        # Sorting the data by only Canada as destination county
+        routes_with_altitudes = routes_with_altitudes[routes_with_altitudes['airport_country'] == 'Canada']
 
-    # Dropping the fields not requiered by us to answer the question    
-    routes_with_altitudes.drop(['route_airline_id', 'airport_id', 'airport_city', 'route_from_aiport_id','airport_name_x', 'airport_name_y', 'airport_country'], inplace=True, axis=1)
+        # Dropping the fields not requiered by us to answer the question    
+        routes_with_altitudes.drop(['route_airline_id', 'airport_id', 'airport_city', 'route_from_aiport_id','airport_name_x', 'airport_name_y', 'airport_country'], inplace=True, axis=1)
 
-    # Setting the data in the requiered format
-    routes_with_altitudes.loc[:, 'RoutePairDtoO'] = routes_with_altitudes['origin_code'] + '-' + routes_with_altitudes['dest_code']
+        # Setting the data in the requiered format
+        routes_with_altitudes.loc[:, 'RoutePairDtoO'] = routes_with_altitudes['origin_code'] + '-' + routes_with_altitudes['dest_code']
 
-    # Grouping the field, counting the no of times it comes and then arranging it in order
-    routes_with_altitudes = routes_with_altitudes.groupby(by=['RoutePairDtoO', 'altitude_diff'], as_index=False).size().sort_values(by=['altitude_diff', 'RoutePairDtoO'], ascending=[False, False]).head(10)
+        # Grouping the field, counting the no of times it comes and then arranging it in order
+        routes_with_altitudes = routes_with_altitudes.groupby(by=['RoutePairDtoO', 'altitude_diff'], as_index=False).size().sort_values(by=['altitude_diff', 'RoutePairDtoO'], ascending=[False, False]).head(10)
     
-    # Dropping all the duplicate routes
-    routes_with_altitudes = routes_with_altitudes.drop_duplicates(subset=['RoutePairDtoO']).reset_index(drop=True)
-    routes_with_altitudes.drop(['size'], inplace=True, axis=1)
+        # Dropping all the duplicate routes
+        routes_with_altitudes = routes_with_altitudes.drop_duplicates(subset=['RoutePairDtoO']).reset_index(drop=True)
+        routes_with_altitudes.drop(['size'], inplace=True, axis=1)
 
-    # Renaming the columns
-    answer_df = routes_with_altitudes.rename(columns={'RoutePairDtoO': 'subject', 'altitude_diff': 'statistic'})
+        # Renaming the columns
+        answer_df = routes_with_altitudes.rename(columns={'RoutePairDtoO': 'subject', 'altitude_diff': 'statistic'})
 
-    # Print the resulting DataFrame to a .csv file
-    answer_df.to_csv("q5.csv", index=False)
+        # Print the resulting DataFrame to a .csv file
+        answer_df.to_csv("q5.csv", index=False)
 
     #Graphs of Q5
     if (graph_type == 'bar'):
@@ -476,7 +528,7 @@ def main():
         q4(airlines_path, airports_path, routes_path, graph_type)
 
     elif (question == "q5"):
-        q5(airports_path, routes_path, graph_type)
+        q5(airports_path, routes_path, graph_type, airlines_path)
 
 
 if __name__ == '__main__':
@@ -0,0 +1,404 @@
+/** @file aggregate.c
+ *  @brief Implementation of aggregate.h
+ *
+ * Spilled runs are plain binary files made of (length, key bytes, count)
+ * records in key order. Merging them yields exactly the sequence the
+ * in-memory table would have produced, so callers cannot tell whether the
+ * limit was ever hit.
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "emalloc.h"
+#include "aggregate.h"
+
+// approximate heap footprint of one distinct key in the table, which is at
+// most half full
+#define ENTRY_BYTES(key) (2 * sizeof(strmap_entry_t) + strlen(key) + 1 + sizeof(size_t))
+
+// runs kept open before they are merged down into a single run
+#define MAX_RUNS 64
+
+/**
+ * @brief The read position of one run while merging.
+ */
+typedef struct
+{
+    FILE *fp;
+    char *key;
+    size_t cap;
+    int count;
+} run_t;
+
+/**
+ * Function:  agg_init
+ * -------------------
+ * @brief  Prepares an empty aggregation table.
+ *
+ * @param agg The table to initialise.
+ * @param limit The number of bytes the table may hold before spilling (0 for no limit).
+ *
+ */
+void agg_init(agg_t *agg, size_t limit)
+{
+    agg->table.entries = NULL;
+    agg->table.size = 0;
+    agg->table.cap = 0;
+    agg->bytes = 0;
+    agg->limit = limit;
+    agg->runs = NULL;
+    agg->nruns = 0;
+    agg->cap = 0;
+}
+
+/**
+ * Function:  open_run
+ * -------------------
+ * @brief  Creates an anonymous temporary file under $TMPDIR (or /tmp).
+ *
+ * @return FILE* The open file, already unlinked so it vanishes on close.
+ *
+ */
+static FILE *open_run(void)
+{
+    const char *dir = getenv("TMPDIR");
+    char path[4096];
+    FILE *fp;
+    int fd;
+
+    if (dir == NULL || dir[0] == '\0')
+    {
+        dir = "/tmp";
+    }
+    snprintf(path, sizeof(path), "%s/route_manager.XXXXXX", dir);
+
+    fd = mkstemp(path);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create spill file in %s\n", dir);
+        exit(1);
+    }
+    unlink(path);
+
+    fp = fdopen(fd, "w+b");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Failed to create spill file in %s\n", dir);
+        exit(1);
+    }
+
+    return fp;
+}
+
+/**
+ * Function:  write_record
+ * -----------------------
+ * @brief  Appends one (key, count) record to a run.
+ *
+ * @param key The key of the record.
+ * @param count The count of the record.
+ * @param arg The FILE* of the run being written.
+ *
+ */
+static void write_record(char *key, int count, void *arg)
+{
+    FILE *fp = (FILE *)arg;
+    size_t len = strlen(key);
+
+    fwrite(&len, sizeof(len), 1, fp);
+    fwrite(key, 1, len, fp);
+    fwrite(&count, sizeof(count), 1, fp);
+}
+
+static void merge_runs(FILE **files, int nfiles, void (*fn)(char *, int, void *), void *arg);
+
+/**
+ * Function:  report_table
+ * -----------------------
+ * @brief  Reports every key of the in-memory table in strcmp() order, then empties it.
+ *
+ * @param agg The table to report.
+ * @param fn The function called once per distinct key.
+ * @param arg The argument passed through to fn.
+ *
+ */
+static void report_table(agg_t *agg, void (*fn)(char *, int, void *), void *arg)
+{
+    strmap_entry_t **sorted = strmap_sorted(&agg->table);
+    size_t i;
+
+    for (i = 0; i < agg->table.size; i++)
+    {
+        fn(sorted[i]->key, (int)(uintptr_t)sorted[i]->value, arg);
+    }
+    efree(sorted);
+    strmap_free(&agg->table, NULL);
+    agg->bytes = 0;
+}
+
+/**
+ * Function:  spill
+ * ----------------
+ * @brief  Writes the in-memory table out as a sorted run and empties it.
+ *
+ * Once MAX_RUNS runs exist they are merged into one, so the number of open
+ * temporary files stays bounded however small the limit is.
+ *
+ * @param agg The table to spill.
+ *
+ */
+static void spill(agg_t *agg)
+{
+    FILE *fp = open_run();
+
+    report_table(agg, write_record, fp);
+    if (fflush(fp) != 0)
+    {
+        fprintf(stderr, "Failed to write spill file\n");
+        exit(1);
+    }
+
+    if (agg->nruns == agg->cap)
+    {
+        agg->cap = agg->cap == 0 ? 8 : agg->cap * 2;
+        agg->runs = (FILE **)erealloc(MEM_SCRATCH, agg->runs, agg->cap * sizeof(FILE *));
+    }
+    agg->runs[agg->nruns++] = fp;
+
+    if (agg->nruns == MAX_RUNS)
+    {
+        fp = open_run();
+        merge_runs(agg->runs, agg->nruns, write_record, fp);
+        if (fflush(fp) != 0)
+        {
+            fprintf(stderr, "Failed to write spill file\n");
+            exit(1);
+        }
+        agg->runs[0] = fp;
+        agg->nruns = 1;
+    }
+}
+
+/**
+ * Function:  agg_add
+ * ------------------
+ * @brief  Counts one more occurrence of a key.
+ *
+ * @param agg The table to add to.
+ * @param key The key to count.
+ *
+ */
+void agg_add(agg_t *agg, char *key)
+{
+    strmap_entry_t *e;
+    int created;
+
+    if (agg->table.entries == NULL)
+    {
+        strmap_init(&agg->table, 64);
+    }
+
+    e = strmap_insert(&agg->table, key, &created);
+    e->value = (void *)((uintptr_t)e->value + 1);
+    if (!created)
+    {
+        return;
+    }
+
+    agg->bytes += ENTRY_BYTES(key);
+    if (agg->limit > 0 && agg->bytes > agg->limit)
+    {
+        spill(agg);
+    }
+}
+
+/**
+ * Function:  next_record
+ * ----------------------
+ * @brief  Reads the next record of a run.
+ *
+ * @param run The run to advance.
+ *
+ * @return int 1 if a record was read, 0 at the end of the run.
+ *
+ */
+static int next_record(run_t *run)
+{
+    size_t len;
+
+    if (fread(&len, sizeof(len), 1, run->fp) != 1)
+    {
+        return 0;
+    }
+    if (len + 1 > run->cap)
+    {
+        run->cap = len + 1;
+        run->key = (char *)erealloc(MEM_SCRATCH, run->key, run->cap);
+    }
+    if (fread(run->key, 1, len, run->fp) != len ||
+        fread(&run->count, sizeof(run->count), 1, run->fp) != 1)
+    {
+        fprintf(stderr, "Failed to read spill file\n");
+        exit(1);
+    }
+    run->key[len] = '\0';
+
+    return 1;
+}
+
+/**
+ * Function:  sift_down
+ * --------------------
+ * @brief  Restores the min-heap property of the merge heap from a given slot.
+ *
+ * @param runs The runs being merged.
+ * @param heap The heap of run indices, ordered by current key.
+ * @param size The number of runs in the heap.
+ * @param i The slot to sift down from.
+ *
+ */
+static void sift_down(run_t *runs, int *heap, int size, int i)
+{
+    int smallest, left, right, temp;
+
+    for (;;)
+    {
+        smallest = i;
+        left = 2 * i + 1;
+        right = left + 1;
+
+        if (left < size && strcmp(runs[heap[left]].key, runs[heap[smallest]].key) < 0)
+        {
+            smallest = left;
+        }
+        if (right < size && strcmp(runs[heap[right]].key, runs[heap[smallest]].key) < 0)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+
+        temp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = temp;
+        i = smallest;
+    }
+}
+
+/**
+ * Function:  merge_runs
+ * ---------------------
+ * @brief  K-way merges sorted runs, summing the counts of keys found in several runs.
+ *
+ * @param files The runs to merge; they are closed once merged.
+ * @param nfiles The number of runs.
+ * @param fn The function called once per distinct key, in strcmp() order.
+ * @param arg The argument passed through to fn.
+ *
+ */
+static void merge_runs(FILE **files, int nfiles, void (*fn)(char *, int, void *), void *arg)
+{
+    run_t *runs = (run_t *)emalloc(nfiles * sizeof(run_t));
+    int *heap = (int *)emalloc(nfiles * sizeof(int));
+    int size = 0;
+    char *key = NULL;
+    size_t cap = 0;
+    int total = 0;
+    int i;
+
+    for (i = 0; i < nfiles; i++)
+    {
+        runs[i].fp = files[i];
+        runs[i].key = NULL;
+        runs[i].cap = 0;
+        rewind(runs[i].fp);
+        if (next_record(&runs[i]))
+        {
+            heap[size++] = i;
+        }
+    }
+    for (i = size / 2 - 1; i >= 0; i--)
+    {
+        sift_down(runs, heap, size, i);
+    }
+
+    while (size > 0)
+    {
+        run_t *top = &runs[heap[0]];
+
+        if (key != NULL && strcmp(top->key, key) == 0)
+        {
+            total += top->count;
+        }
+        else
+        {
+            if (key != NULL)
+            {
+                fn(key, total, arg);
+            }
+            if (strlen(top->key) + 1 > cap)
+            {
+                cap = strlen(top->key) + 1;
+                key = (char *)erealloc(MEM_SCRATCH, key, cap);
+            }
+            strcpy(key, top->key);
+            total = top->count;
+        }
+
+        if (!next_record(top))
+        {
+            heap[0] = heap[--size];
+        }
+        sift_down(runs, heap, size, 0);
+    }
+    if (key != NULL)
+    {
+        fn(key, total, arg);
+    }
+
+    for (i = 0; i < nfiles; i++)
+    {
+        fclose(runs[i].fp);
+        efree(runs[i].key);
+    }
+    efree(runs);
+    efree(heap);
+    efree(key);
+}
+
+/**
+ * Function:  agg_finish
+ * ---------------------
+ * @brief  Reports every distinct key with its total count, in strcmp() order, and empties the table.
+ *
+ * @param agg The table to finish.
+ * @param fn The function called once per distinct key.
+ * @param arg The argument passed through to fn.
+ *
+ */
+void agg_finish(agg_t *agg, void (*fn)(char *key, int count, void *), void *arg)
+{
+    if (agg->nruns == 0)
+    {
+        if (agg->table.entries != NULL)
+        {
+            report_table(agg, fn, arg);
+        }
+        agg_init(agg, agg->limit);
+        return;
+    }
+
+    if (agg->table.entries != NULL)
+    {
+        spill(agg);
+    }
+    merge_runs(agg->runs, agg->nruns, fn, arg);
+
+    efree(agg->runs);
+    agg_init(agg, agg->limit);
+}
@@ -0,0 +1,36 @@
+/** @file aggregate.h
+ *  @brief Function prototypes for the grouped counting table.
+ *
+ */
+#ifndef _AGGREGATE_H_
+#define _AGGREGATE_H_
+
+#include <stdio.h>
+#include "strmap.h"
+
+/**
+ * @brief A struct that counts how many times each key was added.
+ *
+ * Keys are counted in a hash map, and only sorted into strcmp() order when
+ * they are reported. When a memory limit is set and the map grows past it,
+ * its keys are written out as a sorted run to a temporary file and the map
+ * is emptied; agg_finish() then merges the runs back together.
+ */
+typedef struct agg_t
+{
+    strmap_t table;
+    size_t bytes;
+    size_t limit;
+    FILE **runs;
+    int nruns;
+    int cap;
+} agg_t;
+
+/**
+ * Function protypes associated with an aggregation table.
+ */
+void agg_init(agg_t *, size_t limit);
+void agg_add(agg_t *, char *key);
+void agg_finish(agg_t *, void (*fn)(char *key, int count, void *), void *arg);
+
+#endif
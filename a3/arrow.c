@@ -0,0 +1,1149 @@
+/** @file arrow.c
+ *  @brief Arrow IPC files of routes and answers (the rm_export_arrow() and rm_rows_ functions of routemanager.h).
+ *
+ * An Arrow IPC file (also read as Feather version 2) is the magic "ARROW1",
+ * a schema message, one dictionary batch per dictionary-encoded column, one
+ * record batch, an end-of-stream marker, and a footer locating them, so
+ * pyarrow and pandas can memory-map the columns instead of parsing text.
+ * Each message is a 0xFFFFFFFF marker, the length of its metadata, the
+ * metadata as a FlatBuffer, and a body of buffers padded to 8 bytes.
+ *
+ * The FlatBuffers are built here front to back rather than with the
+ * flatc-generated builders: every table is written before the objects it
+ * points to, which only needs offsets patched in once the objects exist.
+ * They are little-endian whatever the host; the bodies are in the host's
+ * byte order, which the schema declares.
+ *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "strmap.h"
+#include "dataset.h"
+#include "routemanager.h"
+
+#define ARROW_MAGIC "ARROW1"
+
+// the metadata version the messages follow (MetadataVersion.V5)
+#define METADATA_V5 4
+
+// the MessageHeader and Type unions of the Arrow schema
+#define HEADER_SCHEMA 1
+#define HEADER_DICTIONARY_BATCH 2
+#define HEADER_RECORD_BATCH 3
+#define TYPE_INT 2
+#define TYPE_FLOATING_POINT 3
+#define TYPE_UTF8 5
+#define PRECISION_DOUBLE 2
+
+// no table here has more fields than a Field
+#define MAX_TABLE_FIELDS 7
+
+// an answer has at most a partition, a subject, a statistic and an error column
+#define MAX_ROW_COLUMNS 8
+
+// marks a string that decodes to a YAML null while exporting
+#define NULL_WORD (UINT32_MAX - 1)
+
+/**
+ * @brief A FlatBuffer being built.
+ */
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} fb_t;
+
+/**
+ * @brief The scalar fields of one table; offsets are 4-byte fields patched after table_end().
+ */
+typedef struct
+{
+    int nfields;
+    int size[MAX_TABLE_FIELDS]; // 0 for a field left out
+    uint64_t value[MAX_TABLE_FIELDS];
+    size_t at[MAX_TABLE_FIELDS]; // where each field ended up
+} fb_table_t;
+
+/**
+ * @brief How the values of a column are stored.
+ */
+typedef enum
+{
+    COLUMN_DICTIONARY,
+    COLUMN_FLOAT64,
+    COLUMN_INT64
+} column_kind_t;
+
+/**
+ * @brief One column of the file, with its dictionary when it is dictionary-encoded.
+ */
+typedef struct
+{
+    const char *name;
+    column_kind_t kind;
+    unsigned char *validity; // NULL when no value is null
+    size_t nulls;
+    void *values;            // int32 indices, doubles or int64s
+    int32_t *offsets;        // the dictionary: nwords + 1 offsets into chars
+    char *chars;
+    size_t nwords;
+    size_t nchars;
+    size_t words_cap;
+    size_t chars_cap;
+} column_t;
+
+/**
+ * @brief One buffer of a message body.
+ */
+typedef struct
+{
+    const void *data;
+    size_t length;
+} piece_t;
+
+/**
+ * @brief Where one message of the file is, as the footer records it.
+ */
+typedef struct
+{
+    int64_t offset;
+    int32_t meta_length;
+    int64_t body_length;
+} block_t;
+
+/**
+ * @brief The rows of an answer, collected by rm_rows_add().
+ */
+struct rows_t
+{
+    char **rows;
+    size_t nrows;
+    size_t cap;
+};
+
+/**
+ * Function:  fb_grow
+ * ------------------
+ * @brief  Appends zeroed bytes to a FlatBuffer.
+ *
+ * @param fb The buffer.
+ * @param n The number of bytes.
+ *
+ * @return size_t Where the new bytes start.
+ *
+ */
+static size_t fb_grow(fb_t *fb, size_t n)
+{
+    size_t at = fb->len;
+
+    if (fb->len + n > fb->cap)
+    {
+        while (fb->len + n > fb->cap)
+        {
+            fb->cap = fb->cap == 0 ? 1024 : 2 * fb->cap;
+        }
+        fb->data = (unsigned char *)erealloc(MEM_SCRATCH, fb->data, fb->cap);
+    }
+    memset(fb->data + at, 0, n);
+    fb->len += n;
+    return at;
+}
+
+/**
+ * Function:  fb_pad
+ * -----------------
+ * @brief  Pads a FlatBuffer with zeros until (its length + extra) is a multiple of align.
+ *
+ * @param fb The buffer.
+ * @param align The alignment wanted.
+ * @param extra The bytes that will come before the aligned object.
+ *
+ */
+static void fb_pad(fb_t *fb, size_t align, size_t extra)
+{
+    while ((fb->len + extra) % align != 0)
+    {
+        fb_grow(fb, 1);
+    }
+}
+
+/**
+ * Function:  fb_put
+ * -----------------
+ * @brief  Stores an unsigned number of size bytes, little-endian, at a position of a FlatBuffer.
+ *
+ * @param fb The buffer.
+ * @param at The position.
+ * @param size The number of bytes (1 to 8).
+ * @param value The number.
+ *
+ */
+static void fb_put(fb_t *fb, size_t at, int size, uint64_t value)
+{
+    int i;
+
+    for (i = 0; i < size; i++)
+    {
+        fb->data[at + i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+/**
+ * Function:  fb_point
+ * -------------------
+ * @brief  Makes the offset field at one position refer to an object written after it.
+ *
+ * @param fb The buffer.
+ * @param at The offset field.
+ * @param target Where the object starts.
+ *
+ */
+static void fb_point(fb_t *fb, size_t at, size_t target)
+{
+    fb_put(fb, at, 4, target - at);
+}
+
+/**
+ * Function:  table_add
+ * --------------------
+ * @brief  Sets one field of a table about to be written.
+ *
+ * @param t The fields of the table.
+ * @param id The field's number in the schema.
+ * @param size The field's size in bytes (4 for an offset, patched later).
+ * @param value The field's value (0 for an offset).
+ *
+ */
+static void table_add(fb_table_t *t, int id, int size, uint64_t value)
+{
+    t->size[id] = size;
+    t->value[id] = value;
+    if (id + 1 > t->nfields)
+    {
+        t->nfields = id + 1;
+    }
+}
+
+/**
+ * Function:  table_end
+ * --------------------
+ * @brief  Writes a table's vtable and then the table, widest fields first so each is aligned.
+ *
+ * @param fb The buffer.
+ * @param t The fields; at is filled in.
+ *
+ * @return size_t Where the table starts.
+ *
+ */
+static size_t table_end(fb_t *fb, fb_table_t *t)
+{
+    size_t field_at[MAX_TABLE_FIELDS];
+    size_t inline_size = 4;
+    size_t vtable, start;
+    int size, id;
+
+    for (size = 8; size >= 1; size /= 2)
+    {
+        for (id = 0; id < t->nfields; id++)
+        {
+            if (t->size[id] == size)
+            {
+                inline_size = (inline_size + size - 1) / size * size;
+                field_at[id] = inline_size;
+                inline_size += size;
+            }
+        }
+    }
+
+    fb_pad(fb, 2, 0);
+    vtable = fb_grow(fb, 4 + 2 * t->nfields);
+    fb_put(fb, vtable, 2, 4 + 2 * t->nfields);
+    fb_put(fb, vtable + 2, 2, inline_size);
+    for (id = 0; id < t->nfields; id++)
+    {
+        fb_put(fb, vtable + 4 + 2 * id, 2, t->size[id] != 0 ? field_at[id] : 0);
+    }
+
+    // the table starts 8-aligned, so its 8-byte fields are too
+    fb_pad(fb, 8, 0);
+    start = fb_grow(fb, inline_size);
+    fb_put(fb, start, 4, start - vtable);
+    for (id = 0; id < t->nfields; id++)
+    {
+        if (t->size[id] != 0)
+        {
+            t->at[id] = start + field_at[id];
+            fb_put(fb, t->at[id], t->size[id], t->value[id]);
+        }
+    }
+    return start;
+}
+
+/**
+ * Function:  fb_vector
+ * --------------------
+ * @brief  Writes the length of a vector and room for its elements.
+ *
+ * @param fb The buffer.
+ * @param count The number of elements.
+ * @param elem_size The size of an element.
+ * @param align The alignment the elements need.
+ *
+ * @return size_t Where the length is; the elements follow it.
+ *
+ */
+static size_t fb_vector(fb_t *fb, size_t count, size_t elem_size, size_t align)
+{
+    size_t at;
+
+    fb_pad(fb, align > 4 ? align : 4, 4);
+    at = fb_grow(fb, 4 + count * elem_size);
+    fb_put(fb, at, 4, count);
+    return at;
+}
+
+/**
+ * Function:  fb_string
+ * --------------------
+ * @brief  Writes a string: its length, its bytes and a terminating NUL.
+ *
+ * @param fb The buffer.
+ * @param s The string.
+ *
+ * @return size_t Where the string starts.
+ *
+ */
+static size_t fb_string(fb_t *fb, const char *s)
+{
+    size_t len = strlen(s);
+    size_t at = fb_vector(fb, len + 1, 1, 4);
+
+    fb_put(fb, at, 4, len);
+    memcpy(fb->data + at + 4, s, len);
+    return at;
+}
+
+/**
+ * Function:  int_type
+ * -------------------
+ * @brief  Writes the Int table of a signed integer type.
+ *
+ * @param fb The buffer.
+ * @param bits The width of the integers.
+ *
+ * @return size_t Where the table starts.
+ *
+ */
+static size_t int_type(fb_t *fb, int bits)
+{
+    fb_table_t t = {0};
+
+    table_add(&t, 0, 4, bits); // bitWidth
+    table_add(&t, 1, 1, 1);    // is_signed
+    return table_end(fb, &t);
+}
+
+/**
+ * Function:  write_field
+ * ----------------------
+ * @brief  Writes the Field table describing one column.
+ *
+ * @param fb The buffer.
+ * @param column The column.
+ * @param id The column's dictionary id, if it has a dictionary.
+ *
+ * @return size_t Where the table starts.
+ *
+ */
+static size_t write_field(fb_t *fb, const column_t *column, int id)
+{
+    fb_table_t field = {0};
+    fb_table_t type = {0};
+    fb_table_t encoding = {0};
+    size_t at, type_at, encoding_at;
+
+    table_add(&field, 0, 4, 0); // name
+    table_add(&field, 1, 1, 1); // nullable
+    table_add(&field, 2, 1, column->kind == COLUMN_FLOAT64 ? TYPE_FLOATING_POINT
+                            : column->kind == COLUMN_INT64 ? TYPE_INT
+                                                            : TYPE_UTF8);
+    table_add(&field, 3, 4, 0); // type
+    if (column->kind == COLUMN_DICTIONARY)
+    {
+        table_add(&field, 4, 4, 0); // dictionary
+    }
+    table_add(&field, 5, 4, 0); // children (required, even when empty)
+    at = table_end(fb, &field);
+
+    fb_point(fb, field.at[0], fb_string(fb, column->name));
+    if (column->kind == COLUMN_FLOAT64)
+    {
+        table_add(&type, 0, 2, PRECISION_DOUBLE);
+        type_at = table_end(fb, &type);
+    }
+    else if (column->kind == COLUMN_INT64)
+    {
+        type_at = int_type(fb, 64);
+    }
+    else
+    {
+        type_at = table_end(fb, &type); // Utf8 has no fields
+    }
+    fb_point(fb, field.at[3], type_at);
+
+    if (column->kind == COLUMN_DICTIONARY)
+    {
+        table_add(&encoding, 0, 8, id); // id
+        table_add(&encoding, 1, 4, 0);  // indexType
+        encoding_at = table_end(fb, &encoding);
+        fb_point(fb, field.at[4], encoding_at);
+        fb_point(fb, encoding.at[1], int_type(fb, 32));
+    }
+    fb_point(fb, field.at[5], fb_vector(fb, 0, 4, 4));
+    return at;
+}
+
+/**
+ * Function:  write_schema
+ * -----------------------
+ * @brief  Writes the Schema table of the columns; column c uses dictionary id c.
+ *
+ * @param fb The buffer.
+ * @param columns The columns.
+ * @param ncolumns The number of columns.
+ *
+ * @return size_t Where the table starts.
+ *
+ */
+static size_t write_schema(fb_t *fb, const column_t *columns, int ncolumns)
+{
+    const uint16_t probe = 1;
+    fb_table_t schema = {0};
+    size_t at, fields;
+    int c;
+
+    if (*(const unsigned char *)&probe == 0)
+    {
+        table_add(&schema, 0, 2, 1); // endianness: Big
+    }
+    table_add(&schema, 1, 4, 0); // fields
+    at = table_end(fb, &schema);
+
+    fields = fb_vector(fb, ncolumns, 4, 4);
+    fb_point(fb, schema.at[1], fields);
+    for (c = 0; c < ncolumns; c++)
+    {
+        fb_point(fb, fields + 4 + 4 * c, write_field(fb, &columns[c], c));
+    }
+    return at;
+}
+
+/**
+ * Function:  body_length
+ * ----------------------
+ * @brief  Adds up the length of a message body: its buffers, each padded to 8 bytes.
+ *
+ * @param pieces The buffers.
+ * @param npieces The number of buffers.
+ *
+ * @return int64_t The length.
+ *
+ */
+static int64_t body_length(const piece_t *pieces, int npieces)
+{
+    int64_t length = 0;
+    int i;
+
+    for (i = 0; i < npieces; i++)
+    {
+        length += (pieces[i].length + 7) / 8 * 8;
+    }
+    return length;
+}
+
+/**
+ * Function:  start_message
+ * ------------------------
+ * @brief  Starts the FlatBuffer of a message: its root and the Message table.
+ *
+ * @param fb The (empty) buffer.
+ * @param header_type What the message holds.
+ * @param length The length of the message body.
+ *
+ * @return size_t The header field, to point at the header table.
+ *
+ */
+static size_t start_message(fb_t *fb, int header_type, int64_t length)
+{
+    fb_table_t message = {0};
+    size_t root = fb_grow(fb, 4);
+
+    table_add(&message, 0, 2, METADATA_V5);
+    table_add(&message, 1, 1, header_type);
+    table_add(&message, 2, 4, 0); // header
+    table_add(&message, 3, 8, length);
+    fb_point(fb, root, table_end(fb, &message));
+    return message.at[2];
+}
+
+/**
+ * Function:  write_batch
+ * ----------------------
+ * @brief  Writes a RecordBatch table: one node per column and where each of its buffers is in the body.
+ *
+ * @param fb The buffer.
+ * @param length The number of rows.
+ * @param nodes Each column's length and null count, in pairs.
+ * @param nnodes The number of columns.
+ * @param pieces The buffers of the body, in order.
+ * @param npieces The number of buffers.
+ *
+ * @return size_t Where the table starts.
+ *
+ */
+static size_t write_batch(fb_t *fb, int64_t length, const int64_t *nodes, int nnodes, const piece_t *pieces,
+                          int npieces)
+{
+    fb_table_t batch = {0};
+    size_t at, vector;
+    int64_t offset = 0;
+    int i;
+
+    table_add(&batch, 0, 8, length);
+    table_add(&batch, 1, 4, 0); // nodes
+    table_add(&batch, 2, 4, 0); // buffers
+    at = table_end(fb, &batch);
+
+    vector = fb_vector(fb, nnodes, 16, 8);
+    fb_point(fb, batch.at[1], vector);
+    for (i = 0; i < nnodes; i++)
+    {
+        fb_put(fb, vector + 4 + 16 * i, 8, nodes[2 * i]);
+        fb_put(fb, vector + 12 + 16 * i, 8, nodes[2 * i + 1]);
+    }
+
+    vector = fb_vector(fb, npieces, 16, 8);
+    fb_point(fb, batch.at[2], vector);
+    for (i = 0; i < npieces; i++)
+    {
+        fb_put(fb, vector + 4 + 16 * i, 8, offset);
+        fb_put(fb, vector + 12 + 16 * i, 8, pieces[i].length);
+        offset += (pieces[i].length + 7) / 8 * 8;
+    }
+    return at;
+}
+
+/**
+ * Function:  write_u32
+ * --------------------
+ * @brief  Writes a 32-bit number to a file, little-endian.
+ *
+ * @param fp The file.
+ * @param value The number.
+ *
+ */
+static void write_u32(FILE *fp, uint32_t value)
+{
+    unsigned char bytes[4];
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    fwrite(bytes, 1, 4, fp);
+}
+
+/**
+ * Function:  write_message
+ * ------------------------
+ * @brief  Writes a message to the file: marker, metadata length, metadata, body.
+ *
+ * @param fp The file.
+ * @param fb The metadata, which is emptied.
+ * @param pieces The buffers of the body.
+ * @param npieces The number of buffers.
+ * @param block Set to where the message is, if not NULL.
+ *
+ */
+static void write_message(FILE *fp, fb_t *fb, const piece_t *pieces, int npieces, block_t *block)
+{
+    static const unsigned char zeros[8] = {0};
+    int64_t offset = ftell(fp);
+    int i;
+
+    // the body must start 8-aligned, after the 8-byte prefix
+    fb_pad(fb, 8, 0);
+    write_u32(fp, 0xFFFFFFFF);
+    write_u32(fp, fb->len);
+    fwrite(fb->data, 1, fb->len, fp);
+    for (i = 0; i < npieces; i++)
+    {
+        if (pieces[i].length > 0)
+        {
+            fwrite(pieces[i].data, 1, pieces[i].length, fp);
+        }
+        fwrite(zeros, 1, (8 - pieces[i].length % 8) % 8, fp);
+    }
+
+    if (block != NULL)
+    {
+        block->offset = offset;
+        block->meta_length = (int32_t)(8 + fb->len);
+        block->body_length = body_length(pieces, npieces);
+    }
+    fb->len = 0;
+}
+
+/**
+ * Function:  write_blocks
+ * -----------------------
+ * @brief  Writes a vector of the footer's Block structs.
+ *
+ * @param fb The buffer.
+ * @param blocks Where the messages are.
+ * @param nblocks The number of messages.
+ *
+ * @return size_t Where the vector starts.
+ *
+ */
+static size_t write_blocks(fb_t *fb, const block_t *blocks, int nblocks)
+{
+    size_t vector = fb_vector(fb, nblocks, 24, 8);
+    int i;
+
+    for (i = 0; i < nblocks; i++)
+    {
+        fb_put(fb, vector + 4 + 24 * i, 8, blocks[i].offset);
+        fb_put(fb, vector + 12 + 24 * i, 4, blocks[i].meta_length);
+        fb_put(fb, vector + 20 + 24 * i, 8, blocks[i].body_length);
+    }
+    return vector;
+}
+
+/**
+ * Function:  write_file
+ * ---------------------
+ * @brief  Writes columns of equal length as an Arrow IPC file.
+ *
+ * @param path Where to write it.
+ * @param columns The columns.
+ * @param ncolumns The number of columns.
+ * @param nrows The length of every column.
+ *
+ * @return int 0: No errors; 1: The file could not be written.
+ *
+ */
+static int write_file(const char *path, const column_t *columns, int ncolumns, size_t nrows)
+{
+    piece_t pieces[3 * MAX_ROW_COLUMNS + 3 * FIELD_COUNT];
+    int64_t nodes[2 * (MAX_ROW_COLUMNS + FIELD_COUNT)];
+    block_t blocks[MAX_ROW_COLUMNS + FIELD_COUNT + 1];
+    fb_t fb = {NULL, 0, 0};
+    fb_table_t footer = {0};
+    fb_table_t dictionary;
+    size_t header, at, bitmap = (nrows + 7) / 8;
+    int c, n, ndictionaries = 0;
+    int failed;
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL)
+    {
+        return 1;
+    }
+    fwrite(ARROW_MAGIC "\0\0", 1, 8, fp);
+
+    header = start_message(&fb, HEADER_SCHEMA, 0);
+    fb_point(&fb, header, write_schema(&fb, columns, ncolumns));
+    write_message(fp, &fb, NULL, 0, NULL);
+
+    for (c = 0; c < ncolumns; c++)
+    {
+        if (columns[c].kind != COLUMN_DICTIONARY)
+        {
+            continue;
+        }
+        pieces[0] = (piece_t){NULL, 0};
+        pieces[1] = (piece_t){columns[c].offsets, (columns[c].nwords + 1) * sizeof(int32_t)};
+        pieces[2] = (piece_t){columns[c].chars, columns[c].nchars};
+        nodes[0] = (int64_t)columns[c].nwords;
+        nodes[1] = 0;
+
+        header = start_message(&fb, HEADER_DICTIONARY_BATCH, body_length(pieces, 3));
+        memset(&dictionary, 0, sizeof(dictionary));
+        table_add(&dictionary, 0, 8, c); // id
+        table_add(&dictionary, 1, 4, 0); // data
+        at = table_end(&fb, &dictionary);
+        fb_point(&fb, header, at);
+        fb_point(&fb, dictionary.at[1], write_batch(&fb, columns[c].nwords, nodes, 1, pieces, 3));
+        write_message(fp, &fb, pieces, 3, &blocks[ndictionaries++]);
+    }
+
+    for (c = 0, n = 0; c < ncolumns; c++)
+    {
+        nodes[2 * c] = (int64_t)nrows;
+        nodes[2 * c + 1] = (int64_t)columns[c].nulls;
+        pieces[n++] = (piece_t){columns[c].validity, columns[c].validity != NULL ? bitmap : 0};
+        pieces[n++] = (piece_t){columns[c].values, nrows * (columns[c].kind == COLUMN_DICTIONARY ? 4 : 8)};
+    }
+    header = start_message(&fb, HEADER_RECORD_BATCH, body_length(pieces, n));
+    fb_point(&fb, header, write_batch(&fb, nrows, nodes, ncolumns, pieces, n));
+    write_message(fp, &fb, pieces, n, &blocks[ndictionaries]);
+    write_u32(fp, 0xFFFFFFFF);
+    write_u32(fp, 0);
+
+    // the footer repeats the schema and locates every batch
+    fb_grow(&fb, 4);
+    table_add(&footer, 0, 2, METADATA_V5);
+    table_add(&footer, 1, 4, 0); // schema
+    table_add(&footer, 2, 4, 0); // dictionaries
+    table_add(&footer, 3, 4, 0); // recordBatches
+    fb_point(&fb, 0, table_end(&fb, &footer));
+    fb_point(&fb, footer.at[1], write_schema(&fb, columns, ncolumns));
+    fb_point(&fb, footer.at[2], write_blocks(&fb, blocks, ndictionaries));
+    fb_point(&fb, footer.at[3], write_blocks(&fb, blocks + ndictionaries, 1));
+    fwrite(fb.data, 1, fb.len, fp);
+    write_u32(fp, fb.len);
+    fwrite(ARROW_MAGIC, 1, 6, fp);
+
+    efree(fb.data);
+    failed = ferror(fp) != 0;
+    failed |= fclose(fp) != 0;
+    if (failed)
+    {
+        remove(path);
+    }
+    return failed;
+}
+
+/**
+ * Function:  add_word
+ * -------------------
+ * @brief  Appends a string to the dictionary of a column.
+ *
+ * @param column The column.
+ * @param word The string.
+ *
+ * @return int32_t The string's index in the dictionary.
+ *
+ */
+static int32_t add_word(column_t *column, const char *word)
+{
+    size_t len = strlen(word);
+
+    if (column->nwords + 2 > column->words_cap)
+    {
+        column->words_cap = column->words_cap == 0 ? 256 : 2 * column->words_cap;
+        column->offsets = (int32_t *)erealloc(MEM_SCRATCH, column->offsets, column->words_cap * sizeof(int32_t));
+    }
+    while (column->nchars + len > column->chars_cap)
+    {
+        column->chars_cap = column->chars_cap == 0 ? 4096 : 2 * column->chars_cap;
+        column->chars = (char *)erealloc(MEM_SCRATCH, column->chars, column->chars_cap);
+    }
+    memcpy(column->chars + column->nchars, word, len);
+    column->offsets[column->nwords] = (int32_t)column->nchars;
+    column->nchars += len;
+    column->offsets[++column->nwords] = (int32_t)column->nchars;
+    return (int32_t)column->nwords - 1;
+}
+
+/**
+ * Function:  start_column
+ * -----------------------
+ * @brief  Prepares an empty column with room for its values and a validity bitmap of all valid rows.
+ *
+ * @param column The column to initialise.
+ * @param name The column's name.
+ * @param kind How its values are stored.
+ * @param nrows The number of rows.
+ *
+ */
+static void start_column(column_t *column, const char *name, column_kind_t kind, size_t nrows)
+{
+    memset(column, 0, sizeof(*column));
+    column->name = name;
+    column->kind = kind;
+    column->values = emalloc_as(MEM_SCRATCH, nrows * (kind == COLUMN_DICTIONARY ? 4 : 8) + 1);
+    column->validity = (unsigned char *)emalloc_as(MEM_SCRATCH, (nrows + 7) / 8 + 1);
+    memset(column->validity, 0xFF, (nrows + 7) / 8 + 1);
+    if (kind == COLUMN_DICTIONARY)
+    {
+        column->words_cap = 256;
+        column->offsets = (int32_t *)emalloc_as(MEM_SCRATCH, column->words_cap * sizeof(int32_t));
+        column->offsets[0] = 0;
+    }
+}
+
+/**
+ * Function:  set_null
+ * -------------------
+ * @brief  Marks one row of a column null.
+ *
+ * @param column The column.
+ * @param row The row.
+ *
+ */
+static void set_null(column_t *column, size_t row)
+{
+    column->validity[row / 8] &= (unsigned char)~(1u << (row % 8));
+    column->nulls++;
+}
+
+/**
+ * Function:  free_columns
+ * -----------------------
+ * @brief  Releases the buffers of some columns.
+ *
+ * @param columns The columns.
+ * @param ncolumns The number of columns.
+ *
+ */
+static void free_columns(column_t *columns, int ncolumns)
+{
+    int c;
+
+    for (c = 0; c < ncolumns; c++)
+    {
+        efree(columns[c].values);
+        efree(columns[c].validity);
+        efree(columns[c].offsets);
+        efree(columns[c].chars);
+    }
+}
+
+/**
+ * Function:  rm_export_arrow
+ * --------------------------
+ * @brief  Writes the loaded fields of a dataset, one row per route, as an Arrow IPC (Feather) file.
+ *
+ * Values are decoded as a YAML loader decodes them. The two altitude fields
+ * become float64 columns, null where a value is not a number; every other
+ * field becomes a dictionary-encoded string column holding each of its
+ * values once. Missing values are null.
+ *
+ * @param ds The dataset.
+ * @param path Where to write the file.
+ *
+ * @return int 0: No errors; 1: The file could not be written.
+ *
+ */
+int rm_export_arrow(const rm_dataset_t *ds, const char *path)
+{
+    column_t columns[FIELD_COUNT];
+    char value[MAX_VALUE_LENGTH];
+    uint32_t *remap = (uint32_t *)emalloc_as(MEM_SCRATCH, (size_t)ds->nstrings * sizeof(uint32_t));
+    column_t *column;
+    int ncolumns = 0;
+    int failed, f;
+    uint32_t id;
+    char *decoded, *end;
+    size_t r;
+
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        if ((ds->fields & FIELD_BIT(f)) == 0)
+        {
+            continue;
+        }
+        column = &columns[ncolumns++];
+        if (f == FIELD_FROM_ALTITUDE || f == FIELD_TO_ALTITUDE)
+        {
+            start_column(column, FIELD_NAMES[f], COLUMN_FLOAT64, ds->nroutes);
+            for (r = 0; r < ds->nroutes; r++)
+            {
+                strcpy(value, dataset_value(ds, f, r));
+                decoded = dataset_decode(value);
+                ((double *)column->values)[r] = decoded != NULL ? strtod(decoded, &end) : 0;
+                if (decoded == NULL || end == decoded || *end != '\0')
+                {
+                    ((double *)column->values)[r] = 0;
+                    set_null(column, r);
+                }
+            }
+            continue;
+        }
+
+        // each column's dictionary holds the values it uses, in order of first use
+        start_column(column, FIELD_NAMES[f], COLUMN_DICTIONARY, ds->nroutes);
+        memset(remap, 0xFF, (size_t)ds->nstrings * sizeof(uint32_t));
+        for (r = 0; r < ds->nroutes; r++)
+        {
+            id = ds->columns[f][r];
+            if (id != MISSING_ID && remap[id] == UINT32_MAX)
+            {
+                strcpy(value, dataset_string(ds, id));
+                decoded = dataset_decode(value);
+                remap[id] = decoded != NULL ? (uint32_t)add_word(column, decoded) : NULL_WORD;
+            }
+            if (id == MISSING_ID || remap[id] == NULL_WORD)
+            {
+                ((int32_t *)column->values)[r] = 0;
+                set_null(column, r);
+                continue;
+            }
+            ((int32_t *)column->values)[r] = (int32_t)remap[id];
+        }
+    }
+    efree(remap);
+
+    for (f = 0; f < ncolumns; f++)
+    {
+        if (columns[f].nulls == 0)
+        {
+            efree(columns[f].validity);
+            columns[f].validity = NULL;
+        }
+    }
+    failed = write_file(path, columns, ncolumns, ds->nroutes);
+    free_columns(columns, ncolumns);
+    return failed;
+}
+
+/**
+ * Function:  rm_rows_new
+ * ----------------------
+ * @brief  Starts collecting the lines of an answer, to be passed as the arg of rm_rows_add().
+ *
+ * @return rm_rows_t* The empty collection.
+ *
+ */
+rm_rows_t *rm_rows_new(void)
+{
+    rm_rows_t *rows = (rm_rows_t *)emalloc_as(MEM_SCRATCH, sizeof(rm_rows_t));
+
+    rows->rows = NULL;
+    rows->nrows = 0;
+    rows->cap = 0;
+    return rows;
+}
+
+/**
+ * Function:  rm_rows_add
+ * ----------------------
+ * @brief  rm_row_fn keeping a copy of each line of an answer.
+ *
+ * @param row The line.
+ * @param arg The rm_rows_t.
+ *
+ */
+void rm_rows_add(const char *row, void *arg)
+{
+    rm_rows_t *rows = (rm_rows_t *)arg;
+
+    if (rows->nrows == rows->cap)
+    {
+        rows->cap = rows->cap == 0 ? 16 : 2 * rows->cap;
+        rows->rows = (char **)erealloc(MEM_SCRATCH, rows->rows, rows->cap * sizeof(char *));
+    }
+    rows->rows[rows->nrows++] = estrdup(MEM_SCRATCH, row);
+}
+
+/**
+ * Function:  split_row
+ * --------------------
+ * @brief  Splits an answer row into its columns in place.
+ *
+ * Answers are written as they are ranked rather than as strict CSV: only
+ * the wide column (the subject) may hold commas, and a subject holding
+ * commas is wrapped in quotes that are not escaped inside, as in
+ * ""Capit\xE1n ..." (SLGY), "Guayaramer\xEDn", Bolivia". So the columns
+ * before it end at the first commas, those after it start at the last
+ * ones, and it keeps the rest without its wrapping quotes.
+ *
+ * @param line The row, overwritten.
+ * @param cells Set to the columns.
+ * @param ncolumns The number of columns.
+ * @param wide The column that may hold commas.
+ *
+ * @return int 0: No errors; 1: The row has fewer columns.
+ *
+ */
+static int split_row(char *line, char **cells, int ncolumns, int wide)
+{
+    char *end = line + strlen(line);
+    char *comma;
+    int c;
+
+    for (c = 0; c < wide; c++)
+    {
+        comma = strchr(line, ',');
+        if (comma == NULL)
+        {
+            return 1;
+        }
+        *comma = '\0';
+        cells[c] = line;
+        line = comma + 1;
+    }
+    for (c = ncolumns - 1; c > wide; c--)
+    {
+        comma = (char *)memrchr(line, ',', end - line);
+        if (comma == NULL)
+        {
+            return 1;
+        }
+        *comma = '\0';
+        cells[c] = comma + 1;
+        end = comma;
+    }
+    if (end - line >= 2 && line[0] == '"' && end[-1] == '"' && memchr(line, ',', end - line) != NULL)
+    {
+        end[-1] = '\0';
+        line++;
+    }
+    cells[wide] = line;
+    return 0;
+}
+
+/**
+ * Function:  column_kind
+ * ----------------------
+ * @brief  Returns the type an answer column is written as.
+ *
+ * @param name The column's name in the header.
+ *
+ * @return column_kind_t The type.
+ *
+ */
+static column_kind_t column_kind(const char *name)
+{
+    static const char *const floats[] = {"p50", "p90", "p99", "lower", "upper"};
+    size_t i;
+
+    if (strcmp(name, "statistic") == 0 || strcmp(name, "error") == 0 || strcmp(name, "margin") == 0)
+    {
+        return COLUMN_INT64;
+    }
+    for (i = 0; i < sizeof(floats) / sizeof(floats[0]); i++)
+    {
+        if (strcmp(name, floats[i]) == 0)
+        {
+            return COLUMN_FLOAT64;
+        }
+    }
+    return COLUMN_DICTIONARY;
+}
+
+/**
+ * Function:  rm_rows_arrow
+ * ------------------------
+ * @brief  Writes a collected answer as an Arrow IPC (Feather) file, one column per CSV column.
+ *
+ * The statistic, error and margin columns become int64 columns, the
+ * altitude columns of questions 6 and 7 (p50, p90, p99, lower and upper)
+ * float64 columns, and the others (subject and any partition)
+ * dictionary-encoded string columns.
+ *
+ * @param rows The answer, header first.
+ * @param path Where to write the file.
+ *
+ * @return int 0: No errors; 1: A row is short of columns, or the file could not be written.
+ *
+ */
+int rm_rows_arrow(const rm_rows_t *rows, const char *path)
+{
+    column_t columns[MAX_ROW_COLUMNS];
+    char *cells[MAX_ROW_COLUMNS];
+    char *names[MAX_ROW_COLUMNS];
+    strmap_t words[MAX_ROW_COLUMNS];
+    strmap_entry_t *e;
+    char *header, *line, *end;
+    size_t nrows = rows->nrows > 0 ? rows->nrows - 1 : 0;
+    size_t r;
+    int ncolumns, wide, c, created;
+    int failed = 0;
+
+    if (rows->nrows == 0)
+    {
+        return 1;
+    }
+    header = estrdup(MEM_SCRATCH, rows->rows[0]);
+    for (ncolumns = 1, end = header; (end = strchr(end, ',')) != NULL; end++)
+    {
+        ncolumns++;
+    }
+    if (ncolumns > MAX_ROW_COLUMNS)
+    {
+        efree(header);
+        return 1;
+    }
+    split_row(header, names, ncolumns, 0);
+
+    // the subject is the one column whose values may hold commas
+    for (c = 0, wide = 0; c < ncolumns; c++)
+    {
+        wide = strcmp(names[c], "subject") == 0 ? c : wide;
+    }
+    for (c = 0; c < ncolumns; c++)
+    {
+        start_column(&columns[c], names[c], column_kind(names[c]), nrows);
+        strmap_init(&words[c], 16);
+    }
+
+    for (r = 0; r < nrows && !failed; r++)
+    {
+        line = estrdup(MEM_SCRATCH, rows->rows[r + 1]);
+        failed = split_row(line, cells, ncolumns, wide);
+        for (c = 0; c < ncolumns && !failed; c++)
+        {
+            if (columns[c].kind == COLUMN_INT64)
+            {
+                ((int64_t *)columns[c].values)[r] = strtoll(cells[c], &end, 10);
+                failed = end == cells[c] || *end != '\0';
+                continue;
+            }
+            if (columns[c].kind == COLUMN_FLOAT64)
+            {
+                ((double *)columns[c].values)[r] = strtod(cells[c], &end);
+                failed = end == cells[c] || *end != '\0';
+                continue;
+            }
+            e = strmap_insert(&words[c], cells[c], &created);
+            if (created)
+            {
+                e->value = (void *)(intptr_t)add_word(&columns[c], cells[c]);
+            }
+            ((int32_t *)columns[c].values)[r] = (int32_t)(intptr_t)e->value;
+        }
+        efree(line);
+    }
+
+    for (c = 0; c < ncolumns; c++)
+    {
+        efree(columns[c].validity);
+        columns[c].validity = NULL;
+        strmap_free(&words[c], NULL);
+    }
+    if (!failed)
+    {
+        failed = write_file(path, columns, ncolumns, nrows);
+    }
+    free_columns(columns, ncolumns);
+    efree(header);
+    return failed;
+}
+
+/**
+ * Function:  rm_rows_free
+ * -----------------------
+ * @brief  Releases a collected answer.
+ *
+ * @param rows The answer.
+ *
+ */
+void rm_rows_free(rm_rows_t *rows)
+{
+    size_t r;
+
+    for (r = 0; r < rows->nrows; r++)
+    {
+        efree(rows->rows[r]);
+    }
+    efree(rows->rows);
+    efree(rows);
+}
@@ -0,0 +1,729 @@
+/** @file bench.c
+ *  @brief Microbenchmarks of the list primitives and the route file parser kernels.
+ *
+ * Each kernel runs alone, over inputs of several sizes and key
+ * distributions, for long enough to be timed, and is reported in ns per
+ * operation next to the hardware counters of the run (cycles,
+ * instructions, cache misses and branch misses per operation), read with
+ * perf_event_open(). Counters the kernel does not allow (see
+ * /proc/sys/kernel/perf_event_paranoid) or the machine does not have, as in
+ * most virtual machines, are printed as "-".
+ *
+ * Usage: ./bench [--DATA=<route file>] [--KERNEL=<name>] [--MIN_TIME=<ms>]
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "list.h"
+#include "dataset.h"
+#include "reader.h"
+#include "strmap.h"
+#include "emalloc.h"
+
+#define NCOUNTERS 4
+#define NSIZES 3
+
+const char *fileToRead = "routes-airlines-airports.yaml";
+const char *kernelName = NULL;
+double minTime = 0.1;
+
+// the list kernels walk the list on every insert, so they stay smaller than the parser's
+const size_t LIST_SIZES[NSIZES] = {100, 1000, 10000};
+const size_t LINE_SIZES[NSIZES] = {1000, 10000, 100000};
+
+const uint64_t COUNTER_CONFIGS[NCOUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                             PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+/**
+ * @brief The hardware counters of this thread; fds[i] is -1 where a counter is unavailable.
+ */
+typedef struct
+{
+    int fds[NCOUNTERS];
+} counters_t;
+
+/**
+ * @brief The time and counts accumulated over the timed passes of one case.
+ */
+typedef struct
+{
+    double seconds;
+    uint64_t counts[NCOUNTERS];
+    uint64_t ops;
+    struct timespec started;
+} sample_t;
+
+/**
+ * @brief The inputs of one case: n keys, counts or lines in one distribution.
+ */
+typedef struct
+{
+    size_t n;
+    char **words;
+    int *counts;
+    char *text;    // the lines, each ending in '\0', overwritten by the pass
+    char *pristine; // the lines as read, copied into text before every pass
+    size_t *lines;  // the offset of each line in text
+    size_t length;
+} input_t;
+
+/**
+ * @brief One kernel, run once over an input per call.
+ */
+typedef struct
+{
+    const char *name;
+    void (*pass)(input_t *, counters_t *, sample_t *);
+} kernel_t;
+
+uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+/**
+ * @brief Draws a pseudo-random number (splitmix64), the same sequence on every run.
+ *
+ * @return uint64_t the number
+ *
+ */
+uint64_t draw(void)
+{
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Opens the hardware counters, disabled; any the kernel refuses stay closed.
+ *
+ * @param c the counters
+ * @return int the number of counters opened
+ *
+ */
+int open_counters(counters_t *c)
+{
+    struct perf_event_attr attr;
+    int i, opened = 0;
+
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = COUNTER_CONFIGS[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1; // allowed up to perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        c->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        opened += c->fds[i] >= 0;
+    }
+    return opened;
+}
+
+/**
+ * @brief Closes the hardware counters.
+ *
+ * @param c the counters
+ *
+ */
+void close_counters(counters_t *c)
+{
+    int i;
+
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        if (c->fds[i] >= 0)
+        {
+            close(c->fds[i]);
+        }
+    }
+}
+
+/**
+ * @brief Starts timing a pass: resets and enables the counters, then reads the clock.
+ *
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void start(counters_t *c, sample_t *s)
+{
+    int i;
+
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        if (c->fds[i] >= 0)
+        {
+            ioctl(c->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &s->started);
+}
+
+/**
+ * @brief Ends timing a pass, adding its time, counts and operations to the sample.
+ *
+ * @param c the counters
+ * @param s the sample of the case
+ * @param ops the operations the pass timed
+ *
+ */
+void stop(counters_t *c, sample_t *s, size_t ops)
+{
+    struct timespec now;
+    uint64_t count;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        if (c->fds[i] >= 0)
+        {
+            ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(c->fds[i], &count, sizeof(count)) == sizeof(count))
+            {
+                s->counts[i] += count;
+            }
+        }
+    }
+    s->seconds += (double)(now.tv_sec - s->started.tv_sec) + (double)(now.tv_nsec - s->started.tv_nsec) / 1e9;
+    s->ops += ops;
+}
+
+/**
+ * @brief Builds one node per key up front, so a pass times the inserts alone.
+ *
+ * @param in the input
+ * @param use_counts whether the nodes carry the input's counts (else their index)
+ * @return node_t** the nodes
+ *
+ */
+node_t **make_nodes(const input_t *in, int use_counts)
+{
+    node_t **nodes = (node_t **)emalloc(in->n * sizeof(node_t *));
+    size_t i;
+
+    for (i = 0; i < in->n; i++)
+    {
+        nodes[i] = new_node(in->words[i], use_counts ? in->counts[i] : (int)i);
+    }
+    return nodes;
+}
+
+/**
+ * @brief Times add_inorder() building a list of every key.
+ *
+ * @param in the input
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_add_inorder(input_t *in, counters_t *c, sample_t *s)
+{
+    node_t **nodes = make_nodes(in, 0);
+    node_t *list = NULL;
+    size_t i;
+
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        list = add_inorder(list, nodes[i]);
+    }
+    stop(c, s, in->n);
+    free_list(list);
+    efree(nodes);
+}
+
+/**
+ * @brief Times sortDecending() building a list of every count.
+ *
+ * @param in the input
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_sort_decending(input_t *in, counters_t *c, sample_t *s)
+{
+    node_t **nodes = make_nodes(in, 1);
+    node_t *list = NULL;
+    size_t i;
+
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        list = sortDecending(list, nodes[i]);
+    }
+    stop(c, s, in->n);
+    free_list(list);
+    efree(nodes);
+}
+
+/**
+ * @brief Times sortAscending() building a list of every count.
+ *
+ * @param in the input
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_sort_ascending(input_t *in, counters_t *c, sample_t *s)
+{
+    node_t **nodes = make_nodes(in, 1);
+    node_t *list = NULL;
+    size_t i;
+
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        list = sortAscending(list, nodes[i]);
+    }
+    stop(c, s, in->n);
+    free_list(list);
+    efree(nodes);
+}
+
+/**
+ * @brief Times new_node() and add_front() of every key, then remove_front() and freeing each node.
+ *
+ * @param in the input
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_new_remove(input_t *in, counters_t *c, sample_t *s)
+{
+    node_t *list = NULL;
+    node_t *head;
+    size_t i;
+
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        list = add_front(list, new_node(in->words[i], (int)i));
+    }
+    while (list != NULL)
+    {
+        head = peek_front(list);
+        list = remove_front(list);
+        efree(head->word);
+        efree(head);
+    }
+    stop(c, s, in->n);
+}
+
+/**
+ * @brief Times dataset_split_line() over every line, as dataset_load() splits them.
+ *
+ * @param in the input
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_split_line(input_t *in, counters_t *c, sample_t *s)
+{
+    char *key, *value;
+    size_t i;
+
+    memcpy(in->text, in->pristine, in->length);
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        dataset_split_line(in->text + in->lines[i], &key, &value);
+    }
+    stop(c, s, in->n);
+}
+
+/**
+ * @brief Times dataset_field() over the key of every line, guessing the next field as dataset_load() does.
+ *
+ * @param in the input (already split)
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_field(input_t *in, counters_t *c, sample_t *s)
+{
+    int f = -1;
+    size_t i;
+
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        f = dataset_field(in->words[i], f + 1);
+    }
+    stop(c, s, in->n);
+}
+
+/**
+ * @brief Times strmap_insert() interning the value of every line into a new map, as dataset_load() does.
+ *
+ * @param in the input (already split)
+ * @param c the counters
+ * @param s the sample of the case
+ *
+ */
+void pass_intern(input_t *in, counters_t *c, sample_t *s)
+{
+    strmap_t ids;
+    int created;
+    size_t i;
+
+    strmap_init(&ids, 4096);
+    start(c, s);
+    for (i = 0; i < in->n; i++)
+    {
+        strmap_insert(&ids, in->counts[i] ? in->words[i] + in->counts[i] : "", &created);
+    }
+    stop(c, s, in->n);
+    strmap_free(&ids, NULL);
+}
+
+const kernel_t ADD_INORDER = {"add_inorder", pass_add_inorder};
+const kernel_t NEW_REMOVE = {"new_node/remove_front", pass_new_remove};
+const kernel_t SORT_DECENDING = {"sortDecending", pass_sort_decending};
+const kernel_t SORT_ASCENDING = {"sortAscending", pass_sort_ascending};
+
+/**
+ * @brief Runs a kernel over an input until minTime has been timed, and prints its line.
+ *
+ * @param kernel the kernel
+ * @param distribution the name of the input's distribution
+ * @param in the input
+ *
+ */
+void run(const kernel_t *kernel, const char *distribution, input_t *in)
+{
+    counters_t c;
+    sample_t s;
+    int i;
+
+    if (kernelName != NULL && strcmp(kernelName, kernel->name) != 0)
+    {
+        return;
+    }
+    memset(&s, 0, sizeof(s));
+    open_counters(&c);
+    while (s.seconds < minTime)
+    {
+        kernel->pass(in, &c, &s);
+    }
+
+    printf("%-22s %-10s %7zu %10.1f", kernel->name, distribution, in->n, s.seconds * 1e9 / (double)s.ops);
+    for (i = 0; i < NCOUNTERS; i++)
+    {
+        if (c.fds[i] >= 0)
+        {
+            printf(" %12.2f", (double)s.counts[i] / (double)s.ops);
+        }
+        else
+        {
+            printf(" %12s", "-");
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+    close_counters(&c);
+}
+
+/**
+ * @brief qsort() comparator putting words in strcmp() order.
+ *
+ */
+int compare_words(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * @brief qsort() comparator putting counts in decreasing order.
+ *
+ */
+int compare_counts(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+
+    return (x < y) - (x > y);
+}
+
+/**
+ * @brief Fills the keys of an input: random names in "random", "sorted" or "reversed" order, or
+ * random names after a long shared prefix in "prefix".
+ *
+ * @param in the input, with n set
+ * @param order the distribution
+ *
+ */
+void make_keys(input_t *in, const char *order)
+{
+    const char *prefix = strcmp(order, "prefix") == 0 ? "Hartsfield Jackson Atlanta Intl " : "";
+    char word[64];
+    char *swap;
+    size_t i, len;
+    int k;
+
+    for (i = 0; i < in->n; i++)
+    {
+        len = strlen(prefix);
+        memcpy(word, prefix, len);
+        for (k = 8 + (int)(draw() % 16); k > 0; k--)
+        {
+            word[len++] = (char)('a' + draw() % 26);
+        }
+        word[len] = '\0';
+        in->words[i] = estrdup(MEM_SCRATCH, word);
+    }
+    if (strcmp(order, "sorted") == 0 || strcmp(order, "reversed") == 0)
+    {
+        qsort(in->words, in->n, sizeof(char *), compare_words);
+    }
+    for (i = 0; strcmp(order, "reversed") == 0 && i < in->n / 2; i++)
+    {
+        swap = in->words[i];
+        in->words[i] = in->words[in->n - 1 - i];
+        in->words[in->n - 1 - i] = swap;
+    }
+}
+
+/**
+ * @brief Fills the counts of an input: uniform in "random", in "decreasing" or "increasing" order,
+ * or in "skewed" mostly small with a few large, like the counts of routes.
+ *
+ * @param in the input, with n set
+ * @param shape the distribution
+ *
+ */
+void make_counts(input_t *in, const char *shape)
+{
+    int skewed = strcmp(shape, "skewed") == 0;
+    int swap;
+    size_t i;
+
+    for (i = 0; i < in->n; i++)
+    {
+        in->counts[i] = skewed ? (int)(in->n / (1 + draw() % in->n)) : (int)(1 + draw() % in->n);
+    }
+    if (strcmp(shape, "decreasing") == 0 || strcmp(shape, "increasing") == 0)
+    {
+        qsort(in->counts, in->n, sizeof(int), compare_counts);
+    }
+    for (i = 0; strcmp(shape, "increasing") == 0 && i < in->n / 2; i++)
+    {
+        swap = in->counts[i];
+        in->counts[i] = in->counts[in->n - 1 - i];
+        in->counts[in->n - 1 - i] = swap;
+    }
+}
+
+/**
+ * @brief Runs the list kernels over every size and key distribution.
+ *
+ * add_inorder() is run over keys in every order; new_node() and
+ * remove_front() over short and long keys; sortDecending() and
+ * sortAscending() over counts of every shape.
+ *
+ */
+void bench_lists(void)
+{
+    const char *orders[] = {"random", "sorted", "reversed", "prefix"};
+    const char *shapes[] = {"random", "decreasing", "increasing", "skewed"};
+    input_t in;
+    size_t i, k;
+    int d;
+
+    memset(&in, 0, sizeof(in));
+    for (k = 0; k < NSIZES; k++)
+    {
+        in.n = LIST_SIZES[k];
+        in.words = (char **)emalloc(in.n * sizeof(char *));
+        in.counts = (int *)emalloc(in.n * sizeof(int));
+        for (d = 0; d < 4; d++)
+        {
+            make_keys(&in, orders[d]);
+            run(&ADD_INORDER, orders[d], &in);
+            if (d == 0 || d == 3)
+            {
+                run(&NEW_REMOVE, orders[d], &in);
+            }
+            for (i = 0; i < in.n; i++)
+            {
+                efree(in.words[i]);
+            }
+        }
+
+        make_keys(&in, "random");
+        for (d = 0; d < 4; d++)
+        {
+            make_counts(&in, shapes[d]);
+            run(&SORT_DECENDING, shapes[d], &in);
+            run(&SORT_ASCENDING, shapes[d], &in);
+        }
+        for (i = 0; i < in.n; i++)
+        {
+            efree(in.words[i]);
+        }
+        efree(in.words);
+        efree(in.counts);
+    }
+}
+
+/**
+ * @brief Runs the parser kernels over the first lines of the route file, at every size.
+ *
+ * The lines are split, their keys looked up and their values interned, as
+ * dataset_load() does, each step timed on its own. "file" keeps the lines in
+ * file order; "shuffled" breaks the order dataset_field() guesses from.
+ *
+ * @param file the route file, closed once read
+ *
+ */
+void bench_parser(reader_t *file)
+{
+    const kernel_t split = {"split_line", pass_split_line};
+    const kernel_t field = {"dataset_field", pass_field};
+    const kernel_t intern = {"strmap_insert", pass_intern};
+    char line[MAX_VALUE_LENGTH];
+    char *key, *value;
+    input_t in;
+    size_t cap = 1 << 20, nlines = 0, lines_cap = 1024;
+    size_t i, j, k, len;
+
+    memset(&in, 0, sizeof(in));
+    in.pristine = (char *)emalloc(cap);
+    in.lines = (size_t *)emalloc(lines_cap * sizeof(size_t));
+    fgets(line, MAX_VALUE_LENGTH, file->fp); // the first line is not a route
+    while (nlines < LINE_SIZES[NSIZES - 1] && fgets(line, MAX_VALUE_LENGTH, file->fp))
+    {
+        len = strlen(line) + 1;
+        if (in.length + len > cap)
+        {
+            cap *= 2;
+            in.pristine = (char *)erealloc(MEM_SCRATCH, in.pristine, cap);
+        }
+        if (nlines == lines_cap)
+        {
+            lines_cap *= 2;
+            in.lines = (size_t *)erealloc(MEM_SCRATCH, in.lines, lines_cap * sizeof(size_t));
+        }
+        memcpy(in.pristine + in.length, line, len);
+        in.lines[nlines++] = in.length;
+        in.length += len;
+    }
+    close_reader(file);
+
+    // the lookups take the split keys and values; counts[i] is where line i's value starts
+    in.text = (char *)emalloc(in.length);
+    in.words = (char **)emalloc(nlines * sizeof(char *));
+    in.counts = (int *)emalloc(nlines * sizeof(int));
+    memcpy(in.text, in.pristine, in.length);
+    for (i = 0; i < nlines; i++)
+    {
+        in.words[i] = in.text + in.lines[i];
+        in.counts[i] = 0;
+        if (dataset_split_line(in.words[i], &key, &value) && value[0] != '\0')
+        {
+            in.counts[i] = (int)(value - key);
+        }
+    }
+
+    for (k = 0; k < NSIZES; k++)
+    {
+        in.n = LINE_SIZES[k] < nlines ? LINE_SIZES[k] : nlines;
+        run(&split, "file", &in);
+        run(&field, "file", &in);
+        run(&intern, "file", &in);
+        if (in.n == nlines)
+        {
+            break;
+        }
+    }
+
+    // shuffled keys and values, keeping each value with its key
+    for (i = nlines - 1; i > 0; i--)
+    {
+        j = draw() % (i + 1);
+        key = in.words[i];
+        in.words[i] = in.words[j];
+        in.words[j] = key;
+        len = (size_t)in.counts[i];
+        in.counts[i] = in.counts[j];
+        in.counts[j] = (int)len;
+    }
+    for (k = 0; k < NSIZES; k++)
+    {
+        in.n = LINE_SIZES[k] < nlines ? LINE_SIZES[k] : nlines;
+        run(&field, "shuffled", &in);
+        run(&intern, "shuffled", &in);
+        if (in.n == nlines)
+        {
+            break;
+        }
+    }
+
+    efree(in.pristine);
+    efree(in.text);
+    efree(in.lines);
+    efree(in.words);
+    efree(in.counts);
+}
+
+/**
+ * @brief The main function and entry point of the benchmarks.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The list of arguments passed to the program.
+ * @return int 0: No errors; 1: Errors produced.
+ *
+ */
+int main(int argc, char *argv[])
+{
+    counters_t c;
+    reader_t *file;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--DATA=", 7) == 0)
+        {
+            fileToRead = argv[i] + 7;
+        }
+        else if (strncmp(argv[i], "--KERNEL=", 9) == 0)
+        {
+            kernelName = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--MIN_TIME=", 11) == 0)
+        {
+            minTime = atof(argv[i] + 11) / 1000;
+        }
+        else
+        {
+            printf("Usage: ./bench [--DATA=<route file>] [--KERNEL=<name>] [--MIN_TIME=<ms>]\n");
+            return 1;
+        }
+    }
+
+    file = open_reader(fileToRead);
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
+        return 1;
+    }
+    if (open_counters(&c) < NCOUNTERS)
+    {
+        fprintf(stderr, "Some hardware counters are unavailable (perf_event_paranoid or no PMU); they are shown as -\n");
+    }
+    close_counters(&c);
+
+    printf("%-22s %-10s %7s %10s %12s %12s %12s %12s\n", "kernel", "input", "n", "ns/op", "cycles/op",
+           "instr/op", "cache-miss/op", "branch-miss/op");
+    bench_lists();
+    bench_parser(file);
+    return 0;
+}
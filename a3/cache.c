@@ -0,0 +1,289 @@
+/** @file cache.c
+ *  @brief Implementation of cache.h
+ *
+ * Each answer is a file in the cache directory, named after the hash of its
+ * key and starting with the key itself, so a hash collision reads as a
+ * miss. A key holds the fingerprint of the input file (size, modification
+ * time and a hash of its contents) and every parameter that changes the
+ * answer, so an entry for a file that has since changed is never found
+ * again; it just ages out. Modification times of the entries order them
+ * for eviction: a hit touches its entry, and a store evicts the entries
+ * used longest ago until the directory fits in its cap.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "emalloc.h"
+#include "hash.h"
+#include "cache.h"
+
+#define CACHE_CHUNK 65536
+#define CACHE_SUFFIX ".csv"
+
+/**
+ * @brief One entry found when trimming the cache.
+ */
+typedef struct
+{
+    char *path;
+    off_t size;
+    struct timespec used;
+} entry_t;
+
+/**
+ * Function:  cache_fingerprint
+ * ----------------------------
+ * @brief  Describes the contents of a file, so that any change to it changes the description.
+ *
+ * @param path The file.
+ * @param fingerprint Where to write the description (MAX_CACHE_KEY bytes).
+ *
+ * @return int 0: No errors; 1: The file is not a regular file or cannot be read.
+ *
+ */
+int cache_fingerprint(const char *path, char *fingerprint)
+{
+    char *chunk;
+    struct stat info;
+    uint64_t h = 0;
+    size_t n;
+    FILE *fp;
+
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        return 1;
+    }
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        return 1;
+    }
+    chunk = (char *)emalloc(CACHE_CHUNK);
+    while ((n = fread(chunk, 1, CACHE_CHUNK, fp)) > 0)
+    {
+        h = hash_bytes(chunk, n, h);
+    }
+    efree(chunk);
+    fclose(fp);
+
+    sprintf(fingerprint, "%lld:%lld.%09ld:%016" PRIx64, (long long)info.st_size, (long long)info.st_mtim.tv_sec,
+            info.st_mtim.tv_nsec, h);
+    return 0;
+}
+
+/**
+ * Function:  entry_path
+ * ---------------------
+ * @brief  Returns the path of the entry for a key.
+ *
+ * @param dir The cache directory.
+ * @param key The key.
+ *
+ * @return char* The path (to be freed).
+ *
+ */
+static char *entry_path(const char *dir, const char *key)
+{
+    char *path = (char *)emalloc(strlen(dir) + 32);
+
+    sprintf(path, "%s/%016" PRIx64 CACHE_SUFFIX, dir, hash_string(key));
+    return path;
+}
+
+/**
+ * Function:  copy_file
+ * --------------------
+ * @brief  Copies the rest of one stream into another.
+ *
+ * @param in The stream to read.
+ * @param out The stream to write.
+ *
+ * @return int 0: No errors; 1: A read or write failed.
+ *
+ */
+static int copy_file(FILE *in, FILE *out)
+{
+    char chunk[CACHE_CHUNK];
+    size_t n;
+
+    while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    {
+        if (fwrite(chunk, 1, n, out) != n)
+        {
+            return 1;
+        }
+    }
+    return ferror(in) != 0;
+}
+
+/**
+ * Function:  cache_fetch
+ * ----------------------
+ * @brief  Writes the cached answer for a key to a file, if there is one.
+ *
+ * @param dir The cache directory.
+ * @param key The key.
+ * @param output The file to write the answer to.
+ *
+ * @return int 0: The answer was written; 1: It is not cached.
+ *
+ */
+int cache_fetch(const char *dir, const char *key, const char *output)
+{
+    char *path = entry_path(dir, key);
+    char stored[MAX_CACHE_KEY + 2];
+    FILE *in, *out;
+    int failed = 1;
+
+    in = fopen(path, "r");
+    if (in != NULL && fgets(stored, sizeof(stored), in) != NULL && strncmp(stored, key, strlen(key)) == 0 &&
+        stored[strlen(key)] == '\n')
+    {
+        out = fopen(output, "w");
+        if (out != NULL)
+        {
+            failed = copy_file(in, out);
+            failed |= fclose(out) != 0;
+        }
+    }
+    if (in != NULL)
+    {
+        fclose(in);
+    }
+    if (!failed)
+    {
+        utimensat(AT_FDCWD, path, NULL, 0);  // most recently used
+    }
+    efree(path);
+    return failed;
+}
+
+/**
+ * Function:  by_use
+ * -----------------
+ * @brief  qsort() comparator putting the entries used longest ago first.
+ *
+ */
+static int by_use(const void *a, const void *b)
+{
+    const entry_t *x = (const entry_t *)a;
+    const entry_t *y = (const entry_t *)b;
+
+    if (x->used.tv_sec != y->used.tv_sec)
+    {
+        return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    }
+    return x->used.tv_nsec < y->used.tv_nsec ? -1 : x->used.tv_nsec > y->used.tv_nsec;
+}
+
+/**
+ * Function:  trim
+ * ---------------
+ * @brief  Removes the entries used longest ago until the cache fits in its cap.
+ *
+ * @param dir The cache directory.
+ * @param cap The most bytes its entries may take.
+ *
+ */
+static void trim(const char *dir, size_t cap)
+{
+    entry_t *entries = NULL;
+    struct dirent *d;
+    struct stat info;
+    size_t n = 0, len, i;
+    off_t total = 0;
+    DIR *listing;
+    char *path;
+
+    listing = opendir(dir);
+    if (listing == NULL)
+    {
+        return;
+    }
+    while ((d = readdir(listing)) != NULL)
+    {
+        len = strlen(d->d_name);
+        if (len < strlen(CACHE_SUFFIX) || strcmp(d->d_name + len - strlen(CACHE_SUFFIX), CACHE_SUFFIX) != 0)
+        {
+            continue;
+        }
+        path = (char *)emalloc(strlen(dir) + len + 2);
+        sprintf(path, "%s/%s", dir, d->d_name);
+        if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        {
+            efree(path);
+            continue;
+        }
+        entries = (entry_t *)erealloc(MEM_SCRATCH, entries, (n + 1) * sizeof(entry_t));
+        entries[n].path = path;
+        entries[n].size = info.st_size;
+        entries[n++].used = info.st_mtim;
+        total += info.st_size;
+    }
+    closedir(listing);
+
+    qsort(entries, n, sizeof(entry_t), by_use);
+    for (i = 0; i < n; i++)
+    {
+        if ((size_t)total > cap && unlink(entries[i].path) == 0)
+        {
+            total -= entries[i].size;
+        }
+        efree(entries[i].path);
+    }
+    efree(entries);
+}
+
+/**
+ * Function:  cache_store
+ * ----------------------
+ * @brief  Caches the answer in a file under a key, then trims the cache to its cap.
+ *
+ * The entry is written under a temporary name and renamed into place, so
+ * other processes never see half of it.
+ *
+ * @param dir The cache directory (created if needed).
+ * @param key The key.
+ * @param output The file holding the answer.
+ * @param cap The most bytes the cache's entries may take.
+ *
+ */
+void cache_store(const char *dir, const char *key, const char *output, size_t cap)
+{
+    char *path = entry_path(dir, key);
+    char *temp = (char *)emalloc(strlen(path) + 32);
+    FILE *in, *out;
+    int failed;
+
+    mkdir(dir, 0777);
+    sprintf(temp, "%s.%ld.tmp", path, (long)getpid());
+    in = fopen(output, "r");
+    out = fopen(temp, "w");
+    if (in != NULL && out != NULL)
+    {
+        failed = fprintf(out, "%s\n", key) < 0 || copy_file(in, out);
+        failed |= fclose(out) != 0;
+        out = NULL;
+        if (failed || rename(temp, path) != 0)
+        {
+            unlink(temp);
+        }
+    }
+    if (in != NULL)
+    {
+        fclose(in);
+    }
+    if (out != NULL)
+    {
+        fclose(out);
+    }
+    efree(temp);
+    efree(path);
+    trim(dir, cap);
+}
@@ -0,0 +1,20 @@
+/** @file cache.h
+ *  @brief Function prototypes for the on-disk cache of answers.
+ *
+ */
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stddef.h>
+
+// room for a fingerprint and the query parameters, a country name among them
+#define MAX_CACHE_KEY 1280
+
+/**
+ * Function protypes associated with the answer cache.
+ */
+int cache_fingerprint(const char *path, char *fingerprint);
+int cache_fetch(const char *dir, const char *key, const char *output);
+void cache_store(const char *dir, const char *key, const char *output, size_t cap);
+
+#endif
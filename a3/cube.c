@@ -0,0 +1,256 @@
+/** @file cube.c
+ *  @brief Implementation of cube.h
+ *
+ * Members and cells are found while building through string maps keyed by
+ * their ids in hex; once built, the cube is only arrays of integers.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "strmap.h"
+#include "cube.h"
+
+// longest map key: four ids of up to eight hex digits and their separators
+#define MAX_CUBE_KEY 40
+
+/**
+ * @brief The dataset fields making up the members of each dimension.
+ */
+static const field_t DIM_FIELDS[DIM_COUNT][4] = {
+    {FIELD_AIRLINE_NAME, FIELD_AIRLINE_ICAO},
+    {FIELD_FROM_COUNTRY},
+    {FIELD_TO_COUNTRY},
+    {FIELD_TO_NAME, FIELD_TO_ICAO, FIELD_TO_CITY, FIELD_TO_COUNTRY}};
+static const int DIM_WIDTHS[DIM_COUNT] = {2, 1, 1, 4};
+
+/**
+ * @brief A member table being filled.
+ */
+typedef struct
+{
+    strmap_t index;
+    size_t cap;
+} members_t;
+
+/**
+ * Function:  format_ids
+ * ---------------------
+ * @brief  Writes ids as a map key.
+ *
+ * @param key Where to write the key (MAX_CUBE_KEY bytes).
+ * @param ids The ids.
+ * @param n The number of ids.
+ *
+ * @return char* key.
+ *
+ */
+static char *format_ids(char *key, const uint32_t *ids, int n)
+{
+    int i, len = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        len += sprintf(key + len, "%x:", (unsigned)ids[i]);
+    }
+    return key;
+}
+
+/**
+ * Function:  add_member
+ * ---------------------
+ * @brief  Returns the number of a dimension's member, numbering it if it is new.
+ *
+ * @param cube The cube being built.
+ * @param table The member table of the dimension.
+ * @param dim The dimension.
+ * @param ids The string ids of the member.
+ *
+ * @return uint32_t The member's number.
+ *
+ */
+static uint32_t add_member(cube_t *cube, members_t *table, dim_t dim, const uint32_t *ids)
+{
+    char key[MAX_CUBE_KEY];
+    strmap_entry_t *e;
+    int created;
+
+    e = strmap_insert(&table->index, format_ids(key, ids, cube->width[dim]), &created);
+    if (created)
+    {
+        if (cube->nmembers[dim] == table->cap)
+        {
+            table->cap = table->cap == 0 ? 256 : 2 * table->cap;
+            cube->members[dim] =
+                (uint32_t *)erealloc(MEM_INDEXES, cube->members[dim], table->cap * cube->width[dim] * sizeof(uint32_t));
+        }
+        memcpy(cube->members[dim] + (size_t)cube->nmembers[dim] * cube->width[dim], ids,
+               cube->width[dim] * sizeof(uint32_t));
+        e->value = (void *)(uintptr_t)cube->nmembers[dim]++;
+    }
+    return (uint32_t)(uintptr_t)e->value;
+}
+
+/**
+ * Function:  compare_cells
+ * ------------------------
+ * @brief  qsort() comparator putting cells in ascending coordinate order.
+ *
+ */
+static int compare_cells(const void *a, const void *b)
+{
+    const cube_cell_t *x = (const cube_cell_t *)a;
+    const cube_cell_t *y = (const cube_cell_t *)b;
+    int d;
+
+    for (d = 0; d < DIM_COUNT; d++)
+    {
+        if (x->coords[d] != y->coords[d])
+        {
+            return x->coords[d] < y->coords[d] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Function:  cube_build
+ * ---------------------
+ * @brief  Rolls the routes of a dataset up into a cube.
+ *
+ * @param ds The dataset; it must have CUBE_FIELDS loaded.
+ *
+ * @return cube_t* The cube, or NULL if the dataset lacks some of its fields.
+ *
+ */
+cube_t *cube_build(const dataset_t *ds)
+{
+    members_t tables[DIM_COUNT];
+    strmap_t cells;
+    uint32_t ids[4], coords[DIM_COUNT];
+    char key[MAX_CUBE_KEY];
+    strmap_entry_t *e;
+    cube_t *cube;
+    size_t r, i, n;
+    int d, k, created;
+
+    if ((ds->fields & CUBE_FIELDS) != CUBE_FIELDS)
+    {
+        return NULL;
+    }
+
+    cube = (cube_t *)emalloc_as(MEM_INDEXES, sizeof(cube_t));
+    memset(cube, 0, sizeof(cube_t));
+    for (d = 0; d < DIM_COUNT; d++)
+    {
+        cube->width[d] = DIM_WIDTHS[d];
+        strmap_init(&tables[d].index, 1024);
+        tables[d].cap = 0;
+    }
+    strmap_init(&cells, ds->nroutes / 4 + 16);
+
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        for (d = 0; d < DIM_COUNT; d++)
+        {
+            for (k = 0; k < cube->width[d]; k++)
+            {
+                ids[k] = ds->columns[DIM_FIELDS[d][k]][r];
+            }
+            coords[d] = add_member(cube, &tables[d], d, ids);
+        }
+        e = strmap_insert(&cells, format_ids(key, coords, DIM_COUNT), &created);
+        e->value = (void *)((uintptr_t)e->value + 1);
+    }
+
+    // the map's slots become the cells, then get sorted by coordinates
+    cube->cells = (cube_cell_t *)emalloc_as(MEM_INDEXES, (cells.size + 1) * sizeof(cube_cell_t));
+    for (i = 0, n = 0; i < cells.cap; i++)
+    {
+        if (cells.entries[i].key != NULL)
+        {
+            sscanf(cells.entries[i].key, "%x:%x:%x:%x:", &cube->cells[n].coords[0], &cube->cells[n].coords[1],
+                   &cube->cells[n].coords[2], &cube->cells[n].coords[3]);
+            cube->cells[n++].count = (uint32_t)(uintptr_t)cells.entries[i].value;
+        }
+    }
+    cube->ncells = n;
+    qsort(cube->cells, n, sizeof(cube_cell_t), compare_cells);
+
+    for (d = 0; d < DIM_COUNT; d++)
+    {
+        strmap_free(&tables[d].index, NULL);
+    }
+    strmap_free(&cells, NULL);
+    return cube;
+}
+
+/**
+ * Function:  cube_member
+ * ----------------------
+ * @brief  Returns the string ids a member of a dimension stands for.
+ *
+ * @param cube The cube.
+ * @param dim The dimension.
+ * @param member The member's number.
+ *
+ * @return const uint32_t* Its width[dim] string ids.
+ *
+ */
+const uint32_t *cube_member(const cube_t *cube, dim_t dim, uint32_t member)
+{
+    return cube->members[dim] + (size_t)member * cube->width[dim];
+}
+
+/**
+ * Function:  cube_rollup
+ * ----------------------
+ * @brief  Sums the routes of every member of one dimension, over the cells a filter keeps.
+ *
+ * @param cube The cube.
+ * @param by The dimension to group by.
+ * @param keep For each dimension, a flag per member saying whether to keep its cells (NULL keeps every member).
+ * @param totals Set to the routes of each member of by (nmembers[by] entries).
+ *
+ */
+void cube_rollup(const cube_t *cube, dim_t by, const unsigned char *keep[DIM_COUNT], long *totals)
+{
+    size_t c;
+    int d;
+
+    memset(totals, 0, cube->nmembers[by] * sizeof(long));
+    for (c = 0; c < cube->ncells; c++)
+    {
+        for (d = 0; d < DIM_COUNT && (keep[d] == NULL || keep[d][cube->cells[c].coords[d]]); d++)
+            ;
+        if (d == DIM_COUNT)
+        {
+            totals[cube->cells[c].coords[by]] += cube->cells[c].count;
+        }
+    }
+}
+
+/**
+ * Function:  cube_free
+ * --------------------
+ * @brief  Releases a cube.
+ *
+ * @param cube The cube (may be NULL).
+ *
+ */
+void cube_free(cube_t *cube)
+{
+    int d;
+
+    if (cube == NULL)
+    {
+        return;
+    }
+    for (d = 0; d < DIM_COUNT; d++)
+    {
+        efree(cube->members[d]);
+    }
+    efree(cube->cells);
+    efree(cube);
+}
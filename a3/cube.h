@@ -0,0 +1,65 @@
+/** @file cube.h
+ *  @brief Function prototypes for the rollup cube of route counts.
+ *
+ */
+#ifndef _CUBE_H_
+#define _CUBE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "dataset.h"
+
+/**
+ * @brief The dimensions of the cube.
+ */
+typedef enum
+{
+    DIM_AIRLINE,
+    DIM_FROM_COUNTRY,
+    DIM_TO_COUNTRY,
+    DIM_TO_AIRPORT,
+    DIM_COUNT
+} dim_t;
+
+// the dataset fields a cube is built from
+#define CUBE_FIELDS                                                                                       \
+    (FIELD_BIT(FIELD_AIRLINE_NAME) | FIELD_BIT(FIELD_AIRLINE_ICAO) | FIELD_BIT(FIELD_FROM_COUNTRY) |     \
+     FIELD_BIT(FIELD_TO_NAME) | FIELD_BIT(FIELD_TO_CITY) | FIELD_BIT(FIELD_TO_COUNTRY) |                  \
+     FIELD_BIT(FIELD_TO_ICAO))
+
+/**
+ * @brief One combination of members and the number of routes that have it.
+ */
+typedef struct
+{
+    uint32_t coords[DIM_COUNT];
+    uint32_t count;
+} cube_cell_t;
+
+/**
+ * @brief Route counts rolled up over (airline, from_country, to_country, to_airport).
+ *
+ * Each dimension numbers its distinct members densely from 0; a member is
+ * the tuple of dataset string ids it stands for, width ids long (airline:
+ * name, icao; countries: the country; to_airport: name, icao, city,
+ * country). cells holds every combination of members that occurs, in
+ * ascending coordinate order.
+ */
+typedef struct cube_t
+{
+    uint32_t nmembers[DIM_COUNT];
+    int width[DIM_COUNT];
+    uint32_t *members[DIM_COUNT];
+    cube_cell_t *cells;
+    size_t ncells;
+} cube_t;
+
+/**
+ * Function protypes associated with a rollup cube.
+ */
+cube_t *cube_build(const dataset_t *);
+const uint32_t *cube_member(const cube_t *, dim_t dim, uint32_t member);
+void cube_rollup(const cube_t *, dim_t by, const unsigned char *keep[DIM_COUNT], long *totals);
+void cube_free(cube_t *);
+
+#endif
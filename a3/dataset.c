@@ -0,0 +1,1201 @@
+/** @file dataset.c
+ *  @brief Implementation of dataset.h
+ *
+ * The YAML is read line by line as the questions always have: a line
+ * starting with '-' opens a new route, and every other "  key: value" line
+ * sets one field of it. A field missing from a route keeps the value it had
+ * in the route before, just like the reused buffers of the original parsers.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "emalloc.h"
+#include "strmap.h"
+#include "reader.h"
+#include "dataset.h"
+#include "cube.h"
+
+#define MAX_LINE_LENGTH MAX_VALUE_LENGTH
+
+// the sampler's generator starts here, so a fraction of a file always keeps the same routes
+#define SAMPLE_SEED 0x9C6A2F4B1D3E5A77ULL
+
+const char *FIELD_NAMES[FIELD_COUNT] = {
+    "airline_name",
+    "airline_icao_unique_code",
+    "airline_country",
+    "from_airport_name",
+    "from_airport_city",
+    "from_airport_country",
+    "from_airport_icao_unique_code",
+    "from_airport_altitude",
+    "to_airport_name",
+    "to_airport_city",
+    "to_airport_country",
+    "to_airport_icao_unique_code",
+    "to_airport_altitude"};
+
+/**
+ * @brief The state needed only while a table is being loaded.
+ */
+typedef struct
+{
+    dataset_t *ds;
+    strmap_t ids;
+    size_t pool_cap;
+    size_t route_cap;
+    size_t window;          // when streaming, the routes the columns hold at a time (0 keeps them all)
+    dataset_window_fn flush; // when streaming, called with each full window
+    void *arg;
+} loader_t;
+
+/**
+ * Function:  intern
+ * -----------------
+ * @brief  Returns the string id of a value, adding it to the pool the first time it is seen.
+ *
+ * @param ld The load in progress.
+ * @param value The value to look up.
+ *
+ * @return uint32_t The string id.
+ *
+ */
+static uint32_t intern(loader_t *ld, const char *value)
+{
+    dataset_t *ds = ld->ds;
+    strmap_entry_t *e;
+    size_t len;
+    int created;
+
+    e = strmap_insert(&ld->ids, value, &created);
+    if (!created)
+    {
+        return (uint32_t)(uintptr_t)e->value;
+    }
+
+    len = strlen(value) + 1;
+    if (ds->pool_size + len > ld->pool_cap)
+    {
+        while (ds->pool_size + len > ld->pool_cap)
+        {
+            ld->pool_cap = ld->pool_cap == 0 ? 65536 : 2 * ld->pool_cap;
+        }
+        ds->pool = (char *)erealloc(MEM_ROUTE_FIELDS, ds->pool, ld->pool_cap);
+    }
+    memcpy(ds->pool + ds->pool_size, value, len);
+
+    // ids are handed out densely, so the offsets array doubles on powers of two
+    if ((ds->nstrings & (ds->nstrings - 1)) == 0)
+    {
+        ds->offsets = (uint64_t *)erealloc(MEM_ROUTE_FIELDS, ds->offsets, (ds->nstrings == 0 ? 1 : 2 * ds->nstrings) * sizeof(uint64_t));
+    }
+    ds->offsets[ds->nstrings] = ds->pool_size;
+    ds->pool_size += len;
+
+    e->value = (void *)(uintptr_t)ds->nstrings;
+    return ds->nstrings++;
+}
+
+/**
+ * Function:  add_route
+ * --------------------
+ * @brief  Appends a finished route to the columns, first handing a full window to the stream's callback.
+ *
+ * @param ld The load in progress.
+ * @param record The string ids of the route's fields.
+ *
+ */
+static void add_route(loader_t *ld, const uint32_t *record)
+{
+    dataset_t *ds = ld->ds;
+    int f;
+
+    if (ld->window > 0 && ds->nroutes == ld->window)
+    {
+        ld->flush(ds, ld->arg);
+        ds->nroutes = 0;
+    }
+    if (ds->nroutes == ld->route_cap)
+    {
+        ld->route_cap = ld->route_cap == 0 ? 1024 : 2 * ld->route_cap;
+        for (f = 0; f < FIELD_COUNT; f++)
+        {
+            if (ds->fields & FIELD_BIT(f))
+            {
+                ds->columns[f] = (uint32_t *)erealloc(MEM_ROUTE_FIELDS, ds->columns[f], ld->route_cap * sizeof(uint32_t));
+            }
+        }
+    }
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        if (ds->fields & FIELD_BIT(f))
+        {
+            ds->columns[f][ds->nroutes] = record[f];
+        }
+    }
+    ds->nroutes++;
+}
+
+/**
+ * Function:  dataset_split_line
+ * -----------------------------
+ * @brief  Splits a "  key: value" line of a route file in place.
+ *
+ * @param line The line as read, newline included (overwritten).
+ * @param key Set to the key, with its "- " or "  " prefix.
+ * @param value Set to the value without the blank after the colon ("" if there is none).
+ *
+ * @return int 1 if the line was split; 0 if it holds only whitespace.
+ *
+ */
+int dataset_split_line(char *line, char **key, char **value)
+{
+    char *save;
+
+    if (strspn(line, " \t\n\r\v\f") == strlen(line))
+    {
+        return 0;
+    }
+    *key = strtok_r(line, ":", &save);
+    *value = strtok_r(NULL, "\n", &save);
+    if (*value == NULL)
+    {
+        *value = "";
+    }
+    else if ((*value)[0] != '\0')
+    {
+        (*value)++;
+    }
+    return 1;
+}
+
+/**
+ * Function:  dataset_field
+ * ------------------------
+ * @brief  Maps the key of a YAML line to a route field.
+ *
+ * @param key The key, with its "- " or "  " prefix.
+ * @param expected The field most likely to match.
+ *
+ * @return int The field, or -1 if the key is not a route field.
+ *
+ */
+int dataset_field(const char *key, int expected)
+{
+    int f;
+
+    if (strlen(key) < 2)
+    {
+        return -1;
+    }
+    // fields almost always come in file order, so try the next one first
+    if (expected < FIELD_COUNT && strcmp(key + 2, FIELD_NAMES[expected]) == 0)
+    {
+        return expected;
+    }
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        if (strcmp(key + 2, FIELD_NAMES[f]) == 0)
+        {
+            return f;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Function:  next_coin
+ * --------------------
+ * @brief  Steps a sampler's xorshift64* generator.
+ *
+ * @param state The generator state (never 0).
+ *
+ * @return uint64_t The next pseudo-random number.
+ *
+ */
+static uint64_t next_coin(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Function:  load_file
+ * --------------------
+ * @brief  Parses a (possibly compressed) route file into a table, keeping each route with some probability.
+ *
+ * Whether a route is kept is decided on its '-' line; the lines of a route
+ * left out are skipped without being split, matched to a field or interned.
+ *
+ * @param ds The table to fill.
+ * @param path The path of the route file.
+ * @param fields The set of fields to load (ALL_FIELDS for every one).
+ * @param fraction The probability of keeping each route (1 keeps them all).
+ * @param seed Picks the routes kept, the same ones for the same seed.
+ * @param window The routes to hold at a time, each full window going to fn (0 holds every route).
+ * @param fn Called with each window of routes (NULL if window is 0).
+ * @param arg The argument passed through to fn.
+ *
+ * @return int 0: No errors; 1: The file could not be read.
+ *
+ */
+static int load_file(dataset_t *ds, const char *path, unsigned fields, double fraction, uint64_t seed, size_t window,
+                     dataset_window_fn fn, void *arg)
+{
+    loader_t ld = {ds, {NULL, 0, 0}, 0, 0, window, fn, arg};
+    uint32_t record[FIELD_COUNT];
+    char line[MAX_LINE_LENGTH];
+    char *key, *value;
+    reader_t *in;
+    uint64_t coin = SAMPLE_SEED ^ (seed * 0x9E3779B97F4A7C15ULL);
+    uint64_t threshold = fraction < 1.0 ? (uint64_t)(fraction * 18446744073709551616.0) : 0;
+    int started = 0;
+    int skipping = 0;
+    int f = -1;
+
+    memset(ds, 0, sizeof(dataset_t));
+    ds->fields = fields & ALL_FIELDS;
+    ds->sample = fraction < 1.0 ? fraction : 0;
+    in = open_reader(path);
+    if (in == NULL)
+    {
+        return 1;
+    }
+    strmap_init(&ld.ids, 4096);
+
+    // fields never set in the file read as empty strings
+    record[0] = intern(&ld, "");  // MISSING_ID
+    for (f = 1; f < FIELD_COUNT; f++)
+    {
+        record[f] = record[0];
+    }
+
+    // read and ignore the first line
+    fgets(line, MAX_LINE_LENGTH, in->fp);
+
+    // only this thread reads the file, and the routes a sample skips cost little more than this call
+    while (fgets_unlocked(line, MAX_LINE_LENGTH, in->fp))
+    {
+        if (line[0] == '-')
+        {
+            ds->nscanned++;
+            skipping = ds->sample > 0 && next_coin(&coin) >= threshold;
+        }
+        if (skipping)
+        {
+            continue;
+        }
+
+        // skip lines that contain only whitespace
+        if (!dataset_split_line(line, &key, &value))
+        {
+            continue;
+        }
+
+        if (line[0] == '-')
+        {
+            if (started)
+            {
+                add_route(&ld, record);
+            }
+            started = 1;
+        }
+        f = dataset_field(key, f + 1);
+        if (f < 0 || !(ds->fields & FIELD_BIT(f)))
+        {
+            continue;
+        }
+        // neighbouring routes often share values, which saves a lookup
+        if (strcmp(value, ds->pool + ds->offsets[record[f]]) != 0)
+        {
+            record[f] = intern(&ld, value);
+        }
+    }
+    if (started)
+    {
+        add_route(&ld, record);
+    }
+    if (window > 0 && ds->nroutes > 0)
+    {
+        fn(ds, arg);
+        ds->nroutes = 0;
+    }
+
+    strmap_free(&ld.ids, NULL);
+    if (close_reader(in) != 0)
+    {
+        dataset_free(ds);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function:  dataset_load
+ * -----------------------
+ * @brief  Parses a (possibly compressed) route file into a table.
+ *
+ * @param ds The table to fill.
+ * @param path The path of the route file.
+ * @param fields The set of fields to load (ALL_FIELDS for every one).
+ *
+ * @return int 0: No errors; 1: The file could not be read.
+ *
+ */
+int dataset_load(dataset_t *ds, const char *path, unsigned fields)
+{
+    return load_file(ds, path, fields, 1.0, 0, 0, NULL, NULL);
+}
+
+/**
+ * Function:  dataset_stream
+ * -------------------------
+ * @brief  Parses a (possibly compressed) route file a window of routes at a time, without keeping the routes.
+ *
+ * The columns hold at most window routes: each time they are full, and
+ * once more at the end, fn is called with the table holding just those
+ * routes, and they are then dropped. The string pool is kept whole, so
+ * string ids mean the same in every window and memory grows with the
+ * distinct values of the file, not with its routes. Once it returns, the
+ * table holds the strings but no routes.
+ *
+ * @param ds The table to fill.
+ * @param path The path of the route file, or READER_STDIN for standard input.
+ * @param fields The set of fields to load (ALL_FIELDS for every one).
+ * @param window The most routes to hold at a time (at least 1).
+ * @param fn Called with each window of routes.
+ * @param arg The argument passed through to fn.
+ *
+ * @return int 0: No errors; 1: The file could not be read (fn may have seen some of its routes).
+ *
+ */
+int dataset_stream(dataset_t *ds, const char *path, unsigned fields, size_t window, dataset_window_fn fn, void *arg)
+{
+    return load_file(ds, path, fields, 1.0, 0, window, fn, arg);
+}
+
+/**
+ * @brief The shards of a sharded load, handed out to workers one at a time.
+ */
+typedef struct
+{
+    dataset_t *shards;
+    char **paths;
+    int *failed;
+    int npaths;
+    unsigned fields;
+    double fraction;
+    int next;
+    pthread_mutex_t lock;
+} shards_t;
+
+/**
+ * Function:  compare_paths
+ * ------------------------
+ * @brief  qsort() comparator putting paths in strcmp() order.
+ *
+ */
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Function:  dataset_paths
+ * ------------------------
+ * @brief  Lists the files a --DATA (or --MERGE) argument names.
+ *
+ * A directory names every file in it whose name does not start with a dot,
+ * a pattern with *, ? or [ every file it matches (see glob(7)), and anything
+ * else itself, READER_STDIN (standard input) among them. Files are listed
+ * in strcmp() order so loads are repeatable.
+ *
+ * @param spec The file, directory or pattern.
+ * @param npaths Set to the number of files.
+ *
+ * @return char** The files (efree each, then the array), or NULL if none were found.
+ *
+ */
+char **dataset_paths(const char *spec, int *npaths)
+{
+    char **paths = NULL;
+    struct dirent *entry;
+    struct stat info;
+    glob_t matches;
+    size_t i, n = 0;
+    DIR *dir;
+
+    *npaths = 0;
+    if (strcmp(spec, READER_STDIN) != 0 && stat(spec, &info) == 0 && S_ISDIR(info.st_mode))
+    {
+        dir = opendir(spec);
+        if (dir == NULL)
+        {
+            return NULL;
+        }
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (entry->d_name[0] == '.')
+            {
+                continue;
+            }
+            paths = (char **)erealloc(MEM_SCRATCH, paths, (n + 1) * sizeof(char *));
+            paths[n] = (char *)emalloc(strlen(spec) + strlen(entry->d_name) + 2);
+            sprintf(paths[n++], "%s/%s", spec, entry->d_name);
+        }
+        closedir(dir);
+    }
+    else if (strpbrk(spec, "*?[") != NULL)
+    {
+        if (glob(spec, 0, NULL, &matches) != 0)
+        {
+            return NULL;
+        }
+        paths = (char **)emalloc((matches.gl_pathc + 1) * sizeof(char *));
+        for (i = 0; i < matches.gl_pathc; i++)
+        {
+            paths[n++] = estrdup(MEM_SCRATCH, matches.gl_pathv[i]);
+        }
+        globfree(&matches);
+    }
+    else
+    {
+        paths = (char **)emalloc(sizeof(char *));
+        paths[n++] = estrdup(MEM_SCRATCH, spec);
+    }
+
+    if (n == 0)
+    {
+        efree(paths);
+        return NULL;
+    }
+    qsort(paths, n, sizeof(char *), compare_paths);
+    *npaths = (int)n;
+    return paths;
+}
+
+/**
+ * Function:  load_shards
+ * ----------------------
+ * @brief  Worker that loads shards until none are left.
+ *
+ * @param arg The shards_t.
+ *
+ * @return void* NULL.
+ *
+ */
+static void *load_shards(void *arg)
+{
+    shards_t *job = (shards_t *)arg;
+    int i;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&job->lock);
+        i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->npaths)
+        {
+            return NULL;
+        }
+        job->failed[i] = load_file(&job->shards[i], job->paths[i], job->fields, job->fraction, (uint64_t)i, 0, NULL, NULL);
+    }
+}
+
+/**
+ * Function:  merge_shard
+ * ----------------------
+ * @brief  Appends the routes of a loaded shard to a table, re-interning its strings.
+ *
+ * @param ld The load in progress of the merged table.
+ * @param shard The shard.
+ *
+ */
+static void merge_shard(loader_t *ld, const dataset_t *shard)
+{
+    uint32_t *ids = (uint32_t *)emalloc((shard->nstrings + 1) * sizeof(uint32_t));
+    uint32_t record[FIELD_COUNT] = {MISSING_ID};
+    uint32_t id;
+    size_t r;
+    int f;
+
+    for (id = 0; id < shard->nstrings; id++)
+    {
+        ids[id] = intern(ld, shard->pool + shard->offsets[id]);
+    }
+    for (r = 0; r < shard->nroutes; r++)
+    {
+        for (f = 0; f < FIELD_COUNT; f++)
+        {
+            if (shard->fields & FIELD_BIT(f))
+            {
+                record[f] = ids[shard->columns[f][r]];
+            }
+        }
+        add_route(ld, record);
+    }
+    ld->ds->nscanned += shard->nscanned;
+    efree(ids);
+}
+
+/**
+ * Function:  dataset_load_sharded
+ * -------------------------------
+ * @brief  Parses one route file, or every shard a directory or pattern names, into a table.
+ *
+ * Shards are parsed into tables of their own by up to one worker per CPU,
+ * then merged in path order. A shard starts with every field missing,
+ * rather than carrying values over from the end of the previous shard.
+ *
+ * @param ds The table to fill.
+ * @param spec The route file, a directory of shards, or a glob(7) pattern of shards.
+ * @param fields The set of fields to load (ALL_FIELDS for every one).
+ *
+ * @return int 0: No errors; 1: No file was found or one could not be read.
+ *
+ */
+int dataset_load_sharded(dataset_t *ds, const char *spec, unsigned fields)
+{
+    return dataset_load_sample(ds, spec, fields, 1.0);
+}
+
+/**
+ * Function:  dataset_load_sample
+ * ------------------------------
+ * @brief  Parses a random sample of the routes of a file, or of every shard a directory or pattern names, into a table.
+ *
+ * Each route is kept with probability fraction, independently of the
+ * others (Bernoulli sampling), and the routes left out are never parsed.
+ * The sample is pseudo-random but fixed: the same file and fraction always
+ * keep the same routes. A route missing a field takes it from the last
+ * route kept, not the last one read.
+ *
+ * @param ds The table to fill.
+ * @param spec The route file, a directory of shards, or a glob(7) pattern of shards.
+ * @param fields The set of fields to load (ALL_FIELDS for every one).
+ * @param fraction The fraction of the routes to keep, in (0, 1]; 1 loads every route.
+ *
+ * @return int 0: No errors; 1: No file was found or one could not be read.
+ *
+ */
+int dataset_load_sample(dataset_t *ds, const char *spec, unsigned fields, double fraction)
+{
+    loader_t ld = {ds, {NULL, 0, 0}, 0, 0};
+    pthread_t *workers;
+    shards_t job;
+    long nworkers;
+    int i, failed = 0;
+
+    memset(ds, 0, sizeof(dataset_t));
+    job.paths = dataset_paths(spec, &job.npaths);
+    if (job.paths == NULL)
+    {
+        return 1;
+    }
+    if (job.npaths == 1)
+    {
+        failed = load_file(ds, job.paths[0], fields, fraction, 0, 0, NULL, NULL);
+        efree(job.paths[0]);
+        efree(job.paths);
+        return failed;
+    }
+
+    job.shards = (dataset_t *)emalloc(job.npaths * sizeof(dataset_t));
+    job.failed = (int *)emalloc(job.npaths * sizeof(int));
+    job.fields = fields;
+    job.fraction = fraction;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    nworkers = nworkers < 1 ? 1 : nworkers > job.npaths ? job.npaths : nworkers;
+    workers = (pthread_t *)emalloc(nworkers * sizeof(pthread_t));
+    for (i = 0; i < nworkers; i++)
+    {
+        pthread_create(&workers[i], NULL, load_shards, &job);
+    }
+    for (i = 0; i < nworkers; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    efree(workers);
+
+    ds->fields = fields & ALL_FIELDS;
+    ds->sample = fraction < 1.0 ? fraction : 0;
+    strmap_init(&ld.ids, 4096);
+    intern(&ld, "");  // MISSING_ID
+    for (i = 0; i < job.npaths; i++)
+    {
+        failed |= job.failed[i];
+        if (!job.failed[i])
+        {
+            merge_shard(&ld, &job.shards[i]);
+            dataset_free(&job.shards[i]);
+        }
+        efree(job.paths[i]);
+    }
+    strmap_free(&ld.ids, NULL);
+    efree(job.shards);
+    efree(job.failed);
+    efree(job.paths);
+
+    if (failed)
+    {
+        dataset_free(ds);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function:  put_utf8
+ * -------------------
+ * @brief  Writes a code point as UTF-8.
+ *
+ * @param out Where to write (up to 4 bytes).
+ * @param cp The code point.
+ *
+ * @return int The number of bytes written.
+ *
+ */
+static int put_utf8(char *out, unsigned long cp)
+{
+    if (cp < 0x80)
+    {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/**
+ * Function:  dataset_decode
+ * -------------------------
+ * @brief  Decodes a YAML scalar in place the way yaml.safe_load() reads it.
+ *
+ * Single-quoted scalars lose their quotes and '' becomes '; double-quoted
+ * ones have their escapes decoded, \xNN, \uNNNN and \UNNNNNNNN as code
+ * points; plain ones lose their trailing blanks. Empty scalars and null, Null, NULL and ~
+ * are nulls.
+ *
+ * @param value The scalar as written in the file (overwritten).
+ *
+ * @return char* The decoded value, or NULL for a null.
+ *
+ */
+char *dataset_decode(char *value)
+{
+    size_t len = strlen(value);
+    char *in, *out, *end;
+    char digits[9];
+    int width;
+
+    if (value[0] == '\'' && len >= 2 && value[len - 1] == '\'')
+    {
+        value[len - 1] = '\0';
+        for (in = value + 1, out = value; *in != '\0'; in++)
+        {
+            *out++ = *in;
+            if (in[0] == '\'' && in[1] == '\'')
+            {
+                in++;
+            }
+        }
+        *out = '\0';
+        return value;
+    }
+
+    if (value[0] == '"' && len >= 2 && value[len - 1] == '"')
+    {
+        value[len - 1] = '\0';
+        for (in = value + 1, out = value; *in != '\0'; in++)
+        {
+            if (*in != '\\' || in[1] == '\0')
+            {
+                *out++ = *in;
+                continue;
+            }
+            in++;
+            width = *in == 'x' ? 2 : *in == 'u' ? 4 : *in == 'U' ? 8 : 0;
+            if (width > 0 && strlen(in + 1) >= (size_t)width)
+            {
+                memcpy(digits, in + 1, width);
+                digits[width] = '\0';
+                out += put_utf8(out, strtoul(digits, &end, 16));
+                in += width;
+                continue;
+            }
+            switch (*in)
+            {
+            case '0':
+                *out++ = '\0';
+                break;
+            case 'a':
+                *out++ = '\a';
+                break;
+            case 'b':
+                *out++ = '\b';
+                break;
+            case 't':
+                *out++ = '\t';
+                break;
+            case 'n':
+                *out++ = '\n';
+                break;
+            case 'v':
+                *out++ = '\v';
+                break;
+            case 'f':
+                *out++ = '\f';
+                break;
+            case 'r':
+                *out++ = '\r';
+                break;
+            case 'e':
+                *out++ = '\033';
+                break;
+            case 'N':
+                out += put_utf8(out, 0x85);
+                break;
+            case '_':
+                out += put_utf8(out, 0xA0);
+                break;
+            default:
+                *out++ = *in; // \" \\ \/ and an escaped blank stand for themselves
+            }
+        }
+        *out = '\0';
+        return value;
+    }
+
+    while (len > 0 && (value[len - 1] == ' ' || value[len - 1] == '\t'))
+    {
+        value[--len] = '\0';
+    }
+    if (len == 0 || strcmp(value, "~") == 0 || strcmp(value, "null") == 0 ||
+        strcmp(value, "Null") == 0 || strcmp(value, "NULL") == 0)
+    {
+        return NULL;
+    }
+    return value;
+}
+
+/**
+ * Function:  read_records
+ * -----------------------
+ * @brief  Reads a YAML list of flat records, like the a2 airlines, airports and routes files.
+ *
+ * Lines indented deeper than the keys continue the value before them, which
+ * YAML folds in with a single blank.
+ *
+ * @param path The file to read.
+ * @param keys The keys to extract from each record.
+ * @param nkeys The number of keys.
+ * @param fn The function called once per record with the decoded values (NULL where missing or null).
+ * @param arg The argument passed through to fn.
+ *
+ * @return int 0: No errors; 1: The file could not be read.
+ *
+ */
+static int read_records(const char *path, const char **keys, int nkeys, void (*fn)(char **values, void *), void *arg)
+{
+    char line[MAX_LINE_LENGTH];
+    char **raw = (char **)emalloc(nkeys * sizeof(char *));
+    char **values = (char **)emalloc(nkeys * sizeof(char *));
+    char *key, *value, *sep;
+    reader_t *in = open_reader(path);
+    int started = 0;
+    int last = -1;
+    int k, done;
+
+    if (in == NULL)
+    {
+        efree(raw);
+        efree(values);
+        return 1;
+    }
+    memset(raw, 0, nkeys * sizeof(char *));
+
+    // read and ignore the first line
+    fgets(line, MAX_LINE_LENGTH, in->fp);
+
+    for (done = 0; !done;)
+    {
+        done = fgets(line, MAX_LINE_LENGTH, in->fp) == NULL;
+        if (!done)
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (strspn(line, " \t") == strlen(line))
+            {
+                continue;
+            }
+        }
+
+        if (!done && strncmp(line, "    ", 4) == 0)
+        {
+            // a continuation line of the last value
+            if (last >= 0 && raw[last] != NULL)
+            {
+                value = line + strspn(line, " ");
+                raw[last] = (char *)erealloc(MEM_SCRATCH, raw[last], strlen(raw[last]) + strlen(value) + 2);
+                strcat(raw[last], " ");
+                strcat(raw[last], value);
+            }
+            continue;
+        }
+
+        if (done || line[0] == '-')
+        {
+            if (started)
+            {
+                for (k = 0; k < nkeys; k++)
+                {
+                    values[k] = raw[k] != NULL ? dataset_decode(raw[k]) : NULL;
+                }
+                fn(values, arg);
+                for (k = 0; k < nkeys; k++)
+                {
+                    efree(raw[k]);
+                    raw[k] = NULL;
+                }
+            }
+            started = 1;
+            if (done)
+            {
+                break;
+            }
+        }
+
+        key = line + 2;
+        sep = strchr(key, ':');
+        last = -1;
+        if (sep == NULL)
+        {
+            continue;
+        }
+        *sep = '\0';
+        value = sep + 1 + strspn(sep + 1, " ");
+        for (k = 0; k < nkeys; k++)
+        {
+            if (strcmp(key, keys[k]) == 0)
+            {
+                efree(raw[k]);
+                raw[k] = estrdup(MEM_SCRATCH, value);
+                last = k;
+                break;
+            }
+        }
+    }
+
+    efree(raw);
+    efree(values);
+    return close_reader(in);
+}
+
+/**
+ * @brief The state of a join of the a2 files.
+ */
+typedef struct
+{
+    loader_t *ld;
+    strmap_t airlines;
+    strmap_t airports;
+} join_t;
+
+/**
+ * Function:  intern_or_missing
+ * ----------------------------
+ * @brief  Interns a decoded value, reading nulls as the empty string.
+ *
+ * @param ld The load in progress.
+ * @param value The value (may be NULL).
+ *
+ * @return uint32_t The string id (MISSING_ID for nulls).
+ *
+ */
+static uint32_t intern_or_missing(loader_t *ld, const char *value)
+{
+    return value == NULL ? MISSING_ID : intern(ld, value);
+}
+
+/**
+ * Function:  add_airline
+ * ----------------------
+ * @brief  read_records() callback that remembers the fields of one airline by id.
+ *
+ * @param values airline_id, airline_name, airline_icao_unique_code, airline_country.
+ * @param arg The join_t.
+ *
+ */
+static void add_airline(char **values, void *arg)
+{
+    join_t *join = (join_t *)arg;
+    strmap_entry_t *e;
+    uint32_t *fields;
+    int k;
+
+    if (values[0] == NULL)
+    {
+        return;
+    }
+    fields = (uint32_t *)emalloc_as(MEM_INDEXES, 3 * sizeof(uint32_t));
+    for (k = 0; k < 3; k++)
+    {
+        fields[k] = intern_or_missing(join->ld, values[k + 1]);
+    }
+    e = strmap_insert(&join->airlines, values[0], NULL);
+    efree(e->value);
+    e->value = fields;
+}
+
+/**
+ * Function:  add_airport
+ * ----------------------
+ * @brief  read_records() callback that remembers the fields of one airport by id.
+ *
+ * Countries lose their leading blanks, as a2/route_manager.py strips them.
+ *
+ * @param values airport_id, then the five airport fields in route file order.
+ * @param arg The join_t.
+ *
+ */
+static void add_airport(char **values, void *arg)
+{
+    join_t *join = (join_t *)arg;
+    strmap_entry_t *e;
+    uint32_t *fields;
+    int k;
+
+    if (values[0] == NULL)
+    {
+        return;
+    }
+    if (values[3] != NULL)
+    {
+        values[3] += strspn(values[3], " ");
+    }
+    fields = (uint32_t *)emalloc_as(MEM_INDEXES, 5 * sizeof(uint32_t));
+    for (k = 0; k < 5; k++)
+    {
+        fields[k] = intern_or_missing(join->ld, values[k + 1]);
+    }
+    e = strmap_insert(&join->airports, values[0], NULL);
+    efree(e->value);
+    e->value = fields;
+}
+
+/**
+ * Function:  lookup
+ * -----------------
+ * @brief  Finds the fields remembered for an id.
+ *
+ * @param map The airlines or airports by id.
+ * @param id The id (may be NULL).
+ *
+ * @return uint32_t* The fields, or NULL if the id is unknown.
+ *
+ */
+static uint32_t *lookup(strmap_t *map, const char *id)
+{
+    strmap_entry_t *e = id != NULL ? strmap_find(map, id) : NULL;
+
+    return e != NULL ? (uint32_t *)e->value : NULL;
+}
+
+/**
+ * Function:  add_joined_route
+ * ---------------------------
+ * @brief  read_records() callback that joins one route with its airline and airports.
+ *
+ * @param values route_airline_id, route_from_aiport_id, route_to_airport_id.
+ * @param arg The join_t.
+ *
+ */
+static void add_joined_route(char **values, void *arg)
+{
+    join_t *join = (join_t *)arg;
+    uint32_t *airline = lookup(&join->airlines, values[0]);
+    uint32_t *from = lookup(&join->airports, values[1]);
+    uint32_t *to = lookup(&join->airports, values[2]);
+    uint32_t record[FIELD_COUNT];
+    int k;
+
+    for (k = 0; k < 3; k++)
+    {
+        record[FIELD_AIRLINE_NAME + k] = airline != NULL ? airline[k] : MISSING_ID;
+    }
+    for (k = 0; k < 5; k++)
+    {
+        record[FIELD_FROM_NAME + k] = from != NULL ? from[k] : MISSING_ID;
+        record[FIELD_TO_NAME + k] = to != NULL ? to[k] : MISSING_ID;
+    }
+    add_route(join->ld, record);
+}
+
+/**
+ * Function:  dataset_load_joined
+ * ------------------------------
+ * @brief  Loads the a2 airlines, airports and routes files, joined into a table.
+ *
+ * Routes are left-joined with their airline and both airports, so a route
+ * whose airline or airport id is unknown keeps MISSING_ID in those fields.
+ * Values are decoded as yaml.safe_load() would decode them.
+ *
+ * @param ds The table to fill.
+ * @param airlines The path of airlines.yaml.
+ * @param airports The path of airports.yaml.
+ * @param routes The path of routes.yaml.
+ *
+ * @return int 0: No errors; 1: A file could not be read.
+ *
+ */
+int dataset_load_joined(dataset_t *ds, const char *airlines, const char *airports, const char *routes)
+{
+    const char *airline_keys[] = {"airline_id", "airline_name", "airline_icao_unique_code", "airline_country"};
+    const char *airport_keys[] = {"airport_id", "airport_name", "airport_city", "airport_country",
+                                  "airport_icao_unique_code", "airport_altitude"};
+    const char *route_keys[] = {"route_airline_id", "route_from_aiport_id", "route_to_airport_id"};
+    loader_t ld = {ds, {NULL, 0, 0}, 0, 0};
+    join_t join;
+    int failed;
+
+    memset(ds, 0, sizeof(dataset_t));
+    ds->fields = ALL_FIELDS;
+    strmap_init(&ld.ids, 4096);
+    intern(&ld, "");
+
+    join.ld = &ld;
+    strmap_init(&join.airlines, 8192);
+    strmap_init(&join.airports, 8192);
+
+    failed = read_records(airlines, airline_keys, 4, add_airline, &join) ||
+             read_records(airports, airport_keys, 6, add_airport, &join) ||
+             read_records(routes, route_keys, 3, add_joined_route, &join);
+
+    strmap_free(&join.airlines, efree);
+    strmap_free(&join.airports, efree);
+    strmap_free(&ld.ids, NULL);
+    ds->nscanned = ds->nroutes;
+    if (failed)
+    {
+        dataset_free(ds);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function:  dataset_value
+ * ------------------------
+ * @brief  Returns one field of one route.
+ *
+ * @param ds The table.
+ * @param field The field to read.
+ * @param route The index of the route.
+ *
+ * @return const char* The value, owned by the table.
+ *
+ */
+const char *dataset_value(const dataset_t *ds, field_t field, size_t route)
+{
+    return ds->pool + ds->offsets[ds->columns[field][route]];
+}
+
+/**
+ * Function:  dataset_string
+ * -------------------------
+ * @brief  Returns the value a string id stands for.
+ *
+ * @param ds The table.
+ * @param id The string id.
+ *
+ * @return const char* The value, owned by the table.
+ *
+ */
+const char *dataset_string(const dataset_t *ds, uint32_t id)
+{
+    return ds->pool + ds->offsets[id];
+}
+
+/**
+ * Function:  dataset_find
+ * -----------------------
+ * @brief  Returns the string id of a value, so that routes can be matched on ids rather than strings.
+ *
+ * Every distinct value is stored once, so no other id stands for it.
+ *
+ * @param ds The table.
+ * @param value The value to look for.
+ *
+ * @return uint32_t Its string id, or nstrings (which no column holds) if no route has it.
+ *
+ */
+uint32_t dataset_find(const dataset_t *ds, const char *value)
+{
+    uint32_t id;
+
+    for (id = 0; id < ds->nstrings; id++)
+    {
+        if (strcmp(ds->pool + ds->offsets[id], value) == 0)
+        {
+            return id;
+        }
+    }
+    return ds->nstrings;
+}
+
+/**
+ * Function:  dataset_free
+ * -----------------------
+ * @brief  Releases everything a table holds.
+ *
+ * @param ds The table.
+ *
+ */
+void dataset_free(dataset_t *ds)
+{
+    int f;
+
+    if (ds->segment != NULL)
+    {
+        cube_free(ds->cube);
+        munmap(ds->segment, ds->segment_size);
+        memset(ds, 0, sizeof(dataset_t));
+        return;
+    }
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        efree(ds->columns[f]);
+    }
+    efree(ds->pool);
+    efree(ds->offsets);
+    cube_free(ds->cube);
+    memset(ds, 0, sizeof(dataset_t));
+}
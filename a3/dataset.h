@@ -0,0 +1,98 @@
+/** @file dataset.h
+ *  @brief Function prototypes for the in-memory route table.
+ *
+ */
+#ifndef _DATASET_H_
+#define _DATASET_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// no value is longer than the longest line the parser accepts
+#define MAX_VALUE_LENGTH 1024
+
+/**
+ * @brief The fields of a route record, in the order they appear in the file.
+ */
+typedef enum
+{
+    FIELD_AIRLINE_NAME,
+    FIELD_AIRLINE_ICAO,
+    FIELD_AIRLINE_COUNTRY,
+    FIELD_FROM_NAME,
+    FIELD_FROM_CITY,
+    FIELD_FROM_COUNTRY,
+    FIELD_FROM_ICAO,
+    FIELD_FROM_ALTITUDE,
+    FIELD_TO_NAME,
+    FIELD_TO_CITY,
+    FIELD_TO_COUNTRY,
+    FIELD_TO_ICAO,
+    FIELD_TO_ALTITUDE,
+    FIELD_COUNT
+} field_t;
+
+extern const char *FIELD_NAMES[FIELD_COUNT];
+
+// string id 0 is always the empty string, which missing values read as
+#define MISSING_ID 0
+
+// bit of a field in a set of fields
+#define FIELD_BIT(f) (1u << (f))
+#define ALL_FIELDS (FIELD_BIT(FIELD_COUNT) - 1)
+
+/**
+ * @brief A route file parsed into dictionary-encoded columns.
+ *
+ * Every distinct value is stored once, NUL-terminated, in pool; offsets maps
+ * a string id to where it starts. Each field is a column of nroutes string
+ * ids. Values are kept as they appear in the file (only the blank after the
+ * colon is dropped), so questions decide for themselves how to clean them.
+ * Only the fields in the fields set are loaded; the columns of the others
+ * are NULL. A sampled table holds only the fraction sample of the routes
+ * (see dataset_load_sample()); sample is 0 when it holds them all, and
+ * nscanned counts the routes read either way. A table attached to a
+ * shared segment (see segment.h) points into the mapping of segment
+ * instead of owning its pool and columns. A table is never modified
+ * after dataset_load() returns, except that a rollup cube of it may be
+ * attached once (see cube.h) before it is shared; cube is NULL until then.
+ */
+typedef struct dataset_t
+{
+    char *pool;
+    size_t pool_size;
+    uint64_t *offsets;
+    uint32_t nstrings;
+    uint32_t *columns[FIELD_COUNT];
+    size_t nroutes;
+    size_t nscanned;
+    double sample;
+    unsigned fields;
+    struct cube_t *cube;
+    void *segment;
+    size_t segment_size;
+} dataset_t;
+
+/**
+ * @brief Receives each window of routes of a streamed file (see dataset_stream()).
+ */
+typedef void (*dataset_window_fn)(const dataset_t *, void *arg);
+
+/**
+ * Function protypes associated with a route table.
+ */
+int dataset_load(dataset_t *, const char *path, unsigned fields);
+int dataset_load_sharded(dataset_t *, const char *spec, unsigned fields);
+int dataset_load_sample(dataset_t *, const char *spec, unsigned fields, double fraction);
+int dataset_stream(dataset_t *, const char *path, unsigned fields, size_t window, dataset_window_fn fn, void *arg);
+char **dataset_paths(const char *spec, int *npaths);
+int dataset_split_line(char *line, char **key, char **value);
+int dataset_field(const char *key, int expected);
+int dataset_load_joined(dataset_t *, const char *airlines, const char *airports, const char *routes);
+const char *dataset_value(const dataset_t *, field_t field, size_t route);
+const char *dataset_string(const dataset_t *, uint32_t id);
+uint32_t dataset_find(const dataset_t *, const char *value);
+char *dataset_decode(char *value);
+void dataset_free(dataset_t *);
+
+#endif
@@ -0,0 +1,261 @@
+/** @file distinct.c
+ *  @brief Implementation of distinct.h
+ *
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "hash.h"
+#include "strmap.h"
+#include "distinct.h"
+
+/**
+ * Function:  hll_init
+ * -------------------
+ * @brief  Prepares an empty HyperLogLog sketch.
+ *
+ * @param hll The sketch to initialise.
+ * @param precision The number of index bits (HLL_MIN_PRECISION to HLL_MAX_PRECISION).
+ *
+ */
+void hll_init(hll_t *hll, int precision)
+{
+    size_t m = (size_t)1 << precision;
+
+    hll->precision = precision;
+    hll->registers = (unsigned char *)emalloc_as(MEM_INDEXES, m);
+    memset(hll->registers, 0, m);
+}
+
+/**
+ * Function:  hll_add
+ * ------------------
+ * @brief  Adds a hashed member to a HyperLogLog sketch.
+ *
+ * The top precision bits pick a register, which keeps the longest run of
+ * leading zeros (plus one) seen in the remaining bits.
+ *
+ * @param hll The sketch.
+ * @param hash The 64-bit hash of the member.
+ *
+ */
+void hll_add(hll_t *hll, uint64_t hash)
+{
+    uint64_t index = hash >> (64 - hll->precision);
+    uint64_t rest = hash << hll->precision;
+    unsigned char rank = 1;
+
+    while (rank <= 64 - hll->precision && (rest & (1ULL << 63)) == 0)
+    {
+        rank++;
+        rest <<= 1;
+    }
+    if (rank > hll->registers[index])
+    {
+        hll->registers[index] = rank;
+    }
+}
+
+/**
+ * Function:  hll_count
+ * --------------------
+ * @brief  Estimates the number of distinct members added to a sketch.
+ *
+ * @param hll The sketch.
+ *
+ * @return double The estimate, using linear counting while registers are still empty.
+ *
+ */
+double hll_count(const hll_t *hll)
+{
+    size_t m = (size_t)1 << hll->precision;
+    double alpha, sum = 0.0, estimate;
+    size_t zeros = 0;
+    size_t i;
+
+    switch (hll->precision)
+    {
+    case 4:
+        alpha = 0.673;
+        break;
+    case 5:
+        alpha = 0.697;
+        break;
+    case 6:
+        alpha = 0.709;
+        break;
+    default:
+        alpha = 0.7213 / (1.0 + 1.079 / m);
+    }
+
+    for (i = 0; i < m; i++)
+    {
+        sum += ldexp(1.0, -hll->registers[i]);
+        if (hll->registers[i] == 0)
+        {
+            zeros++;
+        }
+    }
+    estimate = alpha * m * m / sum;
+
+    if (estimate <= 2.5 * m && zeros > 0)
+    {
+        estimate = m * log((double)m / zeros);
+    }
+    return estimate;
+}
+
+/**
+ * @brief The members seen for one group.
+ */
+typedef struct
+{
+    strmap_t members;
+    hll_t hll;
+} group_t;
+
+/**
+ * Function:  distinct_init
+ * ------------------------
+ * @brief  Prepares an empty grouped distinct count.
+ *
+ * @param d The count to initialise.
+ * @param precision 0 for exact sets, otherwise the HyperLogLog precision.
+ *
+ */
+void distinct_init(distinct_t *d, int precision)
+{
+    strmap_init(&d->groups, 256);
+    d->precision = precision;
+}
+
+/**
+ * Function:  distinct_add
+ * -----------------------
+ * @brief  Records that a member was seen in a group.
+ *
+ * @param d The count to add to.
+ * @param group The group key.
+ * @param member The member key.
+ *
+ */
+void distinct_add(distinct_t *d, const char *group, const char *member)
+{
+    strmap_entry_t *e = strmap_insert(&d->groups, group, NULL);
+    group_t *g = (group_t *)e->value;
+
+    if (g == NULL)
+    {
+        g = (group_t *)emalloc_as(MEM_INDEXES, sizeof(group_t));
+        if (d->precision > 0)
+        {
+            hll_init(&g->hll, d->precision);
+            g->members.entries = NULL;
+        }
+        else
+        {
+            strmap_init(&g->members, 16);
+        }
+        e->value = g;
+    }
+
+    if (d->precision > 0)
+    {
+        hll_add(&g->hll, hash_string(member));
+    }
+    else
+    {
+        strmap_insert(&g->members, member, NULL);
+    }
+}
+
+/**
+ * Function:  free_group
+ * ---------------------
+ * @brief  Releases the members of one group.
+ *
+ * @param value The group_t to release.
+ *
+ */
+static void free_group(void *value)
+{
+    group_t *g = (group_t *)value;
+
+    if (g->members.entries != NULL)
+    {
+        strmap_free(&g->members, NULL);
+    }
+    else
+    {
+        efree(g->hll.registers);
+    }
+    efree(g);
+}
+
+/**
+ * Function:  distinct_finish
+ * --------------------------
+ * @brief  Reports every group in strcmp() order with its distinct count, and releases the count.
+ *
+ * @param d The count to finish.
+ * @param fn The function called once per group.
+ * @param arg The argument passed through to fn.
+ *
+ */
+void distinct_finish(distinct_t *d, void (*fn)(char *key, int count, void *), void *arg)
+{
+    strmap_entry_t **sorted = strmap_sorted(&d->groups);
+    group_t *g;
+    size_t i;
+
+    for (i = 0; i < d->groups.size; i++)
+    {
+        g = (group_t *)sorted[i]->value;
+        if (d->precision > 0)
+        {
+            fn(sorted[i]->key, (int)(hll_count(&g->hll) + 0.5), arg);
+        }
+        else
+        {
+            fn(sorted[i]->key, (int)g->members.size, arg);
+        }
+    }
+
+    efree(sorted);
+    strmap_free(&d->groups, free_group);
+}
+
+/**
+ * Function:  distinct_members
+ * ---------------------------
+ * @brief  Reports every member of every group, and releases the count (exact counts only).
+ *
+ * Groups come in strcmp() order, and the members of each group in strcmp() order.
+ *
+ * @param d The exact count to finish.
+ * @param fn The function called once per member.
+ * @param arg The argument passed through to fn.
+ *
+ */
+void distinct_members(distinct_t *d, void (*fn)(const char *group, const char *member, void *), void *arg)
+{
+    strmap_entry_t **sorted = strmap_sorted(&d->groups);
+    strmap_entry_t **members;
+    group_t *g;
+    size_t i, m;
+
+    for (i = 0; i < d->groups.size && d->precision == 0; i++)
+    {
+        g = (group_t *)sorted[i]->value;
+        members = strmap_sorted(&g->members);
+        for (m = 0; m < g->members.size; m++)
+        {
+            fn(sorted[i]->key, members[m]->key, arg);
+        }
+        efree(members);
+    }
+
+    efree(sorted);
+    strmap_free(&d->groups, free_group);
+}
@@ -0,0 +1,47 @@
+/** @file distinct.h
+ *  @brief Function prototypes for grouped distinct counting.
+ *
+ */
+#ifndef _DISTINCT_H_
+#define _DISTINCT_H_
+
+#include <stdint.h>
+#include "strmap.h"
+
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 18
+
+/**
+ * @brief A HyperLogLog sketch of 2^precision one-byte registers.
+ */
+typedef struct
+{
+    int precision;
+    unsigned char *registers;
+} hll_t;
+
+/**
+ * @brief Counts the distinct members seen for each group.
+ *
+ * With precision 0 every group keeps an exact set of its members; otherwise
+ * every group keeps a HyperLogLog sketch, whose size is fixed by precision
+ * (relative error about 1.04 / sqrt(2^precision)).
+ */
+typedef struct
+{
+    strmap_t groups;
+    int precision;
+} distinct_t;
+
+/**
+ * Function protypes associated with distinct counting.
+ */
+void hll_init(hll_t *, int precision);
+void hll_add(hll_t *, uint64_t hash);
+double hll_count(const hll_t *);
+void distinct_init(distinct_t *, int precision);
+void distinct_add(distinct_t *, const char *group, const char *member);
+void distinct_finish(distinct_t *, void (*fn)(char *key, int count, void *), void *arg);
+void distinct_members(distinct_t *, void (*fn)(const char *group, const char *member, void *), void *arg);
+
+#endif
@@ -1,15 +1,121 @@
 /** @file emalloc.c
  *  @brief Implementation of emalloc.h
  *
+ * Every block starts with a header recording its size and category, so
+ * efree() and erealloc() can take it off the right counts. The counts are
+ * the only state shared by the whole process; they are updated with atomic
+ * operations, so threads allocate without a lock.
+ *
  */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
 #include "emalloc.h"
 
+/**
+ * @brief The header in front of every block (16 bytes, so the block keeps malloc's alignment).
+ */
+typedef struct
+{
+    size_t size;
+    size_t category;
+} header_t;
+
+static mem_stats_t stats[MEM_CATEGORIES];
+static long total_live;
+static long total_peak;
+
+static const char *CATEGORY_NAMES[MEM_CATEGORIES] = {"scratch", "list nodes", "node strings", "route fields",
+                                                     "indexes"};
+
+/**
+ * Function:  raise_peak
+ * ---------------------
+ * @brief  Raises a peak to a new live count if it is higher.
+ *
+ * @param peak The peak.
+ * @param live The live count.
+ *
+ */
+static void raise_peak(long *peak, long live)
+{
+    long seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while (live > seen && !__atomic_compare_exchange_n(peak, &seen, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/**
+ * Function:  account
+ * ------------------
+ * @brief  Counts bytes becoming live (or, if negative, freed) in a category.
+ *
+ * @param category The category.
+ * @param delta The change in live bytes.
+ *
+ */
+static void account(size_t category, long delta)
+{
+    raise_peak(&stats[category].peak, __atomic_add_fetch(&stats[category].live, delta, __ATOMIC_RELAXED));
+    raise_peak(&total_peak, __atomic_add_fetch(&total_live, delta, __ATOMIC_RELAXED));
+}
+
+/**
+ * Function:  erealloc
+ * -------------------
+ * @brief Represents a wrapper to realloc that accounts for the block and exits if memory runs out.
+ *
+ * @param category What the block is for.
+ * @param p The block to resize (NULL for a new one); it must come from this file.
+ * @param n The new size.
+ *
+ * @return void* The resized block.
+ *
+ */
+void *erealloc(mem_category_t category, void *p, size_t n)
+{
+    header_t *h = p == NULL ? NULL : (header_t *)p - 1;
+
+    if (h != NULL)
+    {
+        account(h->category, -(long)h->size);
+    }
+    h = (header_t *)realloc(h, sizeof(header_t) + n);
+    if (h == NULL)
+    {
+        fprintf(stderr, "malloc of %zu bytes failed", n);
+        exit(1);
+    }
+    h->size = n;
+    h->category = category;
+    __atomic_add_fetch(&stats[category].allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats[category].bytes, (long)n, __ATOMIC_RELAXED);
+    account(category, (long)n);
+
+    return h + 1;
+}
+
+/**
+ * Function:  emalloc_as
+ * ---------------------
+ * @brief Allocates a block for a given category, exiting if memory runs out.
+ *
+ * @param category What the block is for.
+ * @param n The size of the object to reserve dynamic memory for.
+ *
+ * @return void* The block (release it with efree()).
+ *
+ */
+void *emalloc_as(mem_category_t category, size_t n)
+{
+    return erealloc(category, NULL, n);
+}
+
 /**
  * Function:  emalloc
  * --------------------
- * @brief Represents a wrapper to malloc to use it in a safer way.
+ * @brief Represents a wrapper to malloc to use it in a safer way; the block counts as scratch.
  *
  * @param size_t The size of the object to reserve dynamic memory for.
  *
@@ -18,14 +124,99 @@
  */
 void *emalloc(size_t n)
 {
-    void *p;
+    return erealloc(MEM_SCRATCH, NULL, n);
+}
+
+/**
+ * Function:  estrdup
+ * ------------------
+ * @brief Copies a string into a block of a given category.
+ *
+ * @param category What the copy is for.
+ * @param s The string.
+ *
+ * @return char* The copy (release it with efree()).
+ *
+ */
+char *estrdup(mem_category_t category, const char *s)
+{
+    size_t n = strlen(s) + 1;
+
+    return (char *)memcpy(erealloc(category, NULL, n), s, n);
+}
+
+/**
+ * Function:  efree
+ * ----------------
+ * @brief Releases a block from emalloc(), emalloc_as(), erealloc() or estrdup().
+ *
+ * @param p The block (may be NULL).
+ *
+ */
+void efree(void *p)
+{
+    header_t *h;
 
-    p = malloc(n);
     if (p == NULL)
     {
-        fprintf(stderr, "malloc of %zu bytes failed", n);
-        exit(1);
+        return;
     }
+    h = (header_t *)p - 1;
+    account(h->category, -(long)h->size);
+    free(h);
+}
+
+/**
+ * Function:  emalloc_stats
+ * ------------------------
+ * @brief  Returns the allocations made so far, per category and in total.
+ *
+ * @param out Set to the counts of each category.
+ * @param total Set to the sums (its peak is the most bytes live at once, over every category).
+ *
+ */
+void emalloc_stats(mem_stats_t out[MEM_CATEGORIES], mem_stats_t *total)
+{
+    int c;
+
+    memset(total, 0, sizeof(mem_stats_t));
+    for (c = 0; c < MEM_CATEGORIES; c++)
+    {
+        out[c].allocs = __atomic_load_n(&stats[c].allocs, __ATOMIC_RELAXED);
+        out[c].bytes = __atomic_load_n(&stats[c].bytes, __ATOMIC_RELAXED);
+        out[c].live = __atomic_load_n(&stats[c].live, __ATOMIC_RELAXED);
+        out[c].peak = __atomic_load_n(&stats[c].peak, __ATOMIC_RELAXED);
+        total->allocs += out[c].allocs;
+        total->bytes += out[c].bytes;
+    }
+    total->live = __atomic_load_n(&total_live, __ATOMIC_RELAXED);
+    total->peak = __atomic_load_n(&total_peak, __ATOMIC_RELAXED);
+}
 
-    return p;
+/**
+ * Function:  emalloc_report
+ * -------------------------
+ * @brief  Prints a table of the allocations per category, and the process's peak RSS.
+ *
+ * @param out Where to print it.
+ *
+ */
+void emalloc_report(FILE *out)
+{
+    mem_stats_t counts[MEM_CATEGORIES], total;
+    struct rusage usage;
+    int c;
+
+    emalloc_stats(counts, &total);
+    fprintf(out, "%-14s %12s %14s %14s %14s\n", "category", "allocs", "bytes", "live bytes", "peak bytes");
+    for (c = 0; c < MEM_CATEGORIES; c++)
+    {
+        fprintf(out, "%-14s %12ld %14ld %14ld %14ld\n", CATEGORY_NAMES[c], counts[c].allocs, counts[c].bytes,
+                counts[c].live, counts[c].peak);
+    }
+    fprintf(out, "%-14s %12ld %14ld %14ld %14ld\n", "total", total.allocs, total.bytes, total.live, total.peak);
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        fprintf(out, "peak RSS: %ld KiB\n", usage.ru_maxrss);
+    }
 }
@@ -5,6 +5,42 @@
 #ifndef _EMALLOC_H_
 #define _EMALLOC_H_
 
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * @brief What an allocation is for; every category is accounted separately.
+ */
+typedef enum
+{
+    MEM_SCRATCH,       // buffers and arrays that live for one step
+    MEM_LIST_NODES,    // nodes of the linked lists
+    MEM_NODE_STRINGS,  // strings owned by list nodes, map entries and counters
+    MEM_ROUTE_FIELDS,  // the string pool and columns of a dataset
+    MEM_INDEXES,       // hash tables, cubes, matrices and sketches
+    MEM_CATEGORIES
+} mem_category_t;
+
+/**
+ * @brief The allocations of one category so far.
+ */
+typedef struct
+{
+    long allocs; // allocations made (a realloc counts as one)
+    long bytes;  // bytes asked for, over every allocation
+    long live;   // bytes allocated and not yet freed
+    long peak;   // the most bytes ever live at once
+} mem_stats_t;
+
+/**
+ * Function protypes associated with emalloc.
+ */
 void *emalloc(size_t);
+void *emalloc_as(mem_category_t, size_t);
+void *erealloc(mem_category_t, void *, size_t);
+char *estrdup(mem_category_t, const char *);
+void efree(void *);
+void emalloc_stats(mem_stats_t stats[MEM_CATEGORIES], mem_stats_t *total);
+void emalloc_report(FILE *);
 
 #endif
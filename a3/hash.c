@@ -0,0 +1,57 @@
+/** @file hash.c
+ *  @brief Implementation of hash.h
+ *
+ */
+#include <string.h>
+#include "hash.h"
+
+/**
+ * Function:  hash_bytes
+ * ---------------------
+ * @brief  Hashes a block of bytes with FNV-1a followed by a 64-bit finaliser.
+ *
+ * The finaliser spreads every input bit over the whole word, so the low and
+ * high bits can be used independently (table slots, sketch rows, registers).
+ *
+ * @param data The bytes to hash.
+ * @param len The number of bytes.
+ * @param seed Selects an independent hash function.
+ *
+ * @return uint64_t The hash value.
+ *
+ */
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/**
+ * Function:  hash_string
+ * ----------------------
+ * @brief  Hashes a NUL-terminated key.
+ *
+ * @param key The key to hash.
+ *
+ * @return uint64_t The hash value.
+ *
+ */
+uint64_t hash_string(const char *key)
+{
+    return hash_bytes(key, strlen(key), 0);
+}
@@ -0,0 +1,17 @@
+/** @file hash.h
+ *  @brief Function prototypes for hashing keys.
+ *
+ */
+#ifndef _HASH_H_
+#define _HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Function protypes associated with hashing.
+ */
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed);
+uint64_t hash_string(const char *key);
+
+#endif
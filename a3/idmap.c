@@ -0,0 +1,159 @@
+/** @file idmap.c
+ *  @brief Implementation of idmap.h
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "hash.h"
+#include "idmap.h"
+
+/**
+ * Function:  idmap_init
+ * ---------------------
+ * @brief  Prepares an empty map.
+ *
+ * @param map The map to initialise.
+ * @param width The number of ids in every tuple.
+ * @param hint The number of tuples expected (the map grows past it if needed).
+ *
+ */
+void idmap_init(idmap_t *map, int width, size_t hint)
+{
+    size_t cap = 16;
+
+    while (cap < 2 * hint)
+    {
+        cap *= 2;
+    }
+
+    map->width = width;
+    map->slots = (uint32_t *)emalloc_as(MEM_INDEXES, cap * sizeof(uint32_t));
+    memset(map->slots, 0, cap * sizeof(uint32_t));
+    map->cap = cap;
+    map->ids = NULL;
+    map->counts = NULL;
+    map->nmembers = 0;
+    map->member_cap = 0;
+}
+
+/**
+ * Function:  probe
+ * ----------------
+ * @brief  Finds the slot holding a tuple, or the empty slot where it would go.
+ *
+ * @param map The map to search.
+ * @param ids The tuple to look for.
+ *
+ * @return uint32_t* The slot.
+ *
+ */
+static uint32_t *probe(idmap_t *map, const uint32_t *ids)
+{
+    size_t bytes = map->width * sizeof(uint32_t);
+    size_t mask = map->cap - 1;
+    size_t i = hash_bytes(ids, bytes, 0) & mask;
+
+    while (map->slots[i] != 0 && memcmp(map->ids + (size_t)(map->slots[i] - 1) * map->width, ids, bytes) != 0)
+    {
+        i = (i + 1) & mask;
+    }
+    return &map->slots[i];
+}
+
+/**
+ * Function:  grow
+ * ---------------
+ * @brief  Doubles the table and re-inserts every tuple.
+ *
+ * @param map The map to grow.
+ *
+ */
+static void grow(idmap_t *map)
+{
+    size_t m;
+
+    efree(map->slots);
+    map->cap *= 2;
+    map->slots = (uint32_t *)emalloc_as(MEM_INDEXES, map->cap * sizeof(uint32_t));
+    memset(map->slots, 0, map->cap * sizeof(uint32_t));
+    for (m = 0; m < map->nmembers; m++)
+    {
+        *probe(map, map->ids + m * map->width) = (uint32_t)m + 1;
+    }
+}
+
+/**
+ * Function:  idmap_add
+ * --------------------
+ * @brief  Counts one occurrence of a tuple, numbering it if it is new.
+ *
+ * @param map The map to add to.
+ * @param ids The tuple (width ids).
+ *
+ * @return uint32_t The tuple's number.
+ *
+ */
+uint32_t idmap_add(idmap_t *map, const uint32_t *ids)
+{
+    uint32_t *slot = probe(map, ids);
+
+    if (*slot == 0)
+    {
+        if (2 * (map->nmembers + 1) > map->cap)
+        {
+            grow(map);
+            slot = probe(map, ids);
+        }
+        if (map->nmembers == map->member_cap)
+        {
+            map->member_cap = map->member_cap == 0 ? 64 : 2 * map->member_cap;
+            map->ids = (uint32_t *)erealloc(MEM_INDEXES, map->ids, map->member_cap * map->width * sizeof(uint32_t));
+            map->counts = (long *)erealloc(MEM_INDEXES, map->counts, map->member_cap * sizeof(long));
+        }
+        memcpy(map->ids + map->nmembers * map->width, ids, map->width * sizeof(uint32_t));
+        map->counts[map->nmembers] = 0;
+        *slot = (uint32_t)++map->nmembers;
+    }
+    map->counts[*slot - 1]++;
+    return *slot - 1;
+}
+
+/**
+ * Function:  idmap_merge
+ * ----------------------
+ * @brief  Adds every tuple of another map with its count, numbering the new ones in the other map's order.
+ *
+ * @param map The map to add to.
+ * @param other The map to add (same width, unchanged).
+ *
+ */
+void idmap_merge(idmap_t *map, const idmap_t *other)
+{
+    size_t m;
+
+    for (m = 0; m < other->nmembers; m++)
+    {
+        map->counts[idmap_add(map, other->ids + m * other->width)] += other->counts[m] - 1;
+    }
+}
+
+/**
+ * Function:  idmap_free
+ * ---------------------
+ * @brief  Releases a map.
+ *
+ * @param map The map to release.
+ *
+ */
+void idmap_free(idmap_t *map)
+{
+    efree(map->slots);
+    efree(map->ids);
+    efree(map->counts);
+    map->slots = NULL;
+    map->ids = NULL;
+    map->counts = NULL;
+    map->nmembers = 0;
+    map->cap = 0;
+}
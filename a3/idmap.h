@@ -0,0 +1,38 @@
+/** @file idmap.h
+ *  @brief Function prototypes for the map counting tuples of string ids.
+ *
+ */
+#ifndef _IDMAP_H_
+#define _IDMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief An open-addressing hash map numbering tuples of string ids and counting each.
+ *
+ * Every tuple is width ids long. Distinct tuples are numbered densely from
+ * 0 in order of first appearance; ids holds the width ids of each and
+ * counts how many times it was added. The table doubles whenever it
+ * becomes more than half full.
+ */
+typedef struct
+{
+    int width;
+    uint32_t *slots; // member number + 1, or 0 for an empty slot
+    size_t cap;
+    uint32_t *ids;
+    long *counts;
+    size_t nmembers;
+    size_t member_cap;
+} idmap_t;
+
+/**
+ * Function protypes associated with an id map.
+ */
+void idmap_init(idmap_t *, int width, size_t hint);
+uint32_t idmap_add(idmap_t *, const uint32_t *ids);
+void idmap_merge(idmap_t *, const idmap_t *other);
+void idmap_free(idmap_t *);
+
+#endif
@@ -29,9 +29,9 @@ node_t *new_node(char *val, int count)
 {
     assert(val != NULL);
 
-    node_t *temp = (node_t *)emalloc(sizeof(node_t));
+    node_t *temp = (node_t *)emalloc_as(MEM_LIST_NODES, sizeof(node_t));
 
-    temp->word = strdup(val);
+    temp->word = estrdup(MEM_NODE_STRINGS, val);
     temp->count = count;
     temp->next = NULL;
 
@@ -274,3 +274,23 @@ void apply(node_t *list,
         (*fn)(list, arg);
     }
 }
+
+/**
+ * Function: free_list
+ * -------------------
+ * @brief  Releases every node in the list together with its word.
+ *
+ * @param list The list (i.e., pointer to head node) to release.
+ *
+ */
+void free_list(node_t *list)
+{
+    node_t *next;
+
+    for (; list != NULL; list = next)
+    {
+        next = list->next;
+        efree(list->word);
+        efree(list);
+    }
+}
@@ -27,5 +27,6 @@ node_t *sortAscending(node_t *list, node_t *new);
 node_t *peek_front(node_t *);
 node_t *remove_front(node_t *);
 void apply(node_t *, void (*fn)(node_t *, void *), void *arg);
+void free_list(node_t *);
 
 #endif
@@ -0,0 +1,225 @@
+/** @file live.c
+ *  @brief A route file that can be replaced while it is queried (the rm_live_ functions of routemanager.h).
+ *
+ * Every loaded file is a snapshot in one of LIVE_SLOTS slots. The current
+ * snapshot is published in a single 64-bit word holding its slot and the
+ * number of times it has been acquired since it was published, so a query
+ * takes its reference with one atomic add and never waits. A reload loads
+ * and indexes the new file first, then swaps the word: the acquisitions it
+ * swaps out are handed to the old snapshot's own count, which every release
+ * counts down, and whoever brings that count to zero frees the snapshot.
+ * This is split reference counting; it needs no lock on the query side and
+ * no pointer a reader could find freed.
+ *
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "emalloc.h"
+#include "routemanager.h"
+
+// snapshots that may be alive at once: the current one and those still being read
+#define LIVE_SLOTS 8
+
+// the low bits of the current word count acquisitions, the high bits name the slot
+#define COUNT_BITS 56
+#define COUNT_MASK (((uint64_t)1 << COUNT_BITS) - 1)
+
+/**
+ * @brief One loaded file and the references to it not yet handed over.
+ */
+typedef struct
+{
+    rm_dataset_t *ds; // NULL while the slot is free
+    long refs;        // releases count it down; swapping it out adds its acquisitions
+} snapshot_t;
+
+/**
+ * @brief The snapshots of a live route file.
+ */
+struct live_t
+{
+    uint64_t current;
+    snapshot_t slots[LIVE_SLOTS];
+    int cube;
+    pthread_mutex_t reload; // one reload at a time; queries never take it
+};
+
+/**
+ * Function:  load
+ * ---------------
+ * @brief  Loads a snapshot, with every index it is queried through already built.
+ *
+ * @param path The route file, directory or pattern of shards.
+ * @param cube Whether to build the rollup cube.
+ *
+ * @return rm_dataset_t* The dataset, or NULL if it could not be read.
+ *
+ */
+static rm_dataset_t *load(const char *path, int cube)
+{
+    rm_dataset_t *ds = rm_open(path);
+
+    if (ds != NULL && cube)
+    {
+        rm_build_cube(ds);
+    }
+    return ds;
+}
+
+/**
+ * Function:  drop
+ * ---------------
+ * @brief  Counts references off a snapshot, freeing it and its slot when none are left.
+ *
+ * @param live The live file.
+ * @param slot The snapshot's slot.
+ * @param n The number of references dropped (negative to hand over acquisitions).
+ *
+ */
+static void drop(rm_live_t *live, int slot, long n)
+{
+    snapshot_t *s = &live->slots[slot];
+
+    // take the snapshot out of its slot before freeing it, so no reload can
+    // reuse the slot while it still names freed memory
+    if (__atomic_sub_fetch(&s->refs, n, __ATOMIC_ACQ_REL) == 0)
+    {
+        rm_close(__atomic_exchange_n(&s->ds, NULL, __ATOMIC_ACQ_REL));
+    }
+}
+
+/**
+ * Function:  rm_live_open
+ * -----------------------
+ * @brief  Loads a route file that rm_live_reload() may later replace.
+ *
+ * @param path The route file, directory or pattern of shards, as for rm_open().
+ * @param cube Whether every snapshot is published with its rollup cube built.
+ *
+ * @return rm_live_t* The live file, or NULL if the file could not be read.
+ *
+ */
+rm_live_t *rm_live_open(const char *path, int cube)
+{
+    rm_dataset_t *ds = load(path, cube);
+    rm_live_t *live;
+    int i;
+
+    if (ds == NULL)
+    {
+        return NULL;
+    }
+    live = (rm_live_t *)emalloc_as(MEM_INDEXES, sizeof(rm_live_t));
+    for (i = 0; i < LIVE_SLOTS; i++)
+    {
+        live->slots[i].ds = NULL;
+        live->slots[i].refs = 0;
+    }
+    live->slots[0].ds = ds;
+    live->current = 0;
+    live->cube = cube;
+    pthread_mutex_init(&live->reload, NULL);
+    return live;
+}
+
+/**
+ * Function:  rm_live_acquire
+ * --------------------------
+ * @brief  Takes a reference to the current snapshot, which stays valid until rm_live_release().
+ *
+ * Never blocks; a reload published meanwhile is seen by the next acquire.
+ *
+ * @param live The live file.
+ * @param slot Set to the snapshot's slot, which rm_live_release() takes back.
+ *
+ * @return const rm_dataset_t* The snapshot, to query like any dataset.
+ *
+ */
+const rm_dataset_t *rm_live_acquire(rm_live_t *live, int *slot)
+{
+    uint64_t word = __atomic_fetch_add(&live->current, 1, __ATOMIC_ACQUIRE);
+
+    *slot = (int)(word >> COUNT_BITS);
+    return __atomic_load_n(&live->slots[*slot].ds, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Function:  rm_live_release
+ * --------------------------
+ * @brief  Gives back a reference taken by rm_live_acquire(), freeing a replaced snapshot after its last query.
+ *
+ * @param live The live file.
+ * @param slot The slot rm_live_acquire() returned the snapshot from.
+ *
+ */
+void rm_live_release(rm_live_t *live, int slot)
+{
+    drop(live, slot, 1);
+}
+
+/**
+ * Function:  rm_live_reload
+ * -------------------------
+ * @brief  Loads a route file and makes it the current snapshot; queries carry on meanwhile.
+ *
+ * The file is loaded and indexed in the calling thread (a background
+ * loader) before it is published, so no query sees it half built. Queries
+ * already holding the old snapshot keep it, and it is freed when the last
+ * of them releases it. If LIVE_SLOTS snapshots are still held, publishing
+ * waits for one to be released.
+ *
+ * @param live The live file.
+ * @param path The route file, directory or pattern of shards.
+ *
+ * @return int 0: No errors; 1: The file could not be read (the current snapshot stays).
+ *
+ */
+int rm_live_reload(rm_live_t *live, const char *path)
+{
+    struct timespec pause = {0, 1000000};
+    rm_dataset_t *ds = load(path, live->cube);
+    uint64_t old;
+    int slot, previous;
+
+    if (ds == NULL)
+    {
+        return 1;
+    }
+
+    pthread_mutex_lock(&live->reload);
+    previous = (int)(__atomic_load_n(&live->current, __ATOMIC_ACQUIRE) >> COUNT_BITS);
+    for (slot = 0; __atomic_load_n(&live->slots[slot].ds, __ATOMIC_ACQUIRE) != NULL;)
+    {
+        slot = (slot + 1) % LIVE_SLOTS;
+        if (slot == 0)
+        {
+            nanosleep(&pause, NULL);
+        }
+    }
+    live->slots[slot].refs = 0;
+    __atomic_store_n(&live->slots[slot].ds, ds, __ATOMIC_RELEASE);
+
+    old = __atomic_exchange_n(&live->current, (uint64_t)slot << COUNT_BITS, __ATOMIC_ACQ_REL);
+    drop(live, previous, -(long)(old & COUNT_MASK));
+    pthread_mutex_unlock(&live->reload);
+    return 0;
+}
+
+/**
+ * Function:  rm_live_close
+ * ------------------------
+ * @brief  Frees a live file; every snapshot acquired from it must have been released.
+ *
+ * @param live The live file.
+ *
+ */
+void rm_live_close(rm_live_t *live)
+{
+    uint64_t word = live->current;
+
+    drop(live, (int)(word >> COUNT_BITS), -(long)(word & COUNT_MASK));
+    pthread_mutex_destroy(&live->reload);
+    efree(live);
+}
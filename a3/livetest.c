@@ -0,0 +1,226 @@
+/** @file livetest.c
+ *  @brief Stress test of the live route file: queries racing reloads.
+ *
+ * Several threads acquire the current snapshot of a live file, answer
+ * question 2 on it and release it, as fast as they can, while the main
+ * thread reloads it alternately with a shard (the first SHARD_ROUTES routes
+ * of the file) and with the whole file. Every answer must be the whole
+ * file's or the shard's, and once the live file is closed no memory may be
+ * left allocated. Built with -fsanitize=address it also catches a snapshot
+ * read after it was freed.
+ *
+ * Usage: ./livetest [--DATA=<route file>] [--THREADS=<n>] [--RELOADS=<n>]
+ *
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "emalloc.h"
+#include "routemanager.h"
+
+// routes in the shard, each 13 lines after the "routes:" line
+#define SHARD_ROUTES 1000
+#define ROUTE_LINES 13
+#define ANSWER_SIZE 4096
+
+const char *fileToRead = "routes-airlines-airports.yaml";
+int nthreads = 4;
+int reloads = 50;
+
+/**
+ * @brief What the query threads share: the live file and the two answers it may give.
+ */
+typedef struct
+{
+    rm_live_t *live;
+    const rm_query_t *query;
+    char answers[2][ANSWER_SIZE];
+    size_t routes[2];
+    int stop;
+    long queries;
+    long failures;
+} race_t;
+
+/**
+ * Function:  write_shard
+ * ----------------------
+ * @brief  Copies the first SHARD_ROUTES routes of a route file into a temporary file.
+ *
+ * @param path The route file.
+ * @param shard Receives the temporary file's name (at least 32 characters).
+ *
+ * @return int 0: No errors; 1: A file could not be read or written.
+ *
+ */
+int write_shard(const char *path, char *shard)
+{
+    FILE *in = fopen(path, "r");
+    FILE *out;
+    char line[1024];
+    long lines = 0;
+    int fd;
+
+    if (in == NULL)
+    {
+        return 1;
+    }
+    strcpy(shard, "/tmp/livetest-XXXXXX");
+    fd = mkstemp(shard);
+    if (fd < 0 || (out = fdopen(fd, "w")) == NULL)
+    {
+        fclose(in);
+        return 1;
+    }
+    while (lines <= (long)SHARD_ROUTES * ROUTE_LINES && fgets(line, sizeof(line), in) != NULL)
+    {
+        fputs(line, out);
+        lines += strchr(line, '\n') != NULL;
+    }
+    fclose(in);
+    return fclose(out) != 0;
+}
+
+/**
+ * Function:  answer
+ * -----------------
+ * @brief  Answers the query on one snapshot of the live file.
+ *
+ * @param race The shared state.
+ * @param buf Receives the answer.
+ * @param routes Receives the number of routes in the snapshot.
+ *
+ */
+void answer(race_t *race, char *buf, size_t *routes)
+{
+    int slot;
+    const rm_dataset_t *ds = rm_live_acquire(race->live, &slot);
+
+    *routes = rm_routes(ds);
+    if (rm_query_buffer(ds, race->query, buf, ANSWER_SIZE) < 0)
+    {
+        buf[0] = '\0';
+    }
+    rm_live_release(race->live, slot);
+}
+
+/**
+ * Function:  query_loop
+ * ---------------------
+ * @brief  Queries the live file until told to stop, counting answers that match neither file.
+ *
+ * @param arg The shared state.
+ *
+ */
+void *query_loop(void *arg)
+{
+    race_t *race = (race_t *)arg;
+    char buf[ANSWER_SIZE];
+    size_t routes;
+    int which;
+
+    while (!__atomic_load_n(&race->stop, __ATOMIC_ACQUIRE))
+    {
+        answer(race, buf, &routes);
+        which = routes == race->routes[1];
+        if (routes != race->routes[which] || strcmp(buf, race->answers[which]) != 0)
+        {
+            __atomic_add_fetch(&race->failures, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_add_fetch(&race->queries, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/**
+ * Function:  main
+ * ---------------
+ * @brief  Races queries against reloads and reports whether every answer was right.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The list of arguments passed to the program.
+ *
+ * @return int 0: Every answer was right and nothing leaked; 1: otherwise.
+ *
+ */
+int main(int argc, char *argv[])
+{
+    rm_query_t query = {0};
+    race_t race = {0};
+    pthread_t *threads;
+    mem_stats_t stats[MEM_CATEGORIES], total;
+    char shard[32];
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--DATA=", 7) == 0)
+        {
+            fileToRead = argv[i] + 7;
+        }
+        else if (strncmp(argv[i], "--THREADS=", 10) == 0 && atoi(argv[i] + 10) > 0)
+        {
+            nthreads = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--RELOADS=", 10) == 0 && atoi(argv[i] + 10) > 0)
+        {
+            reloads = atoi(argv[i] + 10);
+        }
+        else
+        {
+            printf("Usage: ./livetest [--DATA=<route file>] [--THREADS=<n>] [--RELOADS=<n>]\n");
+            return 1;
+        }
+    }
+
+    if (write_shard(fileToRead, shard) != 0)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
+        return 1;
+    }
+    query.question = 2;
+    query.n = 5;
+    race.query = &query;
+
+    // the answers of the shard and of the whole file, taken before the race starts
+    race.live = rm_live_open(shard, 0);
+    if (race.live == NULL)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", shard);
+        unlink(shard);
+        return 1;
+    }
+    answer(&race, race.answers[1], &race.routes[1]);
+    if (rm_live_reload(race.live, fileToRead) != 0)
+    {
+        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
+        rm_live_close(race.live);
+        unlink(shard);
+        return 1;
+    }
+    answer(&race, race.answers[0], &race.routes[0]);
+
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * nthreads);
+    for (i = 0; i < nthreads; i++)
+    {
+        pthread_create(&threads[i], NULL, query_loop, &race);
+    }
+    for (i = 0; i < reloads; i++)
+    {
+        rm_live_reload(race.live, i % 2 == 0 ? shard : fileToRead);
+    }
+    __atomic_store_n(&race.stop, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < nthreads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    rm_live_close(race.live);
+    unlink(shard);
+
+    emalloc_stats(stats, &total);
+    printf("%d reloads, %ld queries, %ld wrong answers, %ld bytes left allocated\n", reloads, race.queries,
+           race.failures, total.live);
+    return race.failures != 0 || total.live != 0;
+}
@@ -0,0 +1,211 @@
+/** @file matrix.c
+ *  @brief Implementation of matrix.h
+ *
+ * Routes are first mapped to airline members (pairs of name and icao ids,
+ * numbered by an idmap) and country columns in one pass; members are then given the number of
+ * their subject, so members printing the same subject share a column, and
+ * a second pass over the members fills the matrix. With a cube, its cells
+ * stand in for the routes.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "idmap.h"
+#include "cube.h"
+#include "matrix.h"
+
+/**
+ * @brief An airline member and the subject it prints as.
+ */
+typedef struct
+{
+    char *subject;
+    uint32_t member;
+} named_t;
+
+/**
+ * Function:  by_subject
+ * ---------------------
+ * @brief  qsort() comparator putting members in strcmp() order of their subjects.
+ *
+ */
+static int by_subject(const void *a, const void *b)
+{
+    return strcmp(((const named_t *)a)->subject, ((const named_t *)b)->subject);
+}
+
+/**
+ * Function:  number_airlines
+ * --------------------------
+ * @brief  Gives every airline member the column of its subject.
+ *
+ * @param matrix The matrix being built; airlines and nairlines are set.
+ * @param ds The dataset.
+ * @param members The name and icao ids of each member.
+ * @param nmembers The number of members.
+ *
+ * @return uint32_t* The column of each member (to be freed).
+ *
+ */
+static uint32_t *number_airlines(matrix_t *matrix, const dataset_t *ds, const uint32_t *members, uint32_t nmembers)
+{
+    named_t *named = (named_t *)emalloc((nmembers + 1) * sizeof(named_t));
+    uint32_t *columns = (uint32_t *)emalloc((nmembers + 1) * sizeof(uint32_t));
+    char subject[2 * MAX_VALUE_LENGTH + 8];
+    uint32_t m;
+
+    for (m = 0; m < nmembers; m++)
+    {
+        sprintf(subject, "%s (%s),", dataset_string(ds, members[2 * m]), dataset_string(ds, members[2 * m + 1]));
+        named[m].subject = estrdup(MEM_NODE_STRINGS, subject);
+        named[m].member = m;
+    }
+    qsort(named, nmembers, sizeof(named_t), by_subject);
+
+    matrix->airlines = (char **)emalloc_as(MEM_INDEXES, (nmembers + 1) * sizeof(char *));
+    matrix->nairlines = 0;
+    for (m = 0; m < nmembers; m++)
+    {
+        if (m > 0 && strcmp(named[m].subject, named[m - 1].subject) == 0)
+        {
+            efree(named[m].subject);
+        }
+        else
+        {
+            matrix->airlines[matrix->nairlines++] = named[m].subject;
+        }
+        columns[named[m].member] = matrix->nairlines - 1;
+    }
+    efree(named);
+    return columns;
+}
+
+/**
+ * Function:  matrix_build
+ * -----------------------
+ * @brief  Counts the routes of every airline into every destination country.
+ *
+ * @param matrix The matrix to fill.
+ * @param ds The dataset; it must have question 1's fields loaded (or a cube).
+ *
+ */
+void matrix_build(matrix_t *matrix, const dataset_t *ds)
+{
+    uint32_t *members = NULL, *columns, *country_of;
+    uint32_t *route_airline = NULL, *route_country = NULL;
+    uint32_t nmembers = 0, member, id;
+    const cube_t *cube = ds->cube;
+    uint32_t pair[2];
+    idmap_t index;
+    size_t r, nrows;
+
+    memset(matrix, 0, sizeof(matrix_t));
+    country_of = (uint32_t *)emalloc((ds->nstrings + 1) * sizeof(uint32_t));
+    memset(country_of, 0xff, (ds->nstrings + 1) * sizeof(uint32_t));
+    matrix->countries = (uint32_t *)emalloc_as(MEM_INDEXES, (ds->nstrings + 1) * sizeof(uint32_t));
+
+    if (cube != NULL)
+    {
+        nmembers = cube->nmembers[DIM_AIRLINE];
+        members = cube->members[DIM_AIRLINE];
+        nrows = cube->ncells;
+    }
+    else
+    {
+        // number the airline members and note each route's member and country
+        nrows = ds->nroutes;
+        route_airline = (uint32_t *)emalloc((nrows + 1) * sizeof(uint32_t));
+        route_country = (uint32_t *)emalloc((nrows + 1) * sizeof(uint32_t));
+        idmap_init(&index, 2, 1024);
+        for (r = 0; r < nrows; r++)
+        {
+            pair[0] = ds->columns[FIELD_AIRLINE_NAME][r];
+            pair[1] = ds->columns[FIELD_AIRLINE_ICAO][r];
+            route_airline[r] = idmap_add(&index, pair);
+            route_country[r] = ds->columns[FIELD_TO_COUNTRY][r];
+        }
+        // the map holds the name and icao ids of each member side by side, as the cube does
+        nmembers = (uint32_t)index.nmembers;
+        members = index.ids;
+    }
+
+    columns = number_airlines(matrix, ds, members, nmembers);
+
+    // countries get their rows in order of first appearance
+    for (r = 0; r < nrows; r++)
+    {
+        id = cube != NULL ? *cube_member(cube, DIM_TO_COUNTRY, cube->cells[r].coords[DIM_TO_COUNTRY])
+                          : route_country[r];
+        if (country_of[id] == UINT32_MAX)
+        {
+            matrix->countries[matrix->ncountries] = id;
+            country_of[id] = matrix->ncountries++;
+        }
+    }
+    matrix->counts = (uint32_t *)emalloc_as(MEM_INDEXES, ((size_t)matrix->ncountries * matrix->nairlines + 1) * sizeof(uint32_t));
+    memset(matrix->counts, 0, ((size_t)matrix->ncountries * matrix->nairlines + 1) * sizeof(uint32_t));
+    for (r = 0; r < nrows; r++)
+    {
+        if (cube != NULL)
+        {
+            member = cube->cells[r].coords[DIM_AIRLINE];
+            id = *cube_member(cube, DIM_TO_COUNTRY, cube->cells[r].coords[DIM_TO_COUNTRY]);
+            matrix->counts[(size_t)country_of[id] * matrix->nairlines + columns[member]] += cube->cells[r].count;
+        }
+        else
+        {
+            member = route_airline[r];
+            id = route_country[r];
+            matrix->counts[(size_t)country_of[id] * matrix->nairlines + columns[member]]++;
+        }
+    }
+
+    efree(columns);
+    efree(country_of);
+    if (cube == NULL)
+    {
+        idmap_free(&index);
+        efree(route_airline);
+        efree(route_country);
+    }
+}
+
+/**
+ * Function:  matrix_row
+ * ---------------------
+ * @brief  Returns the routes of every airline into one country.
+ *
+ * @param matrix The matrix.
+ * @param country The row of the country.
+ *
+ * @return const uint32_t* nairlines counts, by airline column.
+ *
+ */
+const uint32_t *matrix_row(const matrix_t *matrix, uint32_t country)
+{
+    return matrix->counts + (size_t)country * matrix->nairlines;
+}
+
+/**
+ * Function:  matrix_free
+ * ----------------------
+ * @brief  Releases what a matrix holds.
+ *
+ * @param matrix The matrix.
+ *
+ */
+void matrix_free(matrix_t *matrix)
+{
+    uint32_t a;
+
+    for (a = 0; a < matrix->nairlines; a++)
+    {
+        efree(matrix->airlines[a]);
+    }
+    efree(matrix->airlines);
+    efree(matrix->countries);
+    efree(matrix->counts);
+    memset(matrix, 0, sizeof(matrix_t));
+}
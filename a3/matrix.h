@@ -0,0 +1,36 @@
+/** @file matrix.h
+ *  @brief Function prototypes for the airline by destination country route matrix.
+ *
+ */
+#ifndef _MATRIX_H_
+#define _MATRIX_H_
+
+#include <stdint.h>
+#include "dataset.h"
+
+/**
+ * @brief Routes of every airline into every destination country, as a dense matrix.
+ *
+ * Airlines are the distinct subject columns question 1 prints ("name
+ * (icao),"), numbered in strcmp() order; countries are the distinct
+ * destination country string ids, in order of first appearance. counts
+ * holds one row of nairlines counts per country, so ranking the airlines
+ * of a country is a scan of one contiguous row.
+ */
+typedef struct
+{
+    uint32_t nairlines;
+    char **airlines;
+    uint32_t ncountries;
+    uint32_t *countries;
+    uint32_t *counts;
+} matrix_t;
+
+/**
+ * Function protypes associated with a route matrix.
+ */
+void matrix_build(matrix_t *, const dataset_t *);
+const uint32_t *matrix_row(const matrix_t *, uint32_t country);
+void matrix_free(matrix_t *);
+
+#endif
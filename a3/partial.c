@@ -0,0 +1,464 @@
+/** @file partial.c
+ *  @brief Implementation of partial.h
+ *
+ * A partial file holds the grouped counts of one question over one input,
+ * before ranking, so the inputs of a batch can be counted on different
+ * machines and ranked together later:
+ *
+ *   "RMPART1\n"                               magic
+ *   varint length, bytes                      signature (the question asked)
+ *   varint shared, varint rest, bytes, varint count
+ *                                             one record per key, in strictly
+ *                                             increasing strcmp() order
+ *   varint 0, varint 0                        end (an empty key)
+ *   varint number of records
+ *
+ * Varints are little-endian base 128, so files move between machines, and
+ * a truncated file is told apart from a finished one by its end record.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "partial.h"
+
+#define PARTIAL_MAGIC "RMPART1\n"
+#define MAGIC_LENGTH 8
+
+/**
+ * Function:  put_varint
+ * ---------------------
+ * @brief  Writes an unsigned number in base 128, low digits first.
+ *
+ * @param fp The file to write to.
+ * @param value The number to write.
+ *
+ */
+static void put_varint(FILE *fp, uint64_t value)
+{
+    unsigned char buf[10];
+    int n = 0;
+
+    do
+    {
+        buf[n] = value & 0x7f;
+        value >>= 7;
+        buf[n++] |= value != 0 ? 0x80 : 0;
+    } while (value != 0);
+    fwrite(buf, 1, n, fp);
+}
+
+/**
+ * Function:  get_varint
+ * ---------------------
+ * @brief  Reads a number written by put_varint().
+ *
+ * @param fp The file to read from.
+ * @param value Set to the number read.
+ *
+ * @return int 0: No errors; 1: The file ended or the number is too long.
+ *
+ */
+static int get_varint(FILE *fp, uint64_t *value)
+{
+    int c, shift;
+
+    *value = 0;
+    for (shift = 0; shift < 64; shift += 7)
+    {
+        c = getc(fp);
+        if (c == EOF)
+        {
+            return 1;
+        }
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Function:  partial_create
+ * -------------------------
+ * @brief  Starts a partial file, replacing any file at the path.
+ *
+ * @param p The file to initialise.
+ * @param path Where to write it.
+ * @param signature What was asked, checked when files are merged (under PARTIAL_MAX_SIGNATURE bytes).
+ *
+ * @return int 0: No errors; 1: The file could not be created.
+ *
+ */
+int partial_create(partial_t *p, const char *path, const char *signature)
+{
+    size_t len = strlen(signature);
+
+    p->fp = fopen(path, "wb");
+    if (p->fp == NULL)
+    {
+        return 1;
+    }
+    p->path = estrdup(MEM_SCRATCH, path);
+    p->cap = 64;
+    p->last = (char *)emalloc_as(MEM_SCRATCH, p->cap);
+    p->last[0] = '\0';
+    p->nrecords = 0;
+    p->failed = len >= PARTIAL_MAX_SIGNATURE;
+
+    fwrite(PARTIAL_MAGIC, 1, MAGIC_LENGTH, p->fp);
+    put_varint(p->fp, len);
+    fwrite(signature, 1, len, p->fp);
+    return 0;
+}
+
+/**
+ * Function:  partial_add
+ * ----------------------
+ * @brief  Appends the count of one key.
+ *
+ * A key that is empty or not after the previous one fails the file, which
+ * partial_close() then reports.
+ *
+ * @param p The file being written.
+ * @param key The key.
+ * @param count The count of the key.
+ *
+ */
+void partial_add(partial_t *p, const char *key, uint64_t count)
+{
+    size_t len = strlen(key);
+    size_t shared = 0;
+
+    if (p->failed || len == 0 || (p->nrecords > 0 && strcmp(key, p->last) <= 0))
+    {
+        p->failed = 1;
+        return;
+    }
+    while (key[shared] != '\0' && key[shared] == p->last[shared])
+    {
+        shared++;
+    }
+    put_varint(p->fp, shared);
+    put_varint(p->fp, len - shared);
+    fwrite(key + shared, 1, len - shared, p->fp);
+    put_varint(p->fp, count);
+
+    if (len + 1 > p->cap)
+    {
+        p->cap = 2 * (len + 1);
+        p->last = (char *)erealloc(MEM_SCRATCH, p->last, p->cap);
+    }
+    memcpy(p->last, key, len + 1);
+    p->nrecords++;
+}
+
+/**
+ * Function:  partial_close
+ * ------------------------
+ * @brief  Ends a partial file; a failed file is removed rather than left half written.
+ *
+ * @param p The file to end.
+ *
+ * @return int 0: No errors; 1: A key was out of order or the file could not be written.
+ *
+ */
+int partial_close(partial_t *p)
+{
+    int failed = p->failed;
+
+    put_varint(p->fp, 0);
+    put_varint(p->fp, 0);
+    put_varint(p->fp, p->nrecords);
+    failed |= ferror(p->fp) != 0;
+    failed |= fclose(p->fp) != 0;
+    if (failed)
+    {
+        remove(p->path);
+    }
+    efree(p->path);
+    efree(p->last);
+    return failed;
+}
+
+/**
+ * Function:  read_header
+ * ----------------------
+ * @brief  Reads the magic and the signature of a partial file.
+ *
+ * @param cursor The file to read.
+ * @param signature Set to the file's signature (PARTIAL_MAX_SIGNATURE bytes).
+ *
+ * @return int 0: No errors; 1: The file is not a partial file.
+ *
+ */
+static int read_header(partial_cursor_t *cursor, char *signature)
+{
+    char magic[MAGIC_LENGTH];
+    uint64_t len;
+
+    if (fread(magic, 1, MAGIC_LENGTH, cursor->fp) != MAGIC_LENGTH || memcmp(magic, PARTIAL_MAGIC, MAGIC_LENGTH) != 0 ||
+        get_varint(cursor->fp, &len) != 0 || len >= PARTIAL_MAX_SIGNATURE ||
+        fread(signature, 1, len, cursor->fp) != len)
+    {
+        return 1;
+    }
+    signature[len] = '\0';
+    return 0;
+}
+
+/**
+ * Function:  next_key
+ * -------------------
+ * @brief  Advances a cursor to its next record, checking that keys keep increasing.
+ *
+ * @param cursor The cursor to advance; done is set after the end record.
+ *
+ * @return int 0: No errors; 1: The file is truncated or damaged.
+ *
+ */
+static int next_key(partial_cursor_t *cursor)
+{
+    uint64_t shared, rest, total;
+    size_t len = strlen(cursor->key);
+    unsigned char previous;
+
+    if (get_varint(cursor->fp, &shared) != 0 || get_varint(cursor->fp, &rest) != 0)
+    {
+        return 1;
+    }
+    if (shared == 0 && rest == 0)
+    {
+        cursor->done = 1;
+        return get_varint(cursor->fp, &total) != 0 || total != cursor->nrecords;
+    }
+    if (shared > len || rest == 0 || rest > ((uint64_t)1 << 32))
+    {
+        return 1;
+    }
+    if (shared + rest + 1 > cursor->cap)
+    {
+        cursor->cap = 2 * (shared + rest + 1);
+        cursor->key = (char *)erealloc(MEM_SCRATCH, cursor->key, cursor->cap);
+    }
+    previous = (unsigned char)cursor->key[shared];
+    if (fread(cursor->key + shared, 1, rest, cursor->fp) != rest || get_varint(cursor->fp, &cursor->count) != 0)
+    {
+        return 1;
+    }
+    cursor->key[shared + rest] = '\0';
+    cursor->nrecords++;
+
+    // the key must sort after the one before it, which it shares shared bytes with
+    return shared < len && (unsigned char)cursor->key[shared] <= previous;
+}
+
+/**
+ * Function:  sift_down
+ * --------------------
+ * @brief  Restores the min-heap property of the reader's heap from a given slot.
+ *
+ * @param reader The reader, whose heap holds the indices of the cursors not yet done.
+ * @param i The slot to sift down from.
+ *
+ */
+static void sift_down(partial_reader_t *reader, int i)
+{
+    partial_cursor_t *cursors = reader->cursors;
+    int *heap = reader->heap;
+    int smallest, left, right, temp;
+
+    for (;;)
+    {
+        smallest = i;
+        left = 2 * i + 1;
+        right = left + 1;
+
+        if (left < reader->size && strcmp(cursors[heap[left]].key, cursors[heap[smallest]].key) < 0)
+        {
+            smallest = left;
+        }
+        if (right < reader->size && strcmp(cursors[heap[right]].key, cursors[heap[smallest]].key) < 0)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+
+        temp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = temp;
+        i = smallest;
+    }
+}
+
+/**
+ * Function:  partial_open
+ * -----------------------
+ * @brief  Opens partial files for merging; they must all carry the same signature.
+ *
+ * @param reader The reader to initialise.
+ * @param paths The files to merge.
+ * @param npaths The number of files (at least 1).
+ * @param signature Set to the files' signature (PARTIAL_MAX_SIGNATURE bytes).
+ *
+ * @return int 0: No errors; 1: A file could not be read, or asks a different question (reported on stderr).
+ *
+ */
+int partial_open(partial_reader_t *reader, const char *const *paths, int npaths, char *signature)
+{
+    char other[PARTIAL_MAX_SIGNATURE];
+    partial_cursor_t *cursor;
+    int i;
+
+    reader->cursors = (partial_cursor_t *)emalloc_as(MEM_SCRATCH, npaths * sizeof(partial_cursor_t));
+    reader->ncursors = 0;
+    reader->heap = (int *)emalloc_as(MEM_SCRATCH, (npaths > 0 ? npaths : 1) * sizeof(int));
+    reader->size = 0;
+    reader->cap = 64;
+    reader->key = (char *)emalloc_as(MEM_SCRATCH, reader->cap);
+    reader->failed = npaths < 1;
+
+    for (i = 0; i < npaths && !reader->failed; i++)
+    {
+        cursor = &reader->cursors[reader->ncursors];
+        cursor->fp = fopen(paths[i], "rb");
+        if (cursor->fp == NULL)
+        {
+            fprintf(stderr, "Failed to open file: %s\n", paths[i]);
+            reader->failed = 1;
+            break;
+        }
+        cursor->path = estrdup(MEM_SCRATCH, paths[i]);
+        cursor->cap = 64;
+        cursor->key = (char *)emalloc_as(MEM_SCRATCH, cursor->cap);
+        cursor->key[0] = '\0';
+        cursor->nrecords = 0;
+        cursor->done = 0;
+        reader->ncursors++;
+
+        if (read_header(cursor, i == 0 ? signature : other) != 0)
+        {
+            fprintf(stderr, "%s is not a partial aggregate\n", paths[i]);
+            reader->failed = 1;
+        }
+        else if (i > 0 && strcmp(other, signature) != 0)
+        {
+            fprintf(stderr, "%s answers %s, not %s\n", paths[i], other, signature);
+            reader->failed = 1;
+        }
+        else if (next_key(cursor) != 0)
+        {
+            fprintf(stderr, "%s is damaged or truncated\n", paths[i]);
+            reader->failed = 1;
+        }
+    }
+    if (reader->failed)
+    {
+        partial_finish(reader);
+        return 1;
+    }
+
+    for (i = 0; i < reader->ncursors; i++)
+    {
+        if (!reader->cursors[i].done)
+        {
+            reader->heap[reader->size++] = i;
+        }
+    }
+    for (i = reader->size / 2 - 1; i >= 0; i--)
+    {
+        sift_down(reader, i);
+    }
+    return 0;
+}
+
+/**
+ * Function:  partial_next
+ * -----------------------
+ * @brief  Gives the next key of the merged files, with its count summed over all of them.
+ *
+ * Keys come out in strcmp() order, once each.
+ *
+ * @param reader The reader.
+ * @param key Set to the key, valid until the next call.
+ * @param count Set to the total count of the key.
+ *
+ * @return int 1 if a key was read, 0 once every file is exhausted or one is damaged.
+ *
+ */
+int partial_next(partial_reader_t *reader, const char **key, uint64_t *count)
+{
+    partial_cursor_t *top;
+    size_t len;
+
+    if (reader->size == 0 || reader->failed)
+    {
+        return 0;
+    }
+
+    top = &reader->cursors[reader->heap[0]];
+    len = strlen(top->key);
+    if (len + 1 > reader->cap)
+    {
+        reader->cap = 2 * (len + 1);
+        reader->key = (char *)erealloc(MEM_SCRATCH, reader->key, reader->cap);
+    }
+    memcpy(reader->key, top->key, len + 1);
+
+    // every file holding the key has it at the top of the heap in turn
+    *count = 0;
+    while (reader->size > 0 && strcmp(top->key, reader->key) == 0)
+    {
+        *count += top->count;
+        if (next_key(top) != 0)
+        {
+            fprintf(stderr, "%s is damaged or truncated\n", top->path);
+            reader->failed = 1;
+            top->done = 1;
+        }
+        if (top->done)
+        {
+            reader->heap[0] = reader->heap[--reader->size];
+        }
+        sift_down(reader, 0);
+        top = &reader->cursors[reader->heap[0]];
+    }
+    *key = reader->key;
+    return 1;
+}
+
+/**
+ * Function:  partial_finish
+ * -------------------------
+ * @brief  Closes the merged files and releases the reader.
+ *
+ * @param reader The reader to release.
+ *
+ * @return int 0: Every file was read to its end; 1: A file was damaged or not read to its end.
+ *
+ */
+int partial_finish(partial_reader_t *reader)
+{
+    int failed = reader->failed;
+    int i;
+
+    for (i = 0; i < reader->ncursors; i++)
+    {
+        failed |= !reader->cursors[i].done;
+        fclose(reader->cursors[i].fp);
+        efree(reader->cursors[i].path);
+        efree(reader->cursors[i].key);
+    }
+    efree(reader->cursors);
+    efree(reader->heap);
+    efree(reader->key);
+    reader->cursors = NULL;
+    reader->ncursors = 0;
+    return failed;
+}
@@ -0,0 +1,74 @@
+/** @file partial.h
+ *  @brief Function prototypes for partial-aggregate files.
+ *
+ */
+#ifndef _PARTIAL_H_
+#define _PARTIAL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+// the longest signature a partial file may carry, with its terminator
+#define PARTIAL_MAX_SIGNATURE 128
+
+// separates the group from the member in the keys of distinct counts
+#define PARTIAL_SEPARATOR '\001'
+
+/**
+ * @brief A partial-aggregate file being written.
+ *
+ * Keys must be added in strictly increasing strcmp() order; each is stored
+ * as the length it shares with the previous key and the rest of its bytes.
+ */
+typedef struct
+{
+    FILE *fp;
+    char *path;
+    char *last;
+    size_t cap;
+    uint64_t nrecords;
+    int failed;
+} partial_t;
+
+/**
+ * @brief The read position in one partial file while merging.
+ */
+typedef struct
+{
+    FILE *fp;
+    char *path;
+    char *key;
+    size_t cap;
+    uint64_t count;
+    uint64_t nrecords;
+    int done;
+} partial_cursor_t;
+
+/**
+ * @brief Merges any number of partial files with the same signature, key by key.
+ *
+ * The cursors not yet done sit in a min-heap on their current key, so each
+ * merged key costs O(log files) per file holding it.
+ */
+typedef struct
+{
+    partial_cursor_t *cursors;
+    int ncursors;
+    int *heap;
+    int size;
+    char *key;
+    size_t cap;
+    int failed;
+} partial_reader_t;
+
+/**
+ * Function protypes associated with partial-aggregate files.
+ */
+int partial_create(partial_t *, const char *path, const char *signature);
+void partial_add(partial_t *, const char *key, uint64_t count);
+int partial_close(partial_t *);
+int partial_open(partial_reader_t *, const char *const *paths, int npaths, char *signature);
+int partial_next(partial_reader_t *, const char **key, uint64_t *count);
+int partial_finish(partial_reader_t *);
+
+#endif
@@ -0,0 +1,321 @@
+/** @file pool.c
+ *  @brief Implementation of pool.h
+ *
+ * Every worker owns a deque guarded by its own mutex, so workers busy with
+ * their own tasks never contend; the pool-wide mutex only guards the counts
+ * that decide when workers sleep (queued: tasks in some deque) and when
+ * pool_wait() returns (pending: tasks queued or running).
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "emalloc.h"
+#include "pool.h"
+
+/**
+ * Function:  deque_push
+ * ---------------------
+ * @brief  Adds a task at the bottom of a deque.
+ *
+ * @param dq The deque.
+ * @param task The task.
+ *
+ */
+static void deque_push(deque_t *dq, task_t task)
+{
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom == dq->cap)
+    {
+        if (dq->top > 0)
+        {
+            memmove(dq->tasks, dq->tasks + dq->top, (dq->bottom - dq->top) * sizeof(task_t));
+            dq->bottom -= dq->top;
+            dq->top = 0;
+        }
+        else
+        {
+            dq->cap = dq->cap == 0 ? 16 : 2 * dq->cap;
+            dq->tasks = (task_t *)erealloc(MEM_SCRATCH, dq->tasks, dq->cap * sizeof(task_t));
+        }
+    }
+    dq->tasks[dq->bottom++] = task;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+/**
+ * Function:  deque_take
+ * ---------------------
+ * @brief  Removes a task from a deque: the newest for its owner, the oldest for a thief.
+ *
+ * @param dq The deque.
+ * @param task Set to the task.
+ * @param steal Whether the caller is another worker.
+ *
+ * @return int 1 if a task was removed, 0 if the deque was empty.
+ *
+ */
+static int deque_take(deque_t *dq, task_t *task, int steal)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->top < dq->bottom)
+    {
+        *task = steal ? dq->tasks[dq->top++] : dq->tasks[--dq->bottom];
+        found = 1;
+        if (dq->top == dq->bottom)
+        {
+            dq->top = dq->bottom = 0;
+        }
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+/**
+ * Function:  find_task
+ * --------------------
+ * @brief  Takes a task from a worker's own deque, or else steals one from another.
+ *
+ * @param pool The pool.
+ * @param self The worker looking for work.
+ * @param task Set to the task.
+ *
+ * @return int 1 if a task was found, 0 if every deque was empty.
+ *
+ */
+static int find_task(pool_t *pool, int self, task_t *task)
+{
+    int i;
+
+    if (deque_take(&pool->deques[self], task, 0))
+    {
+        return 1;
+    }
+    for (i = 1; i < pool->nworkers; i++)
+    {
+        if (deque_take(&pool->deques[(self + i) % pool->nworkers], task, 1))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief What a worker thread starts with.
+ */
+typedef struct
+{
+    pool_t *pool;
+    int self;
+} worker_t;
+
+/**
+ * Function:  worker
+ * -----------------
+ * @brief  Runs tasks until the pool stops, sleeping while there are none.
+ *
+ * @param arg The worker_t (freed by the worker).
+ *
+ * @return void* NULL.
+ *
+ */
+static void *worker(void *arg)
+{
+    pool_t *pool = ((worker_t *)arg)->pool;
+    int self = ((worker_t *)arg)->self;
+    task_t task;
+
+    efree(arg);
+    for (;;)
+    {
+        if (find_task(pool, self, &task))
+        {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+            task.fn(task.arg);
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0)
+            {
+                pthread_cond_broadcast(&pool->idle);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        // a task is counted just before it is pushed, so a worker that
+        // found none while some are queued only has to look again
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stopping && pool->queued == 0)
+        {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        if (pool->stopping)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * Function:  pool_default_workers
+ * -------------------------------
+ * @brief  Returns the number of workers to use by default: one per online CPU.
+ *
+ * @return int The number of workers (at least 1).
+ *
+ */
+int pool_default_workers(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n < 1 ? 1 : (int)n;
+}
+
+/**
+ * Function:  pool_new
+ * -------------------
+ * @brief  Starts a pool of workers.
+ *
+ * @param nworkers The number of worker threads (at least 1).
+ *
+ * @return pool_t* The pool.
+ *
+ */
+pool_t *pool_new(int nworkers)
+{
+    pool_t *pool = (pool_t *)emalloc(sizeof(pool_t));
+    worker_t *start;
+    int i;
+
+    memset(pool, 0, sizeof(pool_t));
+    pool->nworkers = nworkers < 1 ? 1 : nworkers;
+    pool->threads = (pthread_t *)emalloc(pool->nworkers * sizeof(pthread_t));
+    pool->deques = (deque_t *)emalloc(pool->nworkers * sizeof(deque_t));
+    memset(pool->deques, 0, pool->nworkers * sizeof(deque_t));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (i = 0; i < pool->nworkers; i++)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    for (i = 0; i < pool->nworkers; i++)
+    {
+        start = (worker_t *)emalloc(sizeof(worker_t));
+        start->pool = pool;
+        start->self = i;
+        pthread_create(&pool->threads[i], NULL, worker, start);
+    }
+    return pool;
+}
+
+/**
+ * Function:  pool_submit
+ * ----------------------
+ * @brief  Queues a task.
+ *
+ * A task submitted by a worker goes to that worker's own deque; others are
+ * dealt to the workers in turn. Either way, idle workers steal it if its
+ * deque's owner is busy.
+ *
+ * @param pool The pool.
+ * @param fn The function to run.
+ * @param arg The argument passed to fn.
+ *
+ */
+void pool_submit(pool_t *pool, void (*fn)(void *), void *arg)
+{
+    task_t task = {fn, arg};
+    int i, target = -1;
+
+    for (i = 0; i < pool->nworkers && target < 0; i++)
+    {
+        if (pthread_equal(pool->threads[i], pthread_self()))
+        {
+            target = i;
+        }
+    }
+    // counted before it is pushed, so the task is never finished before it is counted
+    pthread_mutex_lock(&pool->lock);
+    if (target < 0)
+    {
+        target = pool->next;
+        pool->next = (pool->next + 1) % pool->nworkers;
+    }
+    pool->queued++;
+    pool->pending++;
+    pthread_mutex_unlock(&pool->lock);
+
+    deque_push(&pool->deques[target], task);
+
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Function:  pool_wait
+ * --------------------
+ * @brief  Waits until every task submitted so far, and every task they submitted, has finished.
+ *
+ * Must not be called from a task.
+ *
+ * @param pool The pool.
+ *
+ */
+void pool_wait(pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Function:  pool_free
+ * --------------------
+ * @brief  Waits for the pool's tasks, then stops its workers and releases it.
+ *
+ * @param pool The pool (may be NULL).
+ *
+ */
+void pool_free(pool_t *pool)
+{
+    int i;
+
+    if (pool == NULL)
+    {
+        return;
+    }
+    pool_wait(pool);
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    // workers look into each other's deques until they have all stopped
+    for (i = 0; i < pool->nworkers; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (i = 0; i < pool->nworkers; i++)
+    {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        efree(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->idle);
+    efree(pool->threads);
+    efree(pool->deques);
+    efree(pool);
+}
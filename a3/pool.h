@@ -0,0 +1,61 @@
+/** @file pool.h
+ *  @brief Function prototypes for the work-stealing thread pool.
+ *
+ */
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <pthread.h>
+
+/**
+ * @brief A unit of work: fn(arg).
+ */
+typedef struct
+{
+    void (*fn)(void *arg);
+    void *arg;
+} task_t;
+
+/**
+ * @brief The tasks waiting on one worker.
+ *
+ * The worker takes the newest task from the bottom, so the tasks a task
+ * spawns run while their data is still in cache; idle workers steal the
+ * oldest task from the top, which tends to be the largest piece of work.
+ */
+typedef struct
+{
+    task_t *tasks;
+    int top;
+    int bottom;
+    int cap;
+    pthread_mutex_t lock;
+} deque_t;
+
+/**
+ * @brief A fixed set of worker threads, each with its own deque.
+ */
+typedef struct pool_t
+{
+    pthread_t *threads;
+    deque_t *deques;
+    int nworkers;
+    int next;
+    int queued;
+    int pending;
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t idle;
+} pool_t;
+
+/**
+ * Function protypes associated with a thread pool.
+ */
+pool_t *pool_new(int nworkers);
+void pool_submit(pool_t *, void (*fn)(void *), void *arg);
+void pool_wait(pool_t *);
+void pool_free(pool_t *);
+int pool_default_workers(void);
+
+#endif
@@ -0,0 +1,318 @@
+/** @file quantile.c
+ *  @brief Implementation of quantile.h
+ *
+ * The sketch is the KLL compactor hierarchy. Level h, counting from the top
+ * of nlevels levels, may hold about k * (2/3)^(nlevels - 1 - h) values, so
+ * the top level is the largest and the whole sketch about 3k values. When
+ * the sketch is full the lowest full level is compacted: sorted, and either
+ * its odd or its even values (a coin decides) moved to the level above with
+ * twice the weight. Weights always add up to the number of values added.
+ *
+ * Two sketches merge by concatenating their levels and compacting, which
+ * is what lets the routes be split between threads (or machines) and the
+ * sketches of the parts combined.
+ *
+ * The coin is a fixed pseudo-random sequence, so the same values added in
+ * the same order always give the same sketch.
+ *
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "quantile.h"
+
+#define KLL_SEED 0x2545F4914F6CDD1DULL
+
+/**
+ * @brief One value of the sketch with the number of values it stands for.
+ */
+typedef struct
+{
+    double value;
+    uint64_t weight;
+} weighted_t;
+
+/**
+ * Function:  capacity
+ * -------------------
+ * @brief  Returns how many values a level may hold before it is compacted.
+ *
+ * @param kll The sketch.
+ * @param level The level.
+ *
+ * @return int The capacity, at least 2.
+ *
+ */
+static int capacity(const kll_t *kll, int level)
+{
+    int c = (int)ceil(kll->k * pow(2.0 / 3.0, kll->nlevels - 1 - level));
+
+    return c > 2 ? c : 2;
+}
+
+/**
+ * Function:  grow
+ * ---------------
+ * @brief  Adds an empty level on top, which raises every level's capacity.
+ *
+ * @param kll The sketch.
+ *
+ */
+static void grow(kll_t *kll)
+{
+    int h;
+
+    kll->levels[kll->nlevels] = NULL;
+    kll->sizes[kll->nlevels] = 0;
+    kll->caps[kll->nlevels] = 0;
+    kll->nlevels++;
+    for (kll->max_size = 0, h = 0; h < kll->nlevels; h++)
+    {
+        kll->max_size += capacity(kll, h);
+    }
+}
+
+/**
+ * Function:  append
+ * -----------------
+ * @brief  Appends values to a level, growing its array as needed.
+ *
+ * @param kll The sketch.
+ * @param level The level.
+ * @param values The values.
+ * @param n The number of values.
+ *
+ */
+static void append(kll_t *kll, int level, const double *values, int n)
+{
+    if (kll->sizes[level] + n > kll->caps[level])
+    {
+        kll->caps[level] = 2 * (kll->sizes[level] + n);
+        kll->levels[level] = (double *)erealloc(MEM_SCRATCH, kll->levels[level], kll->caps[level] * sizeof(double));
+    }
+    memcpy(kll->levels[level] + kll->sizes[level], values, n * sizeof(double));
+    kll->sizes[level] += n;
+    kll->size += n;
+}
+
+/**
+ * Function:  compare_doubles
+ * --------------------------
+ * @brief  qsort() comparator putting values in increasing order.
+ *
+ */
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Function:  compact
+ * ------------------
+ * @brief  Moves every other value of a sorted level to the level above, keeping the smallest if it has an odd number.
+ *
+ * @param kll The sketch.
+ * @param level The level (below the top one).
+ *
+ */
+static void compact(kll_t *kll, int level)
+{
+    double *values = kll->levels[level];
+    int keep = kll->sizes[level] % 2;
+    int offset, i, n;
+
+    kll->coin ^= kll->coin << 13;
+    kll->coin ^= kll->coin >> 7;
+    kll->coin ^= kll->coin << 17;
+    offset = (int)(kll->coin & 1);
+
+    qsort(values, kll->sizes[level], sizeof(double), compare_doubles);
+    for (i = keep + offset, n = 0; i < kll->sizes[level]; i += 2)
+    {
+        values[keep + n++] = values[i];
+    }
+    kll->size -= kll->sizes[level];
+    kll->sizes[level] = keep;
+    kll->size += keep;
+    append(kll, level + 1, values + keep, n);
+}
+
+/**
+ * Function:  compress
+ * -------------------
+ * @brief  Compacts full levels, lowest first, until the sketch is below its size.
+ *
+ * @param kll The sketch.
+ *
+ */
+static void compress(kll_t *kll)
+{
+    int h;
+
+    for (h = 0; h < kll->nlevels && kll->size >= kll->max_size; h++)
+    {
+        if (kll->sizes[h] >= capacity(kll, h))
+        {
+            if (h + 1 == kll->nlevels)
+            {
+                grow(kll);
+            }
+            compact(kll, h);
+        }
+    }
+}
+
+/**
+ * Function:  kll_init
+ * -------------------
+ * @brief  Initialises an empty sketch.
+ *
+ * @param kll The sketch.
+ * @param k The size of the top level (KLL_DEFAULT_K if not positive); larger is more accurate.
+ *
+ */
+void kll_init(kll_t *kll, int k)
+{
+    kll->k = k > 0 ? k : KLL_DEFAULT_K;
+    kll->nlevels = 0;
+    kll->size = 0;
+    kll->n = 0;
+    kll->min = INFINITY;
+    kll->max = -INFINITY;
+    kll->coin = KLL_SEED;
+    grow(kll);
+}
+
+/**
+ * Function:  kll_add
+ * ------------------
+ * @brief  Adds a value to a sketch.
+ *
+ * @param kll The sketch.
+ * @param value The value (not NaN).
+ *
+ */
+void kll_add(kll_t *kll, double value)
+{
+    append(kll, 0, &value, 1);
+    kll->n++;
+    kll->min = value < kll->min ? value : kll->min;
+    kll->max = value > kll->max ? value : kll->max;
+    if (kll->size >= kll->max_size && kll->nlevels < KLL_MAX_LEVELS - 1)
+    {
+        compress(kll);
+    }
+}
+
+/**
+ * Function:  kll_merge
+ * --------------------
+ * @brief  Adds the values summarised by another sketch to a sketch.
+ *
+ * @param kll The sketch to add to.
+ * @param other The sketch to add (unchanged).
+ *
+ */
+void kll_merge(kll_t *kll, const kll_t *other)
+{
+    int h;
+
+    while (kll->nlevels < other->nlevels)
+    {
+        grow(kll);
+    }
+    for (h = 0; h < other->nlevels; h++)
+    {
+        if (other->sizes[h] > 0)
+        {
+            append(kll, h, other->levels[h], other->sizes[h]);
+        }
+    }
+    kll->n += other->n;
+    kll->min = other->min < kll->min ? other->min : kll->min;
+    kll->max = other->max > kll->max ? other->max : kll->max;
+    while (kll->size >= kll->max_size && kll->nlevels < KLL_MAX_LEVELS - 1)
+    {
+        compress(kll);
+    }
+}
+
+/**
+ * Function:  compare_weighted
+ * ---------------------------
+ * @brief  qsort() comparator putting weighted values in increasing order of value.
+ *
+ */
+static int compare_weighted(const void *a, const void *b)
+{
+    return compare_doubles(&((const weighted_t *)a)->value, &((const weighted_t *)b)->value);
+}
+
+/**
+ * Function:  kll_quantiles
+ * ------------------------
+ * @brief  Estimates the values at some ranks of a sketch.
+ *
+ * The value at rank q is the smallest value with at least q * n values at
+ * or below it (the nearest-rank definition), so q = 0.5 is the median.
+ *
+ * @param kll The sketch.
+ * @param ranks The ranks, each in [0, 1].
+ * @param nranks The number of ranks.
+ * @param values Set to the value at each rank (NAN for an empty sketch).
+ *
+ */
+void kll_quantiles(const kll_t *kll, const double *ranks, int nranks, double *values)
+{
+    weighted_t *all = (weighted_t *)emalloc((kll->size + 1) * sizeof(weighted_t));
+    uint64_t below, target;
+    int h, i, j, n = 0;
+
+    for (h = 0; h < kll->nlevels; h++)
+    {
+        for (i = 0; i < kll->sizes[h]; i++)
+        {
+            all[n].value = kll->levels[h][i];
+            all[n++].weight = (uint64_t)1 << h;
+        }
+    }
+    qsort(all, n, sizeof(weighted_t), compare_weighted);
+
+    for (j = 0; j < nranks; j++)
+    {
+        target = (uint64_t)ceil(ranks[j] * (double)kll->n);
+        values[j] = kll->n == 0 ? NAN : kll->max;
+        for (i = 0, below = 0; i < n; i++)
+        {
+            below += all[i].weight;
+            if (below >= target)
+            {
+                values[j] = all[i].value;
+                break;
+            }
+        }
+    }
+    efree(all);
+}
+
+/**
+ * Function:  kll_free
+ * -------------------
+ * @brief  Releases the values held by a sketch.
+ *
+ * @param kll The sketch.
+ *
+ */
+void kll_free(kll_t *kll)
+{
+    int h;
+
+    for (h = 0; h < kll->nlevels; h++)
+    {
+        efree(kll->levels[h]);
+    }
+    kll->nlevels = 0;
+}
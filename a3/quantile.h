@@ -0,0 +1,46 @@
+/** @file quantile.h
+ *  @brief Function prototypes for the mergeable quantile sketch.
+ *
+ */
+#ifndef _QUANTILE_H_
+#define _QUANTILE_H_
+
+#include <stdint.h>
+
+#define KLL_DEFAULT_K 200
+#define KLL_MAX_LEVELS 48
+
+/**
+ * @brief A KLL quantile sketch (Karnin, Lang and Liberty) of the values added to it.
+ *
+ * Level h holds values that each stand for 2^h of the values added. A full
+ * level is sorted and every other value moved up a level, so the sketch
+ * keeps about 3k values however many are added, and ranks are off by about
+ * n / k at most. Until k values have been added, the sketch holds every
+ * value and is exact.
+ */
+typedef struct
+{
+    int k;
+    int nlevels;
+    double *levels[KLL_MAX_LEVELS];
+    int sizes[KLL_MAX_LEVELS];
+    int caps[KLL_MAX_LEVELS];
+    int size;
+    int max_size;
+    uint64_t n;
+    double min;
+    double max;
+    uint64_t coin;
+} kll_t;
+
+/**
+ * Function protypes associated with the quantile sketch.
+ */
+void kll_init(kll_t *, int k);
+void kll_add(kll_t *, double value);
+void kll_merge(kll_t *, const kll_t *other);
+void kll_quantiles(const kll_t *, const double *ranks, int nranks, double *values);
+void kll_free(kll_t *);
+
+#endif
@@ -0,0 +1,443 @@
+/** @file reader.c
+ *  @brief Implementation of reader.h
+ *
+ * Plain files are handed to the parser as a regular stdio stream. Compressed
+ * files are decompressed by a worker thread into a ring of READER_SLOTS
+ * chunks, and the parser reads from them through a fopencookie() stream, so
+ * fgets() keeps working unchanged on top of either source. Standard input
+ * goes through the gzip worker too: zlib passes data that is not gzip
+ * through unchanged, so a pipe may carry either, and reading it runs ahead
+ * of the parser in its own thread.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "emalloc.h"
+#include "reader.h"
+
+/**
+ * Function:  has_suffix
+ * ---------------------
+ * @brief  Checks whether a string ends with a given suffix.
+ *
+ * @param s The string to check.
+ * @param suffix The suffix to look for.
+ *
+ * @return int 1 if s ends with suffix, 0 otherwise.
+ *
+ */
+static int has_suffix(const char *s, const char *suffix)
+{
+    size_t n = strlen(s);
+    size_t m = strlen(suffix);
+
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+/**
+ * Function:  data_format
+ * ----------------------
+ * @brief  Works out the compression format of a route file from its name.
+ *
+ * @param path The path of the route file.
+ *
+ * @return format_t The format the file should be decoded with.
+ *
+ */
+format_t data_format(const char *path)
+{
+    if (strcmp(path, READER_STDIN) == 0)
+    {
+        return FORMAT_STDIN;
+    }
+    if (has_suffix(path, ".gz"))
+    {
+        return FORMAT_GZIP;
+    }
+    if (has_suffix(path, ".zst"))
+    {
+        return FORMAT_ZSTD;
+    }
+    return FORMAT_PLAIN;
+}
+
+/**
+ * Function:  claim_slot
+ * ---------------------
+ * @brief  Waits for a free chunk in the ring (worker side).
+ *
+ * @param r The reader being filled.
+ *
+ * @return char* The chunk to decompress into, or NULL if the reader was closed.
+ *
+ */
+static char *claim_slot(reader_t *r)
+{
+    char *slot = NULL;
+
+    pthread_mutex_lock(&r->lock);
+    while (r->count == READER_SLOTS && !r->cancelled)
+    {
+        pthread_cond_wait(&r->drained, &r->lock);
+    }
+    if (!r->cancelled)
+    {
+        slot = r->slots[(r->head + r->count) % READER_SLOTS];
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return slot;
+}
+
+/**
+ * Function:  publish_slot
+ * -----------------------
+ * @brief  Hands a filled chunk over to the parser (worker side).
+ *
+ * @param r The reader being filled.
+ * @param n The number of bytes written into the claimed chunk.
+ *
+ */
+static void publish_slot(reader_t *r, size_t n)
+{
+    pthread_mutex_lock(&r->lock);
+    r->used[(r->head + r->count) % READER_SLOTS] = n;
+    r->count++;
+    pthread_cond_signal(&r->filled);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * Function:  finish
+ * -----------------
+ * @brief  Marks the end of the decompressed stream (worker side).
+ *
+ * @param r The reader being filled.
+ * @param failed Non-zero if decompression stopped because of an error.
+ *
+ */
+static void finish(reader_t *r, int failed)
+{
+    pthread_mutex_lock(&r->lock);
+    r->done = 1;
+    r->failed = failed;
+    pthread_cond_signal(&r->filled);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * Function:  gunzip_worker
+ * ------------------------
+ * @brief  Thread body that streams a gzip file, or standard input, into the ring.
+ *
+ * @param arg The reader to fill.
+ *
+ * @return void* Always NULL.
+ *
+ */
+static void *gunzip_worker(void *arg)
+{
+    reader_t *r = (reader_t *)arg;
+    gzFile gz;
+    char *slot;
+    int fd, err;
+    int n;
+
+    // gzclose() closes the descriptor, so standard input is read through a copy of it
+    if (r->format == FORMAT_STDIN)
+    {
+        fd = dup(STDIN_FILENO);
+        gz = fd < 0 ? NULL : gzdopen(fd, "rb");
+        if (gz == NULL && fd >= 0)
+        {
+            close(fd);
+        }
+    }
+    else
+    {
+        gz = gzopen(r->path, "rb");
+    }
+    if (gz == NULL)
+    {
+        finish(r, 1);
+        return NULL;
+    }
+    gzbuffer(gz, READER_CHUNK);
+
+    while ((slot = claim_slot(r)) != NULL)
+    {
+        n = gzread(gz, slot, READER_CHUNK);
+        if (n <= 0)
+        {
+            // a stream cut short (a truncated file, a dropped pipe) ends in the middle of a member
+            gzerror(gz, &err);
+            finish(r, n < 0 || err == Z_BUF_ERROR);
+            break;
+        }
+        publish_slot(r, n);
+    }
+
+    gzclose(gz);
+    return NULL;
+}
+
+#ifdef HAVE_ZSTD
+/**
+ * Function:  unzstd_worker
+ * ------------------------
+ * @brief  Thread body that streams a zstd file into the ring.
+ *
+ * @param arg The reader to fill.
+ *
+ * @return void* Always NULL.
+ *
+ */
+static void *unzstd_worker(void *arg)
+{
+    reader_t *r = (reader_t *)arg;
+    FILE *src = fopen(r->path, "rb");
+    ZSTD_DStream *ds = ZSTD_createDStream();
+    size_t in_size = ZSTD_DStreamInSize();
+    char *in_buf = emalloc(in_size);
+    ZSTD_inBuffer in = {in_buf, 0, 0};
+    ZSTD_outBuffer out;
+    int eof = 0;
+    int failed = 0;
+    int pending = 0;
+    size_t hint = 0;
+    char *slot;
+
+    if (src == NULL || ds == NULL)
+    {
+        finish(r, 1);
+        eof = 1;
+    }
+    else
+    {
+        ZSTD_initDStream(ds);
+    }
+
+    while (!eof && (slot = claim_slot(r)) != NULL)
+    {
+        out.dst = slot;
+        out.size = READER_CHUNK;
+        out.pos = 0;
+
+        while (out.pos < out.size)
+        {
+            // only refill once the decoder has flushed what it was holding
+            if (in.pos == in.size && !pending)
+            {
+                in.size = fread(in_buf, 1, in_size, src);
+                in.pos = 0;
+                if (in.size == 0)
+                {
+                    // a non-zero hint means the last frame still expects input: the file was cut short
+                    eof = 1;
+                    failed = hint != 0;
+                    break;
+                }
+            }
+            hint = ZSTD_decompressStream(ds, &out, &in);
+            if (ZSTD_isError(hint))
+            {
+                eof = 1;
+                failed = 1;
+                break;
+            }
+            pending = out.pos == out.size;
+        }
+
+        if (out.pos > 0)
+        {
+            publish_slot(r, out.pos);
+        }
+        if (eof)
+        {
+            finish(r, failed);
+        }
+    }
+
+    if (src != NULL)
+    {
+        fclose(src);
+    }
+    ZSTD_freeDStream(ds);
+    efree(in_buf);
+    return NULL;
+}
+#endif
+
+/**
+ * Function:  read_chunks
+ * ----------------------
+ * @brief  fopencookie() read callback that drains the ring (parser side).
+ *
+ * @param cookie The reader being drained.
+ * @param buf Where to copy the decompressed bytes.
+ * @param size The maximum number of bytes to copy.
+ *
+ * @return ssize_t The number of bytes copied, 0 at the end, -1 on errors.
+ *
+ */
+static ssize_t read_chunks(void *cookie, char *buf, size_t size)
+{
+    reader_t *r = (reader_t *)cookie;
+    size_t n;
+
+    pthread_mutex_lock(&r->lock);
+    while (r->count == 0 && !r->done)
+    {
+        pthread_cond_wait(&r->filled, &r->lock);
+    }
+    if (r->count == 0)
+    {
+        pthread_mutex_unlock(&r->lock);
+        return r->failed ? -1 : 0;
+    }
+
+    n = r->used[r->head] - r->offset;
+    if (n > size)
+    {
+        n = size;
+    }
+    memcpy(buf, r->slots[r->head] + r->offset, n);
+    r->offset += n;
+
+    if (r->offset == r->used[r->head])
+    {
+        r->head = (r->head + 1) % READER_SLOTS;
+        r->count--;
+        r->offset = 0;
+        pthread_cond_signal(&r->drained);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return n;
+}
+
+/**
+ * Function:  open_reader
+ * ----------------------
+ * @brief  Opens a route file for reading, decompressing .gz and .zst files on the fly.
+ *
+ * @param path The path of the route file, or READER_STDIN for standard input.
+ *
+ * @return reader_t* The open reader, or NULL if the file cannot be read.
+ *
+ */
+reader_t *open_reader(const char *path)
+{
+    cookie_io_functions_t io = {read_chunks, NULL, NULL, NULL};
+    void *(*worker)(void *) = gunzip_worker;
+    reader_t *r;
+    FILE *probe;
+    int i;
+
+    r = (reader_t *)emalloc(sizeof(reader_t));
+    memset(r, 0, sizeof(reader_t));
+    r->format = data_format(path);
+
+    if (r->format == FORMAT_PLAIN)
+    {
+        r->fp = fopen(path, "r");
+        if (r->fp == NULL)
+        {
+            efree(r);
+            return NULL;
+        }
+        return r;
+    }
+
+#ifdef HAVE_ZSTD
+    if (r->format == FORMAT_ZSTD)
+    {
+        worker = unzstd_worker;
+    }
+#else
+    if (r->format == FORMAT_ZSTD)
+    {
+        fprintf(stderr, "zstd support was not compiled in: %s\n", path);
+        efree(r);
+        return NULL;
+    }
+#endif
+
+    // fail early on missing files rather than from inside the worker
+    if (r->format != FORMAT_STDIN)
+    {
+        probe = fopen(path, "rb");
+        if (probe == NULL)
+        {
+            efree(r);
+            return NULL;
+        }
+        fclose(probe);
+    }
+
+    r->path = estrdup(MEM_SCRATCH, path);
+    for (i = 0; i < READER_SLOTS; i++)
+    {
+        r->slots[i] = (char *)emalloc(READER_CHUNK);
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->filled, NULL);
+    pthread_cond_init(&r->drained, NULL);
+
+    r->fp = fopencookie(r, "r", io);
+    pthread_create(&r->worker, NULL, worker, r);
+
+    return r;
+}
+
+/**
+ * Function:  close_reader
+ * -----------------------
+ * @brief  Closes a reader, stopping its decompression thread if needed.
+ *
+ * @param r The reader to close.
+ *
+ * @return int 0: No errors; 1: The stream could not be fully decompressed.
+ *
+ */
+int close_reader(reader_t *r)
+{
+    int failed = 0;
+    int i;
+
+    if (r == NULL)
+    {
+        return 0;
+    }
+
+    fclose(r->fp);
+
+    if (r->format != FORMAT_PLAIN)
+    {
+        pthread_mutex_lock(&r->lock);
+        r->cancelled = 1;
+        pthread_cond_signal(&r->drained);
+        pthread_mutex_unlock(&r->lock);
+        pthread_join(r->worker, NULL);
+
+        failed = r->failed;
+        for (i = 0; i < READER_SLOTS; i++)
+        {
+            efree(r->slots[i]);
+        }
+        pthread_mutex_destroy(&r->lock);
+        pthread_cond_destroy(&r->filled);
+        pthread_cond_destroy(&r->drained);
+        efree(r->path);
+    }
+
+    efree(r);
+    return failed;
+}
@@ -0,0 +1,65 @@
+/** @file reader.h
+ *  @brief Function prototypes for reading (possibly compressed) route files.
+ *
+ */
+#ifndef _READER_H_
+#define _READER_H_
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define READER_CHUNK 65536
+#define READER_SLOTS 4
+
+// the path that names standard input
+#define READER_STDIN "-"
+
+/**
+ * @brief The compression formats recognised from the file extension.
+ *
+ * Standard input has no extension; it may be plain or gzip, which zlib
+ * tells apart from the first bytes.
+ */
+typedef enum
+{
+    FORMAT_PLAIN,
+    FORMAT_GZIP,
+    FORMAT_ZSTD,
+    FORMAT_STDIN
+} format_t;
+
+/**
+ * @brief A struct that represents an open route file.
+ *
+ * The parser only ever reads from fp. For compressed files and standard
+ * input fp is backed by a small ring of chunks that a decompression thread
+ * fills while the parser drains it, so no decompressed copy is ever written
+ * to disk and a pipe is read in constant memory.
+ */
+typedef struct reader_t
+{
+    FILE *fp;
+    format_t format;
+    char *path;
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;
+    pthread_cond_t drained;
+    char *slots[READER_SLOTS];
+    size_t used[READER_SLOTS];
+    int head;
+    int count;
+    size_t offset;
+    int done;
+    int failed;
+    int cancelled;
+} reader_t;
+
+/**
+ * Function protypes associated with a reader.
+ */
+format_t data_format(const char *path);
+reader_t *open_reader(const char *path);
+int close_reader(reader_t *);
+
+#endif
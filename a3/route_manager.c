@@ -10,33 +10,41 @@
  *
  */
 #include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "list.h"
+#include "distinct.h"
+#include "routemanager.h"
+#include "cache.h"
+#include "emalloc.h"
 
-char fileToRead[40];
-char question[5];
+const char *fileToRead = "";
+char question[16];
 char N[5];
-
-// TODO: Make sure to adjust this based on the input files given
-#define MAX_LINE_LENGTH 80
-typedef struct
-{
-    char *airline_name;
-    char *airline_icao_unique_code;
-    char *airline_country;
-    char *from_airport_name;
-    char *from_airport_city;
-    char *from_airport_country;
-    char *from_airport_icao_unique_code;
-    char *from_airport_altitude;
-    char *to_airport_name;
-    char *to_airport_city;
-    char *to_airport_country;
-    char *to_airport_icao_unique_code;
-    char *to_airport_altitude;
-} Route;
+size_t memoryLimit = 0;
+int approxCounters = 0;
+int countMin = 0;
+int hllPrecision = 0;
+int kllSize = 0;
+int useCube = 0;
+const char *country = NULL;
+const char *partitionName = NULL;
+const char *partialPath = NULL;
+const char *mergeSpec = NULL;
+const char *exportPath = NULL;
+int arrowOutput = 0;
+double sampleFraction = 1.0;
+int sharedData = 0;
+const char *cacheDir = NULL;
+size_t cacheSize = 64 * 1024 * 1024;
+int memStats = 0;
+
+#define APPROX_DEFAULT_COUNTERS 1024
+#define MAX_QUESTIONS 7
 
 /**
  * @brief Serves as an incremental counter for navigating the list.
@@ -80,15 +88,69 @@ void analysis(node_t *l)
     apply(l, print_node, "%s\n");
 }
 
+/**
+ * @brief Parses a byte count such as 4096, 512K, 64M or 2G.
+ *
+ * @param text the text to parse
+ * @param size set to the number of bytes
+ * @return int 0: No errors; 1: The text is not a count with an optional K, M or G suffix.
+ *
+ */
+int parse_size(const char *text, size_t *size)
+{
+    char *end;
+    unsigned long value;
+    int shift = 0;
+
+    if (!isdigit((unsigned char)text[0]))
+    {
+        return 1;
+    }
+    errno = 0;
+    value = strtoul(text, &end, 10);
+    if (errno == ERANGE)
+    {
+        return 1;
+    }
+
+    switch (*end)
+    {
+    case 'G':
+    case 'g':
+        shift = 30;
+        end++;
+        break;
+    case 'M':
+    case 'm':
+        shift = 20;
+        end++;
+        break;
+    case 'K':
+    case 'k':
+        shift = 10;
+        end++;
+        break;
+    }
+    if (*end != '\0' || value > (SIZE_MAX >> shift))
+    {
+        return 1;
+    }
+    *size = (size_t)value << shift;
+    return 0;
+}
+
 /**
  * @brief Gets the Arguments that the user passes from the command-line
  *
  * @param no_of_args the count of the arguments passed
  * @param argv[] The array of arguments passed
+ * @return int 0: No errors; 1: an option is out of range.
  *
  */
-void get_arguments(int no_of_args, char *argv[])
+int get_arguments(int no_of_args, char *argv[])
 {
+    char *end;
+
     // Prints Out an error message if no file is given to access the data
     if (no_of_args < 2)
     {
@@ -103,523 +165,465 @@ void get_arguments(int no_of_args, char *argv[])
 
     else
     {
-        sscanf(argv[1], "--DATA=%s", fileToRead);
-        sscanf(argv[2], "--QUESTION=%[^\n]", question);
+        // the path is used in place, so it may be as long as the shell allows
+        if (strncmp(argv[1], "--DATA=", 7) == 0)
+        {
+            fileToRead = argv[1] + 7;
+        }
+        else if (strncmp(argv[1], "--MERGE=", 8) == 0)
+        {
+            mergeSpec = argv[1] + 8;
+        }
+        sscanf(argv[2], "--QUESTION=%15[^\n]", question);
         sscanf(argv[3], "--N=%[^\n]", N);
+
+        // optional arguments may follow in any order
+        for (int i = 4; i < no_of_args; i++)
+        {
+            if (strncmp(argv[i], "--MEMORY_LIMIT=", 15) == 0)
+            {
+                if (parse_size(argv[i] + 15, &memoryLimit) != 0)
+                {
+                    printf("--MEMORY_LIMIT takes a size in bytes, with an optional K, M or G suffix\n");
+                    return 1;
+                }
+            }
+            else if (strncmp(argv[i], "--APPROX=", 9) == 0)
+            {
+                approxCounters = (int)strtol(argv[i] + 9, &end, 10);
+                if (end == argv[i] + 9 || *end != '\0' || approxCounters < 1)
+                {
+                    printf("--APPROX takes a positive number of counters\n");
+                    return 1;
+                }
+            }
+            else if (strcmp(argv[i], "--APPROX") == 0)
+            {
+                approxCounters = APPROX_DEFAULT_COUNTERS;
+            }
+            else if (strcmp(argv[i], "--COUNT_MIN") == 0)
+            {
+                countMin = 1;
+            }
+            else if (strcmp(argv[i], "--CUBE") == 0)
+            {
+                useCube = 1;
+            }
+            else if (strcmp(argv[i], "--MEMSTATS") == 0)
+            {
+                memStats = 1;
+            }
+            else if (strncmp(argv[i], "--COUNTRY=", 10) == 0)
+            {
+                country = argv[i] + 10;
+            }
+            else if (strncmp(argv[i], "--PARTITION=", 12) == 0)
+            {
+                partitionName = argv[i] + 12;
+            }
+            else if (strncmp(argv[i], "--PARTIAL=", 10) == 0)
+            {
+                partialPath = argv[i] + 10;
+            }
+            else if (strcmp(argv[i], "--ARROW") == 0)
+            {
+                arrowOutput = 1;
+            }
+            else if (strncmp(argv[i], "--EXPORT=", 9) == 0)
+            {
+                exportPath = argv[i] + 9;
+            }
+            else if (strcmp(argv[i], "--SHARED") == 0)
+            {
+                sharedData = 1;
+            }
+            else if (strncmp(argv[i], "--SAMPLE=", 9) == 0)
+            {
+                sampleFraction = strtod(argv[i] + 9, &end);
+                if (end == argv[i] + 9 || *end != '\0' || !(sampleFraction > 0 && sampleFraction <= 1))
+                {
+                    printf("--SAMPLE takes a fraction in (0, 1]\n");
+                    return 1;
+                }
+            }
+            else if (strncmp(argv[i], "--CACHE=", 8) == 0)
+            {
+                cacheDir = argv[i] + 8;
+            }
+            else if (strncmp(argv[i], "--CACHE_SIZE=", 13) == 0)
+            {
+                if (parse_size(argv[i] + 13, &cacheSize) != 0)
+                {
+                    printf("--CACHE_SIZE takes a size in bytes, with an optional K, M or G suffix\n");
+                    return 1;
+                }
+            }
+            else if (strncmp(argv[i], "--KLL=", 6) == 0)
+            {
+                kllSize = (int)strtol(argv[i] + 6, &end, 10);
+                if (end == argv[i] + 6 || *end != '\0' || kllSize < 1)
+                {
+                    printf("--KLL takes a positive sketch size\n");
+                    return 1;
+                }
+            }
+            else if (strncmp(argv[i], "--HLL=", 6) == 0)
+            {
+                hllPrecision = atoi(argv[i] + 6);
+                if (hllPrecision < HLL_MIN_PRECISION || hllPrecision > HLL_MAX_PRECISION)
+                {
+                    printf("--HLL precision must be between %d and %d\n", HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+                    return 1;
+                }
+            }
+        }
     }
+    return 0;
 }
 
 /**
- * @brief removes the white space from the front while parsing
+ * @brief Parses --QUESTION: one question, or several separated by commas.
  *
- * @param value the value to remove the whitespace from
+ * @param text the value of --QUESTION
+ * @param questions set to the questions, in the order given (at most MAX_QUESTIONS)
+ * @return int the number of questions, or 0 if some is not 1 to 7 or is repeated
  *
  */
-void removeWhitespace(char *value)
+int parse_questions(const char *text, int questions[MAX_QUESTIONS])
 {
-    int i, j;
+    int n = 0, i;
 
-    // loop through the array starting from the third character
-    for (i = 1, j = 0; value[i] != '\0'; i++, j++)
+    for (;;)
     {
-        value[j] = value[i]; // shift the characters two positions to the left
+        if (text[0] < '1' || text[0] > '7' || (text[1] != ',' && text[1] != '\0') || n == MAX_QUESTIONS)
+        {
+            return 0;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (questions[i] == text[0] - '0')
+            {
+                return 0;
+            }
+        }
+        questions[n++] = text[0] - '0';
+        if (text[1] == '\0')
+        {
+            return n;
+        }
+        text += 2;
     }
-
-    value[j] = '\0'; // add null character to terminate the stri
 }
 
 /**
- * @brief Prints the data obtained into a CSV file according to the given user size
+ * @brief Builds the cache key of one question: the input's fingerprint and everything that shapes the answer.
  *
- * @param data the filtered data from the program
- * @param N the size of the data wanted passed by the user
+ * @param key where to write the key (MAX_CACHE_KEY bytes)
+ * @param fingerprint the fingerprint of the input file
+ * @param query the question
  *
  */
-void exportCSV(node_t *data, int N)
+void cache_key(char *key, const char *fingerprint, const rm_query_t *query)
 {
+    char sample[32] = "";
 
-    FILE *output = fopen("output.csv", "w+"); // opens a file in write mode
-    // grabs the first (head) node of the final linked list
-    node_t *curr;
-    int count = 0; // counter for comparing with display variable
-    fprintf(output, "subject,statistic\n");
-    for (curr = data; curr != NULL; curr = curr->next)
+    if (sampleFraction < 1.0)
     {
-        if (count < N)
-        {
-            fprintf(output, "%s\n", curr->word);
-        }
-        count++;
+        snprintf(sample, sizeof(sample), ":s%.17g", sampleFraction);
     }
+    snprintf(key, MAX_CACHE_KEY, "%s:q%d:n%d:a%d:c%d:h%d:k%d:p%d:%s%s%s", fingerprint, query->question, query->n,
+             query->approx_counters, query->count_min, query->hll_precision, query->kll_k, (int)query->partition,
+             query->question == 1 && query->country != NULL ? query->country : "", arrowOutput ? ":arrow" : "", sample);
 }
 
 /**
- * @brief Question 1 handler(produces the correct output to answer q1)
+ * @brief Writes one line of the answer to the output CSV file.
  *
- * @return int 0: No errors; 1: Errors produced.
+ * @param row the line to write (without its newline)
+ * @param arg the FILE* of output.csv
  *
  */
-int questionOne()
+void write_row(const char *row, void *arg)
 {
-    int dataReq = atoi(N);
-
-    // the name of the .yaml file
-    node_t *airlines = NULL;
-    FILE *fp = fopen(fileToRead, "r"); // open the file for reading
-
-    if (!fp)
-    {
-        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
-        return 1;
-    }
-
-    char line[MAX_LINE_LENGTH];
-    // read and ignore the first line
-    fgets(line, MAX_LINE_LENGTH, fp);
-
-    char *key = NULL;
-    char *value = NULL;
+    fprintf((FILE *)arg, "%s\n", row);
+}
 
-    Route myroute;
-    myroute.airline_name = malloc(250 * sizeof(char));
-    myroute.airline_icao_unique_code = malloc(10 * sizeof(char));
-    myroute.to_airport_country = malloc(250 * sizeof(char));
+/**
+ * @brief Names the answer file of a question: output.csv when it is asked alone, output_<question>.csv among several (.arrow with --ARROW).
+ *
+ * @param name where to write the name (32 bytes)
+ * @param question the question
+ * @param nquestions the number of questions asked
+ *
+ */
+void output_name(char *name, int question, int nquestions)
+{
+    const char *extension = arrowOutput ? "arrow" : "csv";
 
-    while (fgets(line, MAX_LINE_LENGTH, fp))
+    if (nquestions == 1)
     {
-        // skip lines that contain only whitespace
-        if (strspn(line, " \t\n\r\v\f") == strlen(line))
-        {
-            continue;
-        }
-        key = strtok(line, ":");
-        value = strtok(NULL, "\n");
-
-        // Reads all the data that will be relevent to us for the question
-        if (line[0] == '-')
-        {
-            removeWhitespace(value);
-            strcpy(myroute.airline_name, value);
-        }
-        else if (strcmp(key, "  airline_icao_unique_code") == 0)
-        {
-            removeWhitespace(value);
-            strcpy(myroute.airline_icao_unique_code, value);
-        }
-        else if (strcmp(key, "  to_airport_country") == 0)
-        {
-            removeWhitespace(value);
-            strcpy(myroute.to_airport_country, value);
-        }
-
-        if (strcmp(value, "Canada") == 0)
-        {
-            char *required = malloc(500 * sizeof(char));
-            strcpy(required, myroute.airline_name);
-            strcat(required, " (");
-            strcat(required, myroute.airline_icao_unique_code);
-            strcat(required, "),");
-            node_t *temp_node = new_node(required, 0);
-            // airlines = add_front(airlines, temp_node);
-            airlines = add_inorder(airlines, temp_node);
-            free(required);
-        }
+        sprintf(name, "output.%s", extension);
     }
-    node_t *curr;
-    int count = 1;
-    node_t *airlines_final = NULL;
-    node_t *temp2 = NULL;
-    char *val = malloc(500 * sizeof(char));
-    temp2 = new_node(val, 0);
-
-    for (curr = airlines; curr != NULL; curr = curr->next)
+    else
     {
-        if (curr->next != NULL && strcmp(curr->word, curr->next->word) == 0)
-        {
-            count += 1;
-        }
-        else
-        {
-            char str[20];
-            char *word_1 = malloc(500 * sizeof(char));
-            strcpy(word_1, curr->word);
-            sprintf(str, "%d", count);
-            strcat(word_1, str);
-            temp2 = new_node(word_1, count);
-            free(word_1);
-            if (airlines_final == NULL)
-            {
-                airlines_final = add_front(airlines_final, temp2);
-            }
-            else
-            {
-                airlines_final = sortDecending(airlines_final, temp2);
-            }
-
-            count = 1;
-        }
+        sprintf(name, "output_%d.%s", question, extension);
     }
+}
 
-    exportCSV(airlines_final, dataReq);
-
-    fclose(fp);
-    node_t *tempNode1 = NULL;
-    node_t *tempNode2 = NULL;
-
-    free(myroute.to_airport_country);
-    free(myroute.airline_name);
-    free(myroute.airline_icao_unique_code);
-    free(val);
+/**
+ * @brief Opens the output of one answer: the CSV file itself, or with --ARROW the rows to convert when it is done.
+ *
+ * @param name the output file
+ * @return void* the argument for answer_fn
+ *
+ */
+void *open_answer(const char *name)
+{
+    return arrowOutput ? (void *)rm_rows_new() : (void *)fopen(name, "w+"); // opens a file in write mode
+}
 
-    tempNode1 = airlines;
-    while (tempNode1 != NULL)
+/**
+ * @brief Finishes the output of one answer opened by open_answer().
+ *
+ * @param output what open_answer() returned
+ * @param name the output file
+ *
+ */
+void close_answer(void *output, const char *name)
+{
+    if (!arrowOutput)
     {
-        assert(tempNode1 != NULL);
-        airlines = remove_front(airlines);
-        free(tempNode1);
-        tempNode1 = airlines;
+        fclose((FILE *)output);
+        return;
     }
-
-    while (tempNode2 != NULL)
+    if (rm_rows_arrow((rm_rows_t *)output, name) != 0)
     {
-        assert(tempNode2 != NULL);
-        airlines_final = remove_front(airlines_final);
-        free(tempNode2);
-        tempNode2 = airlines_final;
+        fprintf(stderr, "Failed to write %s\n", name);
     }
-    return 0;
+    rm_rows_free((rm_rows_t *)output);
 }
 
 /**
- * @brief Question 2 handler (produces the correct output to answer q2).
- *
- * @return int 0: No errors; 1: Errors produced.
+ * @brief Prints the allocations of the run to stderr (registered with atexit() by --MEMSTATS).
  *
  */
-int questionTwo()
+void report_memory(void)
 {
-    int dataReq = atoi(N);
+    emalloc_report(stderr);
+}
 
-    // the name of the .yaml file
-    node_t *airlines = NULL;
-    FILE *fp = fopen(fileToRead, "r"); // open the file for reading
+/**
+ * @brief The main function and entry point of the program.
+ *
+ * @param argc The number of arguments passed to the program.
+ * @param argv The list of arguments passed to the program.
+ * @return int 0: No errors; 1: Errors produced.
+ *
+ */
 
-    if (!fp)
+int main(int argc, char *argv[])
+{
+    rm_query_t queries[MAX_QUESTIONS];
+    void *outputs[MAX_QUESTIONS];
+    char names[MAX_QUESTIONS][32];
+    char fingerprint[MAX_CACHE_KEY];
+    char key[MAX_CACHE_KEY];
+    int questions[MAX_QUESTIONS];
+    int nquestions, i, hits;
+    int cached = 0;
+    int partition = RM_BY_NONE;
+    rm_dataset_t *ds;
+    rm_row_fn answer_fn;
+
+    if (get_arguments(argc, argv) != 0)
     {
-        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
         return 1;
     }
+    answer_fn = arrowOutput ? rm_rows_add : write_row;
+    if (memStats)
+    {
+        atexit(report_memory);
+    }
 
-    char line[MAX_LINE_LENGTH];
-
-    // read and ignore the first line
-    fgets(line, MAX_LINE_LENGTH, fp);
-
-    char *key = NULL;
-    char *value = NULL;
-
-    Route myroute;
-    myroute.airline_name = malloc(250 * sizeof(char));
-    myroute.airline_icao_unique_code = malloc(10 * sizeof(char));
-    myroute.to_airport_country = malloc(250 * sizeof(char));
+    // only the questions 1 to 7 exist
+    nquestions = parse_questions(question, questions);
+    if (nquestions == 0)
+    {
+        return 1;
+    }
 
-    while (fgets(line, MAX_LINE_LENGTH, fp))
+    // --PARTITION splits the rankings of questions 1 to 3 by airline or country
+    if (partitionName != NULL)
     {
-        // skip lines that contain only whitespace
-        if (strspn(line, " \t\n\r\v\f") == strlen(line))
+        partition = rm_partition_by(partitionName);
+        for (i = 0; i < nquestions && partition >= 0; i++)
         {
-            continue;
+            partition = questions[i] <= 3 ? partition : -1;
         }
-        key = strtok(line, ":");
-        value = strtok(NULL, "\n");
-
-        // reads the first data set which begins with "-"
-        if (line[0] == '-')
+        if (partition < 0)
         {
-            removeWhitespace(value);
-            strcpy(myroute.airline_name, value);
-        }
-        else if (strcmp(key, "  to_airport_country") == 0)
-        {
-            removeWhitespace(value);
-            // To handle exceptions
-            if (value[0] == '\'')
-            {
-                value[0] = ' ';
-                removeWhitespace(value);
-                removeWhitespace(value);
-            }
-            if (value[strlen(value) - 1] == '\'')
-            {
-                value[strlen(value) - 1] = ' ';
-                int i = strlen(value) - 1;
-                while (i >= 0 && value[i] == ' ')
-                {
-                    i--;
-                }
-
-                // Terminate the string at the last non-whitespace character
-                value[i + 1] = '\0';
-            }
-            strcpy(myroute.to_airport_country, value);
-
-            char *required = malloc(500 * sizeof(char));
-
-            strcpy(required, myroute.to_airport_country);
-            strcat(required, ",");
-            node_t *temp_node = new_node(required, 0);
-            free(required);
-            airlines = add_inorder(airlines, temp_node);
+            printf("--PARTITION must be airline, from_country or to_country, for questions 1 to 3\n");
+            return 1;
         }
     }
+    for (i = 0; i < nquestions; i++)
+    {
+        queries[i].question = questions[i];
+        queries[i].n = atoi(N);
+        queries[i].memory_limit = memoryLimit;
+        queries[i].approx_counters = approxCounters;
+        queries[i].count_min = countMin;
+        queries[i].hll_precision = hllPrecision;
+        queries[i].kll_k = kllSize;
+        queries[i].country = country;
+        queries[i].partition = (rm_partition_t)partition;
+    }
 
-    node_t *curr1;
-
-    int count = 1;
-    node_t *airlines_final = NULL;
-    node_t *temp2 = NULL;
-
-    char *val = malloc(500 * sizeof(char));
-    temp2 = new_node(val, 0);
-
-    for (curr1 = airlines; curr1 != NULL; curr1 = curr1->next)
+    // --SAMPLE scales the counts of questions 1 to 3 up from a fraction of the routes
+    if (sampleFraction < 1.0)
     {
-        if (curr1->next != NULL && strcmp(curr1->word, curr1->next->word) == 0)
+        for (i = 0, hits = 0; i < nquestions; i++)
         {
-            count += 1;
+            hits += questions[i] > 3;
         }
-        else
+        if (hits > 0 || partition != RM_BY_NONE || approxCounters > 0 || partialPath != NULL ||
+            mergeSpec != NULL || sharedData || (country != NULL && strcmp(country, RM_ALL_COUNTRIES) == 0))
         {
-            char str[20];
-            char *word_1 = malloc(500 * sizeof(char));
-            strcpy(word_1, curr1->word);
-            sprintf(str, "%d", count);
-            strcat(word_1, str);
-            temp2 = new_node(word_1, count);
-            free(word_1);
-            if (airlines_final == NULL)
-            {
-                airlines_final = add_front(airlines_final, temp2);
-            }
-            else
-            {
-                airlines_final = sortAscending(airlines_final, temp2);
-            }
-            count = 1;
+            printf("--SAMPLE takes questions 1 to 3, without --PARTITION, --APPROX, "
+                   "--PARTIAL, --MERGE, --SHARED or --COUNTRY=ALL\n");
+            return 1;
         }
     }
 
-    exportCSV(airlines_final, dataReq);
-    fclose(fp);
-
-    node_t *tempNode1 = NULL;
-    node_t *tempNode2 = NULL;
-
-    free(myroute.to_airport_country);
-    free(myroute.airline_name);
-    free(myroute.airline_icao_unique_code);
-    free(val);
-
-    tempNode1 = airlines;
-    while (tempNode1 != NULL)
-    {
-        assert(tempNode1 != NULL);
-        airlines = remove_front(airlines);
-        free(tempNode1);
-        tempNode1 = airlines;
-    }
-
-    while (tempNode2 != NULL)
+    // partial aggregates hold the exact counts of one whole ranking
+    if (partialPath != NULL || mergeSpec != NULL)
     {
-        assert(tempNode2 != NULL);
-        airlines_final = remove_front(airlines_final);
-        free(tempNode2);
-        tempNode2 = airlines_final;
+        if (nquestions > 1 || questions[0] > 5 || partition != RM_BY_NONE || approxCounters > 0 || hllPrecision > 0 ||
+            (country != NULL && strcmp(country, RM_ALL_COUNTRIES) == 0))
+        {
+            printf("--PARTIAL and --MERGE take one of the questions 1 to 5, without --PARTITION, --APPROX, --HLL or "
+                   "--COUNTRY=ALL\n");
+            return 1;
+        }
     }
-    return 0;
-}
-
-/**
- * @brief Question 3 handler (produces the correct output to answer q3).
- *
- * @return int 0: No errors; 1: Errors produced.
- */
-int questionThree()
-{
-    int x = atoi(N);
 
-    // the name of the .yaml file
-    node_t *airlines = NULL;
-    FILE *fp = fopen(fileToRead, "r"); // open the file for reading
-
-    if (!fp)
+    // standard input is read once and has no stamp, so nothing can be built from it to keep or share
+    if (strcmp(fileToRead, "-") == 0 && (useCube || exportPath != NULL || sharedData))
     {
-        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
+        printf("--DATA=- cannot be used with --CUBE, --EXPORT or --SHARED\n");
         return 1;
     }
 
-    char line[MAX_LINE_LENGTH];
-    // read and ignore the first line
-    fgets(line, MAX_LINE_LENGTH, fp);
-
-    char *key = NULL;
-    char *value = NULL;
-    Route myroute;
-    myroute.airline_name = malloc(50 * sizeof(char));
-    myroute.to_airport_name = malloc(50 * sizeof(char));
-    myroute.to_airport_icao_unique_code = malloc(10 * sizeof(char));
-    myroute.to_airport_city = malloc(50 * sizeof(char));
-    myroute.to_airport_country = malloc(50 * sizeof(char));
-
-    while (fgets(line, MAX_LINE_LENGTH, fp))
+    // --MERGE answers from the partial aggregates of earlier runs instead of a route file
+    if (mergeSpec != NULL)
     {
-        // skip lines that contain only whitespace
-        if (strspn(line, " \t\n\r\v\f") == strlen(line))
+        output_name(names[0], questions[0], 1);
+        outputs[0] = open_answer(names[0]);
+        if (rm_merge(mergeSpec, &queries[0], answer_fn, outputs[0]) != 0)
         {
-            continue;
-        }
-        key = strtok(line, ":");
-        value = strtok(NULL, "\n");
-
-        if (line[0] == '-')
-        {
-            removeWhitespace(value);
-            strcpy(myroute.airline_name, value);
-        }
-        else if (strcmp(key, "  to_airport_name") == 0)
-        {
-            removeWhitespace(value);
-            strcpy(myroute.to_airport_name, value);
-        }
-        else if (strcmp(key, "  to_airport_city") == 0)
-        {
-            removeWhitespace(value);
-            strcpy(myroute.to_airport_city, value);
+            fprintf(stderr, "Failed to merge partial aggregates: %s\n", mergeSpec);
+            close_answer(outputs[0], names[0]);
+            return 1;
         }
+        close_answer(outputs[0], names[0]);
+        return 0;
+    }
 
-        else if (strcmp(key, "  to_airport_country") == 0)
+    // with --CACHE, answers already cached for this input are copied out without parsing it (not for --DATA=-);
+    // --EXPORT needs the routes parsed all the same, so it does not take the shortcut
+    if (cacheDir != NULL && partialPath == NULL && strcmp(fileToRead, "-") != 0 &&
+        cache_fingerprint(fileToRead, fingerprint) == 0)
+    {
+        for (i = 0, hits = 0; i < nquestions; i++)
         {
-            removeWhitespace(value);
-            strcpy(myroute.to_airport_country, value);
+            output_name(names[i], questions[i], nquestions);
+            cache_key(key, fingerprint, &queries[i]);
+            hits += cache_fetch(cacheDir, key, names[i]) == 0;
         }
-        else if (strcmp(key, "  to_airport_icao_unique_code") == 0)
+        if (hits == nquestions && exportPath == NULL)
         {
-            removeWhitespace(value);
-            strcpy(myroute.to_airport_icao_unique_code, value);
-
-            // Making the string into what we want as output
-            char *required = malloc(200 * sizeof(char));
-            strcpy(required, "\"");
-            strcat(required, myroute.to_airport_name);
-            strcat(required, " (");
-            strcat(required, myroute.to_airport_icao_unique_code);
-            strcat(required, "), ");
-            strcat(required, myroute.to_airport_city);
-            strcat(required, ", ");
-            strcat(required, myroute.to_airport_country);
-            strcat(required, "\",");
-
-            node_t *temp_node = new_node(required, 0);
-            free(required);
-
-            airlines = add_inorder(airlines, temp_node);
+            return 0;
         }
+        cached = 1;
     }
 
-    node_t *curr1;
-    int count = 1;
-    node_t *airlines_final = NULL;
-    node_t *temp2 = NULL;
-    char *val = malloc(500 * sizeof(char));
-    temp2 = new_node(val, 0);
-
-    for (curr1 = airlines; curr1 != NULL; curr1 = curr1->next)
+    // one plain question 1 to 3 about standard input is counted as the routes stream in, without keeping them
+    if (strcmp(fileToRead, "-") == 0 && nquestions == 1 && questions[0] <= 3 && partition == RM_BY_NONE &&
+        sampleFraction == 1.0 && partialPath == NULL && (country == NULL || strcmp(country, RM_ALL_COUNTRIES) != 0))
     {
-        if (curr1->next != NULL && strcmp(curr1->word, curr1->next->word) == 0)
+        output_name(names[0], questions[0], 1);
+        outputs[0] = open_answer(names[0]);
+        if (rm_query_stream(fileToRead, &queries[0], answer_fn, outputs[0]) != 0)
         {
-            count += 1;
-        }
-        else
-        {
-            char str[20];
-            char *word_1 = malloc(2000 * sizeof(char));
-            strcpy(word_1, curr1->word);
-            sprintf(str, "%d", count);
-            strcat(word_1, str);
-            temp2 = new_node(word_1, count);
-            free(word_1);
-            if (airlines_final == NULL)
-            {
-                airlines_final = add_front(airlines_final, temp2);
-            }
-            else
-            {
-                airlines_final = sortDecending(airlines_final, temp2);
-            }
-
-            count = 1;
+            fprintf(stderr, "Failed to open file: %s\n", fileToRead);
+            close_answer(outputs[0], names[0]);
+            return 1;
         }
+        close_answer(outputs[0], names[0]);
+        return 0;
     }
-    exportCSV(airlines_final, x);
-    fclose(fp);
-
-    node_t *tempNode1 = NULL;
-    node_t *tempNode2 = NULL;
 
-    free(myroute.airline_name);
-    free(myroute.to_airport_name);
-    free(myroute.to_airport_icao_unique_code);
-    free(myroute.to_airport_city);
-    free(myroute.to_airport_country);
-    free(val);
-
-    tempNode1 = airlines;
-    while (tempNode1 != NULL)
+    // --CUBE answers from the rollup cube (mainly to check it against a scan); --SAMPLE loads a fraction of the
+    // routes; --SHARED maps the routes another process has parsed, or parses them for the processes to come
+    ds = sharedData ? rm_open_shared(fileToRead)
+                    : rm_open_sample(fileToRead,
+                                     useCube || nquestions > 1 || partition != RM_BY_NONE || exportPath != NULL
+                                         ? 0
+                                         : questions[0],
+                                     sampleFraction);
+    if (ds == NULL)
     {
-        assert(tempNode1 != NULL);
-        airlines = remove_front(airlines);
-        free(tempNode1);
-        tempNode1 = airlines;
+        fprintf(stderr, "Failed to open file: %s\n", fileToRead);
+        return 1;
     }
-
-    while (tempNode2 != NULL)
+    if (useCube)
     {
-        assert(tempNode2 != NULL);
-        airlines_final = remove_front(airlines_final);
-        free(tempNode2);
-        tempNode2 = airlines_final;
+        rm_build_cube(ds);
     }
-    return 0;
-}
 
-/**
- * @brief The main function and entry point of the program.
- *
- * @param argc The number of arguments passed to the program.
- * @param argv The list of arguments passed to the program.
- * @return int 0: No errors; 1: Errors produced.
- *
- */
-
-int main(int argc, char *argv[])
-{
-    get_arguments(argc, argv);
+    // --EXPORT writes every parsed route as an Arrow IPC file, besides answering
+    if (exportPath != NULL && rm_export_arrow(ds, exportPath) != 0)
+    {
+        fprintf(stderr, "Failed to write %s\n", exportPath);
+    }
 
-    if (strcmp(question, "1") == 0)
+    // --PARTIAL writes the counts behind the answer, for a later --MERGE, instead of the answer
+    if (partialPath != NULL)
     {
-        questionOne();
+        i = rm_partial(ds, &queries[0], partialPath);
+        rm_close(ds);
+        if (i != 0)
+        {
+            fprintf(stderr, "Failed to write partial aggregate: %s\n", partialPath);
+            return 1;
+        }
+        return 0;
     }
-    else if (strcmp(question, "2") == 0)
+
+    // one question is answered in this thread; several run side by side
+    for (i = 0; i < nquestions; i++)
     {
-        questionTwo();
+        output_name(names[i], questions[i], nquestions);
+        outputs[i] = open_answer(names[i]);
     }
-    else if (strcmp(question, "3") == 0)
+    if (nquestions == 1)
     {
-        questionThree();
+        rm_query(ds, &queries[0], answer_fn, outputs[0]);
     }
     else
     {
-        return 1;
+        rm_query_many(ds, queries, nquestions, answer_fn, (void *const *)outputs, 0);
+    }
+    for (i = 0; i < nquestions; i++)
+    {
+        close_answer(outputs[i], names[i]);
+    }
+    rm_close(ds);
+
+    for (i = 0; cached && i < nquestions; i++)
+    {
+        cache_key(key, fingerprint, &queries[i]);
+        cache_store(cacheDir, key, names[i], cacheSize);
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,2302 @@
+/** @file routemanager.c
+ *  @brief Implementation of routemanager.h
+ *
+ * Every question walks the columns of a loaded dataset and counts each
+ * route's member (the string ids of its airline, country or airport); the
+ * subject a member is printed as is only built once, for ranking. When the
+ * dataset has a rollup cube, exact questions read its cells instead. All state of a query lives on its
+ * caller's stack, and the dataset is only read, which is what makes
+ * concurrent queries safe.
+ *
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "list.h"
+#include "emalloc.h"
+#include "aggregate.h"
+#include "sketch.h"
+#include "distinct.h"
+#include "dataset.h"
+#include "cube.h"
+#include "pool.h"
+#include "matrix.h"
+#include "idmap.h"
+#include "partial.h"
+#include "quantile.h"
+#include "segment.h"
+#include "routemanager.h"
+
+#define DECENDING 0
+#define ASCENDING 1
+
+// the largest subject a question builds: four values and some punctuation
+#define MAX_KEY_LENGTH (4 * MAX_VALUE_LENGTH + 16)
+
+// the routes one task counts or sketches
+#define ROUTE_CHUNK 65536
+
+// the normal quantile of a two-sided 95% confidence interval
+#define SAMPLE_Z 1.96
+
+/**
+ * @brief The ranked rows of a question, kept to the N rows that will be printed.
+ *
+ * While partial is set, every exactly counted key goes to that partial file
+ * instead, unranked. While sampled is set, counts are of that dataset's
+ * sample and are printed scaled to the whole file, with a margin of error.
+ */
+typedef struct
+{
+    node_t *list;
+    int limit;
+    int order;
+    const char *header;
+    partial_t *partial;
+    const dataset_t *sampled;
+} ranking_t;
+
+/**
+ * @brief Builds the subject column of a member (a cube member or a tuple of route fields) from its string ids.
+ */
+typedef void (*member_fn)(char *key, const dataset_t *ds, const uint32_t *ids);
+
+/**
+ * @brief Reads the member a route counts towards into ids (at most 4), or returns 0 if the route is not counted.
+ */
+typedef int (*route_fn)(const dataset_t *ds, size_t r, const void *arg, uint32_t *ids);
+
+/**
+ * @brief Counts the members of a question, exactly or with a fixed-size sketch.
+ *
+ * Members are tuples of string ids. The exact count keys on the ids
+ * themselves and builds each distinct member's subject once, at the end;
+ * the sketch and the memory-limited table key on subjects, which are built
+ * for every route.
+ */
+typedef struct
+{
+    const dataset_t *ds;
+    member_fn subject;
+    idmap_t members;
+    int by_id;
+    agg_t exact;
+    ss_t *sketch;
+} tally_t;
+
+/**
+ * @brief Collects the rows of an answer into a caller's buffer.
+ */
+typedef struct
+{
+    char *buf;
+    size_t size;
+    size_t len;
+} buffer_t;
+
+/**
+ * @brief One query of rm_query_many(), run as a task of the pool.
+ */
+typedef struct
+{
+    const rm_dataset_t *ds;
+    const rm_query_t *query;
+    rm_row_fn fn;
+    void *arg;
+    int failed;
+} job_t;
+
+/**
+ * @brief The routes one task of an exact count counts, into a map of its own.
+ */
+typedef struct
+{
+    const dataset_t *ds;
+    route_fn member;
+    const void *arg;
+    size_t first;
+    size_t last;
+    idmap_t members;
+} tally_job_t;
+
+/**
+ * @brief The routes one task of question 6 sketches, into one sketch per group.
+ */
+typedef struct
+{
+    const dataset_t *ds;
+    const double *altitudes; // the altitude each string id reads as, NAN if it is not a number
+    const uint32_t *groups;  // the group of each destination country
+    size_t first;
+    size_t last;
+    int ngroups;
+    int k;
+    kll_t *sketches;
+} altitude_job_t;
+
+/**
+ * @brief A question of rm_query_stream(), counted a window of routes at a time.
+ */
+typedef struct
+{
+    tally_t tally;
+    route_fn member;
+    const char *country; // question 1's destination, until it is found
+    uint32_t country_id; // its string id, UINT32_MAX until then
+} stream_t;
+
+/**
+ * @brief A member of a rolled-up dimension, as the subject it is printed as.
+ */
+typedef struct
+{
+    char *key;
+    long count;
+} rolled_t;
+
+/**
+ * Function:  question_fields
+ * --------------------------
+ * @brief  Returns the set of fields a question reads.
+ *
+ * @param question The question.
+ *
+ * @return unsigned The fields, or 0 if the question does not exist.
+ *
+ */
+static unsigned question_fields(int question)
+{
+    switch (question)
+    {
+    case 1:
+        return FIELD_BIT(FIELD_AIRLINE_NAME) | FIELD_BIT(FIELD_AIRLINE_ICAO) | FIELD_BIT(FIELD_TO_COUNTRY);
+    case 2:
+        return FIELD_BIT(FIELD_TO_COUNTRY);
+    case 3:
+        return FIELD_BIT(FIELD_TO_NAME) | FIELD_BIT(FIELD_TO_ICAO) | FIELD_BIT(FIELD_TO_CITY) |
+               FIELD_BIT(FIELD_TO_COUNTRY);
+    case 4:
+        return FIELD_BIT(FIELD_AIRLINE_NAME) | FIELD_BIT(FIELD_AIRLINE_ICAO) | FIELD_BIT(FIELD_TO_ICAO);
+    case 5:
+        return FIELD_BIT(FIELD_FROM_COUNTRY) | FIELD_BIT(FIELD_TO_COUNTRY);
+    case 6:
+        return FIELD_BIT(FIELD_FROM_ALTITUDE) | FIELD_BIT(FIELD_TO_ALTITUDE) | FIELD_BIT(FIELD_TO_COUNTRY);
+    case 7:
+        return FIELD_BIT(FIELD_TO_ALTITUDE);
+    }
+    return 0;
+}
+
+/**
+ * Function:  open_fields
+ * ----------------------
+ * @brief  Loads the given fields of a route file, or of every shard a directory or pattern names.
+ *
+ * @param path The route file, directory of shards or glob(7) pattern of shards.
+ * @param fields The set of fields to load.
+ * @param fraction The fraction of the routes to load (1 for all of them).
+ *
+ * @return rm_dataset_t* The dataset, or NULL if no file is found or one cannot be read.
+ *
+ */
+static rm_dataset_t *open_fields(const char *path, unsigned fields, double fraction)
+{
+    dataset_t *ds = (dataset_t *)emalloc_as(MEM_ROUTE_FIELDS, sizeof(dataset_t));
+
+    if (dataset_load_sample(ds, path, fields, fraction) != 0)
+    {
+        efree(ds);
+        return NULL;
+    }
+    return ds;
+}
+
+/**
+ * Function:  rm_open
+ * ------------------
+ * @brief  Loads a (possibly compressed) route file, ready for any question.
+ *
+ * path may also be a directory or a glob(7) pattern, whose files are then
+ * parsed in parallel as shards of one dataset.
+ *
+ * @param path The route file, directory of shards or pattern of shards.
+ *
+ * @return rm_dataset_t* The dataset, or NULL if no file is found or one cannot be read.
+ *
+ */
+rm_dataset_t *rm_open(const char *path)
+{
+    return open_fields(path, ALL_FIELDS, 1.0);
+}
+
+/**
+ * Function:  rm_open_for
+ * ----------------------
+ * @brief  Loads only the fields of a route file that one question reads.
+ *
+ * Meant for one-shot use such as the route_manager command: loading is
+ * faster and the dataset smaller, but other questions are refused.
+ *
+ * @param path The path of the route file.
+ * @param question The only question that will be asked.
+ *
+ * @return rm_dataset_t* The dataset, or NULL if the file cannot be read or the question does not exist.
+ *
+ */
+rm_dataset_t *rm_open_for(const char *path, int question)
+{
+    if (question_fields(question) == 0)
+    {
+        return NULL;
+    }
+    return open_fields(path, question_fields(question), 1.0);
+}
+
+/**
+ * Function:  rm_open_shared
+ * -------------------------
+ * @brief  Loads a route file through a shared-memory segment that concurrent processes parse only once.
+ *
+ * The first process to open a file parses it and publishes the parsed
+ * dataset (every field) as a named POSIX shared-memory object; the others
+ * wait for it, then map it read-only instead of parsing, so the routes are
+ * held in memory once however many processes query them. The segment is
+ * stamped with the file's identity, size and times: once the file changes,
+ * the next open parses it again and replaces the segment. If shared memory
+ * is unavailable or full, the file is parsed privately as rm_open() does.
+ *
+ * @param path The route file, directory of shards or pattern of shards.
+ *
+ * @return rm_dataset_t* The dataset (release with rm_close(), which leaves the segment), or NULL if no file is found or one cannot be read.
+ *
+ */
+rm_dataset_t *rm_open_shared(const char *path)
+{
+    dataset_t *ds = (dataset_t *)emalloc_as(MEM_ROUTE_FIELDS, sizeof(dataset_t));
+
+    if (segment_open(ds, path) != 0)
+    {
+        efree(ds);
+        return NULL;
+    }
+    return ds;
+}
+
+/**
+ * Function:  rm_open_sample
+ * -------------------------
+ * @brief  Loads a random sample of the routes of a file, for fast approximate answers to questions 1 to 3.
+ *
+ * Each route is kept with probability fraction and the others are skipped
+ * unparsed, so loading takes about fraction of the time. Queries of a
+ * sampled dataset print each count scaled to the whole file, followed by
+ * the margin of its 95% confidence interval: the true count lies within
+ * statistic - margin and statistic + margin for 19 subjects in 20. Subjects
+ * with no route in the sample are missing from the answer. The same file
+ * and fraction always give the same sample.
+ *
+ * @param path The route file, directory of shards or pattern of shards.
+ * @param question The only question that will be asked, or 0 to load every field.
+ * @param fraction The fraction of the routes to load, in (0, 1]; 1 loads them all, as rm_open() and rm_open_for() do.
+ *
+ * @return rm_dataset_t* The dataset, or NULL if the file cannot be read, the question does not exist or fraction is out of range.
+ *
+ */
+rm_dataset_t *rm_open_sample(const char *path, int question, double fraction)
+{
+    if ((question != 0 && question_fields(question) == 0) || !(fraction > 0 && fraction <= 1))
+    {
+        return NULL;
+    }
+    return open_fields(path, question == 0 ? ALL_FIELDS : question_fields(question), fraction);
+}
+
+/**
+ * Function:  rm_build_cube
+ * ------------------------
+ * @brief  Rolls a dataset up into a cube that later exact queries of questions 1 to 5 read instead of the routes.
+ *
+ * Building costs about one scan of the routes, so it pays off when a
+ * dataset is queried more than once. Like rm_close(), it needs the dataset
+ * to itself. Answers are the same with or without the cube.
+ *
+ * @param ds The dataset (opened with rm_open()).
+ *
+ * @return int 0: No errors; 1: The dataset lacks fields the cube needs.
+ *
+ */
+int rm_build_cube(rm_dataset_t *ds)
+{
+    if (ds->cube == NULL)
+    {
+        ds->cube = cube_build(ds);
+    }
+    return ds->cube == NULL;
+}
+
+/**
+ * Function:  rm_routes
+ * --------------------
+ * @brief  Returns the number of routes in a dataset.
+ *
+ * @param ds The dataset.
+ *
+ * @return size_t The number of routes.
+ *
+ */
+size_t rm_routes(const rm_dataset_t *ds)
+{
+    return ds->nroutes;
+}
+
+/**
+ * Function:  rm_close
+ * -------------------
+ * @brief  Releases a dataset. No query may be running on it.
+ *
+ * @param ds The dataset (may be NULL).
+ *
+ */
+void rm_close(rm_dataset_t *ds)
+{
+    if (ds == NULL)
+    {
+        return;
+    }
+    dataset_free(ds);
+    efree(ds);
+}
+
+/**
+ * Function:  unquote
+ * ------------------
+ * @brief  Copies a value without the single quotes YAML puts around values with leading or trailing blanks.
+ *
+ * The opening quote goes together with the blank after it, and the closing
+ * quote with every blank before it.
+ *
+ * @param dest Where to copy the value (MAX_VALUE_LENGTH bytes).
+ * @param value The value as it appears in the file.
+ *
+ * @return char* dest.
+ *
+ */
+static char *unquote(char *dest, const char *value)
+{
+    size_t len;
+
+    if (value[0] == '\'')
+    {
+        value += value[1] != '\0' ? 2 : 1;
+    }
+    strcpy(dest, value);
+
+    len = strlen(dest);
+    if (len > 0 && dest[len - 1] == '\'')
+    {
+        len--;
+        while (len > 0 && dest[len - 1] == ' ')
+        {
+            len--;
+        }
+        dest[len] = '\0';
+    }
+    return dest;
+}
+
+/**
+ * Function:  find_country
+ * -----------------------
+ * @brief  Returns the string id of a country as --COUNTRY names it, without the quotes of the file.
+ *
+ * @param ds The dataset.
+ * @param country The country's name, as country_subject() prints it.
+ *
+ * @return uint32_t Its string id, or ds->nstrings if no route has it.
+ *
+ */
+static uint32_t find_country(const dataset_t *ds, const char *country)
+{
+    char value[MAX_VALUE_LENGTH];
+    uint32_t id = dataset_find(ds, country);
+
+    if (id < ds->nstrings)
+    {
+        return id;
+    }
+    for (id = 0; id < ds->nstrings; id++)
+    {
+        if (dataset_string(ds, id)[0] == '\'' && strcmp(unquote(value, dataset_string(ds, id)), country) == 0)
+        {
+            return id;
+        }
+    }
+    return ds->nstrings;
+}
+
+/**
+ * Function:  rank_insert
+ * ----------------------
+ * @brief  Inserts a finished row into a ranking, dropping rows past the requested N.
+ *
+ * Rows arrive in strcmp() order of their keys, so rows with equal statistics
+ * keep the same relative order whether or not the tail has been dropped.
+ *
+ * @param ranking The ranking being built.
+ * @param word The full CSV row.
+ * @param count The statistic the row is ranked by.
+ *
+ */
+static void rank_insert(ranking_t *ranking, char *word, int count)
+{
+    node_t *temp = new_node(word, count);
+    node_t *curr;
+    int kept;
+
+    if (ranking->order == DECENDING)
+    {
+        ranking->list = sortDecending(ranking->list, temp);
+    }
+    else
+    {
+        ranking->list = sortAscending(ranking->list, temp);
+    }
+
+    if (ranking->limit <= 0)
+    {
+        free_list(ranking->list);
+        ranking->list = NULL;
+        return;
+    }
+    for (curr = ranking->list, kept = 1; curr != NULL && kept < ranking->limit; curr = curr->next)
+    {
+        kept++;
+    }
+    if (curr != NULL)
+    {
+        free_list(curr->next);
+        curr->next = NULL;
+    }
+}
+
+/**
+ * Function:  rank_sampled
+ * -----------------------
+ * @brief  Adds one key counted in a sample to a ranking, scaled to the whole file with its margin of error.
+ *
+ * The share of the sample a subject has estimates its share of the file;
+ * the margin is SAMPLE_Z standard errors of that estimate (a binomial
+ * proportion, with the finite population correction), scaled alike.
+ *
+ * @param key The subject column (including its trailing comma).
+ * @param count The routes of the subject in the sample.
+ * @param ranking The ranking being built.
+ *
+ */
+static void rank_sampled(char *key, int count, ranking_t *ranking)
+{
+    double n = (double)ranking->sampled->nroutes;
+    double total = (double)ranking->sampled->nscanned;
+    double share = count / n;
+    double margin = SAMPLE_Z * total * sqrt(share * (1 - share) / n * (1 - n / total));
+    char *word = emalloc(strlen(key) + 40);
+
+    // scaling keeps the order of the counts, so the sample counts rank the rows
+    sprintf(word, "%s%.0f,%.0f", key, count * total / n, ceil(margin));
+    rank_insert(ranking, word, count);
+    efree(word);
+}
+
+/**
+ * Function:  rank_node
+ * --------------------
+ * @brief  Adds one exactly counted key to a ranking.
+ *
+ * @param key The subject column (including its trailing comma).
+ * @param count The statistic for the subject.
+ * @param arg The ranking_t being built.
+ *
+ */
+static void rank_node(char *key, int count, void *arg)
+{
+    char *word;
+
+    if (((ranking_t *)arg)->partial != NULL)
+    {
+        partial_add(((ranking_t *)arg)->partial, key, count);
+        return;
+    }
+    if (((ranking_t *)arg)->sampled != NULL)
+    {
+        rank_sampled(key, count, (ranking_t *)arg);
+        return;
+    }
+    word = emalloc(strlen(key) + 20);
+
+    sprintf(word, "%s%d", key, count);
+    rank_insert((ranking_t *)arg, word, count);
+    efree(word);
+}
+
+/**
+ * Function:  rank_estimate
+ * ------------------------
+ * @brief  Adds one estimated key to a ranking, with the bound on its overestimate.
+ *
+ * @param key The subject column (including its trailing comma).
+ * @param estimate The estimated statistic for the subject.
+ * @param error How far above the true statistic the estimate may be.
+ * @param arg The ranking_t being built.
+ *
+ */
+static void rank_estimate(char *key, int estimate, int error, void *arg)
+{
+    char *word = emalloc(strlen(key) + 40);
+
+    sprintf(word, "%s%d,%d", key, estimate, error);
+    rank_insert((ranking_t *)arg, word, estimate);
+    efree(word);
+}
+
+/**
+ * Function:  compare_rolled
+ * -------------------------
+ * @brief  qsort() comparator putting rolled-up members in strcmp() order of their subjects.
+ *
+ */
+static int compare_rolled(const void *a, const void *b)
+{
+    return strcmp(((const rolled_t *)a)->key, ((const rolled_t *)b)->key);
+}
+
+/**
+ * Function:  rank_members
+ * -----------------------
+ * @brief  Ranks counted members by the subjects they are printed as.
+ *
+ * Each member's subject is built once here, however many routes it had.
+ * Members are ranked in strcmp() order of their subjects, as the
+ * string-keyed table hands them over, and members printed as the same
+ * subject are counted together, so the answer is the one a scan of
+ * subjects gives.
+ *
+ * @param ds The dataset.
+ * @param nmembers The number of members.
+ * @param ids The string ids of the members, width per member.
+ * @param width The number of ids per member.
+ * @param totals The routes of each member (members with none are skipped).
+ * @param subject Builds the subject column of a member.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void rank_members(const dataset_t *ds, size_t nmembers, const uint32_t *ids, int width, const long *totals,
+                         member_fn subject, ranking_t *ranking)
+{
+    char key[MAX_KEY_LENGTH];
+    rolled_t *rows = (rolled_t *)emalloc((nmembers + 1) * sizeof(rolled_t));
+    size_t i, j, m, n = 0;
+    long count;
+
+    for (m = 0; m < nmembers; m++)
+    {
+        if (totals[m] > 0)
+        {
+            subject(key, ds, ids + m * width);
+            rows[n].key = estrdup(MEM_NODE_STRINGS, key);
+            rows[n++].count = totals[m];
+        }
+    }
+    qsort(rows, n, sizeof(rolled_t), compare_rolled);
+
+    for (i = 0; i < n; i = j)
+    {
+        for (j = i, count = 0; j < n && strcmp(rows[j].key, rows[i].key) == 0; j++)
+        {
+            count += rows[j].count;
+        }
+        rank_node(rows[i].key, (int)count, ranking);
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        efree(rows[i].key);
+    }
+    efree(rows);
+}
+
+/**
+ * Function:  rank_rollup
+ * ----------------------
+ * @brief  Ranks the members of a cube dimension by their routes over the cells a filter keeps.
+ *
+ * @param ds The dataset (with its cube).
+ * @param by The dimension to rank.
+ * @param keep The filter (see cube_rollup()).
+ * @param subject Builds the subject column of a member.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void rank_rollup(const dataset_t *ds, dim_t by, const unsigned char *keep[DIM_COUNT], member_fn subject,
+                        ranking_t *ranking)
+{
+    const cube_t *cube = ds->cube;
+    long *totals = (long *)emalloc((cube->nmembers[by] + 1) * sizeof(long));
+
+    cube_rollup(cube, by, keep, totals);
+    rank_members(ds, cube->nmembers[by], cube->members[by], cube->width[by], totals, subject, ranking);
+    efree(totals);
+}
+
+/**
+ * Function:  tally_init
+ * ---------------------
+ * @brief  Prepares the counting of a question's subjects.
+ *
+ * With approx_counters the subjects go into a Space-Saving summary of fixed
+ * size instead of the exact table. Summaries can only find the most
+ * frequent subjects, so questions ranking the least frequent ones stay exact.
+ * With a memory_limit the subjects go into the table that spills to disk;
+ * otherwise the members are counted by their ids.
+ *
+ * @param tally The tally to prepare.
+ * @param ranking The ranking the tally will be finished into.
+ * @param query The query being answered.
+ * @param ds The dataset the members' ids refer to.
+ * @param width The number of ids per member.
+ * @param subject Builds the subject column of a member.
+ *
+ */
+static void tally_init(tally_t *tally, ranking_t *ranking, const rm_query_t *query, const dataset_t *ds, int width,
+                       member_fn subject)
+{
+    tally->ds = ds;
+    tally->subject = subject;
+    tally->by_id = 0;
+    tally->sketch = NULL;
+    ranking->header = "subject,statistic";
+
+    if (query->approx_counters > 0 && ranking->order == DECENDING)
+    {
+        tally->sketch = ss_new(query->approx_counters, query->count_min ? 8 * query->approx_counters : 0);
+        ranking->header = "subject,statistic,error";
+        return;
+    }
+    if (query->approx_counters > 0)
+    {
+        fprintf(stderr, "--APPROX only applies to most-frequent rankings; counting exactly\n");
+    }
+    if (query->memory_limit == 0)
+    {
+        idmap_init(&tally->members, width, 1024);
+        tally->by_id = 1;
+        return;
+    }
+    agg_init(&tally->exact, query->memory_limit);
+}
+
+/**
+ * Function:  tally_add
+ * --------------------
+ * @brief  Counts one occurrence of a member.
+ *
+ * @param tally The tally to count into.
+ * @param ids The string ids of the member.
+ *
+ */
+static void tally_add(tally_t *tally, const uint32_t *ids)
+{
+    char key[MAX_KEY_LENGTH];
+
+    if (tally->by_id)
+    {
+        idmap_add(&tally->members, ids);
+        return;
+    }
+    tally->subject(key, tally->ds, ids);
+    if (tally->sketch != NULL)
+    {
+        ss_add(tally->sketch, key);
+    }
+    else
+    {
+        agg_add(&tally->exact, key);
+    }
+}
+
+/**
+ * Function:  tally_chunk
+ * ----------------------
+ * @brief  Pool task counting the members of a run of routes by id.
+ *
+ * @param arg The tally_job_t, whose map is initialised.
+ *
+ */
+static void tally_chunk(void *arg)
+{
+    tally_job_t *job = (tally_job_t *)arg;
+    uint32_t ids[4];
+    size_t r;
+
+    for (r = job->first; r < job->last; r++)
+    {
+        if (job->member(job->ds, r, job->arg, ids))
+        {
+            idmap_add(&job->members, ids);
+        }
+    }
+}
+
+/**
+ * Function:  tally_routes
+ * -----------------------
+ * @brief  Counts the member of every route into a tally.
+ *
+ * Counted by id, the runs of ROUTE_CHUNK routes are counted side by side,
+ * each into a map of its own, and the maps merged in route order, so the
+ * members are numbered (and ties ranked) as in a single pass. Subjects
+ * counted into a sketch or the memory-limited table are counted in one pass.
+ *
+ * @param tally The tally to count into.
+ * @param member Reads the member of a route.
+ * @param arg The argument passed through to member.
+ *
+ */
+static void tally_routes(tally_t *tally, route_fn member, const void *arg)
+{
+    const dataset_t *ds = tally->ds;
+    size_t njobs = ds->nroutes / ROUTE_CHUNK + 1;
+    tally_job_t *jobs;
+    uint32_t ids[4];
+    pool_t *pool;
+    size_t j, r;
+
+    if (!tally->by_id || njobs == 1)
+    {
+        for (r = 0; r < ds->nroutes; r++)
+        {
+            if (member(ds, r, arg, ids))
+            {
+                tally_add(tally, ids);
+            }
+        }
+        return;
+    }
+
+    jobs = (tally_job_t *)emalloc(njobs * sizeof(tally_job_t));
+    pool = pool_new(pool_default_workers() < (int)njobs ? pool_default_workers() : (int)njobs);
+    for (j = 0; j < njobs; j++)
+    {
+        jobs[j].ds = ds;
+        jobs[j].member = member;
+        jobs[j].arg = arg;
+        jobs[j].first = j * ROUTE_CHUNK;
+        jobs[j].last = j + 1 < njobs ? (j + 1) * ROUTE_CHUNK : ds->nroutes;
+        idmap_init(&jobs[j].members, tally->members.width, 1024);
+        pool_submit(pool, tally_chunk, &jobs[j]);
+    }
+    pool_free(pool);
+
+    // the first run's map becomes the tally's, and the others are merged into it in order
+    idmap_free(&tally->members);
+    tally->members = jobs[0].members;
+    for (j = 1; j < njobs; j++)
+    {
+        idmap_merge(&tally->members, &jobs[j].members);
+        idmap_free(&jobs[j].members);
+    }
+    efree(jobs);
+}
+
+/**
+ * Function:  tally_finish
+ * -----------------------
+ * @brief  Ranks every counted subject and releases the tally.
+ *
+ * @param tally The tally to finish.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void tally_finish(tally_t *tally, ranking_t *ranking)
+{
+    if (tally->by_id)
+    {
+        rank_members(tally->ds, tally->members.nmembers, tally->members.ids, tally->members.width,
+                     tally->members.counts, tally->subject, ranking);
+        idmap_free(&tally->members);
+    }
+    else if (tally->sketch != NULL)
+    {
+        ss_report(tally->sketch, rank_estimate, ranking);
+        ss_free(tally->sketch);
+        tally->sketch = NULL;
+    }
+    else
+    {
+        agg_finish(&tally->exact, rank_node, ranking);
+    }
+}
+
+/**
+ * Function:  airline_subject
+ * --------------------------
+ * @brief  member_fn for airlines, as question 1 prints them.
+ *
+ */
+static void airline_subject(char *key, const dataset_t *ds, const uint32_t *ids)
+{
+    sprintf(key, "%s (%s),", dataset_string(ds, ids[0]), dataset_string(ds, ids[1]));
+}
+
+/**
+ * Function:  country_subject
+ * --------------------------
+ * @brief  member_fn for countries, as question 2 prints them.
+ *
+ */
+static void country_subject(char *key, const dataset_t *ds, const uint32_t *ids)
+{
+    unquote(key, dataset_string(ds, ids[0]));
+    strcat(key, ",");
+}
+
+/**
+ * Function:  airport_subject
+ * --------------------------
+ * @brief  member_fn for destination airports, as question 3 prints them.
+ *
+ */
+static void airport_subject(char *key, const dataset_t *ds, const uint32_t *ids)
+{
+    sprintf(key, "\"%s (%s), %s, %s\",", dataset_string(ds, ids[0]), dataset_string(ds, ids[1]),
+            dataset_string(ds, ids[2]), dataset_string(ds, ids[3]));
+}
+
+/**
+ * Function:  airline_member
+ * -------------------------
+ * @brief  route_fn for question 1: the airline of a route into the country whose string id arg points to.
+ *
+ */
+static int airline_member(const dataset_t *ds, size_t r, const void *arg, uint32_t *ids)
+{
+    if (ds->columns[FIELD_TO_COUNTRY][r] != *(const uint32_t *)arg)
+    {
+        return 0;
+    }
+    ids[0] = ds->columns[FIELD_AIRLINE_NAME][r];
+    ids[1] = ds->columns[FIELD_AIRLINE_ICAO][r];
+    return 1;
+}
+
+/**
+ * Function:  country_member
+ * -------------------------
+ * @brief  route_fn for question 2: the destination country of a route.
+ *
+ */
+static int country_member(const dataset_t *ds, size_t r, const void *arg, uint32_t *ids)
+{
+    (void)arg;
+    ids[0] = ds->columns[FIELD_TO_COUNTRY][r];
+    return 1;
+}
+
+/**
+ * Function:  airport_member
+ * -------------------------
+ * @brief  route_fn for question 3: the destination airport of a route.
+ *
+ */
+static int airport_member(const dataset_t *ds, size_t r, const void *arg, uint32_t *ids)
+{
+    (void)arg;
+    ids[0] = ds->columns[FIELD_TO_NAME][r];
+    ids[1] = ds->columns[FIELD_TO_ICAO][r];
+    ids[2] = ds->columns[FIELD_TO_CITY][r];
+    ids[3] = ds->columns[FIELD_TO_COUNTRY][r];
+    return 1;
+}
+
+/**
+ * Function:  question_one
+ * -----------------------
+ * @brief  Ranks the airlines with the most routes into Canada, or the query's country.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_one(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    const char *country = query->country != NULL ? query->country : RM_DEFAULT_COUNTRY;
+    uint32_t country_id = find_country(ds, country);
+    tally_t airlines;
+
+    ranking->order = DECENDING;
+    if (ds->cube != NULL && query->approx_counters == 0)
+    {
+        const unsigned char *keep[DIM_COUNT] = {NULL, NULL, NULL, NULL};
+        unsigned char *canada = (unsigned char *)emalloc(ds->cube->nmembers[DIM_TO_COUNTRY] + 1);
+        uint32_t m;
+
+        for (m = 0; m < ds->cube->nmembers[DIM_TO_COUNTRY]; m++)
+        {
+            canada[m] = *cube_member(ds->cube, DIM_TO_COUNTRY, m) == country_id;
+        }
+        keep[DIM_TO_COUNTRY] = canada;
+        ranking->header = "subject,statistic";
+        rank_rollup(ds, DIM_AIRLINE, keep, airline_subject, ranking);
+        efree(canada);
+        return;
+    }
+    tally_init(&airlines, ranking, query, ds, 2, airline_subject);
+    tally_routes(&airlines, airline_member, &country_id);
+    tally_finish(&airlines, ranking);
+}
+
+/**
+ * Function:  by_country
+ * ---------------------
+ * @brief  qsort() comparator putting countries in strcmp() order of their names.
+ *
+ */
+static int by_country(const void *a, const void *b)
+{
+    return strcmp(((const rolled_t *)a)->key, ((const rolled_t *)b)->key);
+}
+
+/**
+ * Function:  every_country
+ * ------------------------
+ * @brief  Ranks the airlines with the most routes into each destination country, from one count matrix.
+ *
+ * Each country gets question 1's top N, in strcmp() order of the countries,
+ * with the country as a leading column.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param column The header of the country column.
+ * @param fn The function called with the header and then each row, in order.
+ * @param arg The argument passed through to fn.
+ *
+ */
+static void every_country(const dataset_t *ds, const rm_query_t *query, const char *column, rm_row_fn fn, void *arg)
+{
+    char country[MAX_VALUE_LENGTH];
+    char line[MAX_KEY_LENGTH + MAX_VALUE_LENGTH + 4];
+    rolled_t *countries;
+    matrix_t matrix;
+    ranking_t ranking;
+    const uint32_t *row;
+    uint32_t c, a;
+    node_t *curr;
+
+    matrix_build(&matrix, ds);
+
+    // count holds the country's row of the matrix
+    countries = (rolled_t *)emalloc((matrix.ncountries + 1) * sizeof(rolled_t));
+    for (c = 0; c < matrix.ncountries; c++)
+    {
+        countries[c].key = estrdup(MEM_NODE_STRINGS, unquote(country, dataset_string(ds, matrix.countries[c])));
+        countries[c].count = c;
+    }
+    qsort(countries, matrix.ncountries, sizeof(rolled_t), by_country);
+
+    sprintf(line, "%s,subject,statistic", column);
+    fn(line, arg);
+    for (c = 0; c < matrix.ncountries; c++)
+    {
+        ranking.list = NULL;
+        ranking.limit = query->n;
+        ranking.partial = NULL;
+        ranking.sampled = NULL;
+        ranking.order = DECENDING;
+        row = matrix_row(&matrix, (uint32_t)countries[c].count);
+        for (a = 0; a < matrix.nairlines; a++)
+        {
+            if (row[a] > 0)
+            {
+                rank_node(matrix.airlines[a], (int)row[a], &ranking);
+            }
+        }
+        for (curr = ranking.list; curr != NULL; curr = curr->next)
+        {
+            sprintf(line, strchr(countries[c].key, ',') != NULL ? "\"%s\",%s" : "%s,%s", countries[c].key, curr->word);
+            fn(line, arg);
+        }
+        free_list(ranking.list);
+        efree(countries[c].key);
+    }
+    efree(countries);
+    matrix_free(&matrix);
+}
+
+/**
+ * @brief The route fields a question counts, or a ranking is partitioned by, and how they are printed.
+ */
+typedef struct
+{
+    const char *name;
+    int width;
+    field_t fields[4];
+    member_fn subject;
+} member_def_t;
+
+// indexed by question (1 to 3)
+static const member_def_t QUESTION_MEMBERS[] = {
+    {NULL, 0, {0}, NULL},
+    {"airline", 2, {FIELD_AIRLINE_NAME, FIELD_AIRLINE_ICAO}, airline_subject},
+    {"to_country", 1, {FIELD_TO_COUNTRY}, country_subject},
+    {"to_airport", 4, {FIELD_TO_NAME, FIELD_TO_ICAO, FIELD_TO_CITY, FIELD_TO_COUNTRY}, airport_subject}};
+
+// indexed by rm_partition_t
+static const member_def_t PARTITIONS[] = {
+    {NULL, 0, {0}, NULL},
+    {"airline", 2, {FIELD_AIRLINE_NAME, FIELD_AIRLINE_ICAO}, airline_subject},
+    {"from_country", 1, {FIELD_FROM_COUNTRY}, country_subject},
+    {"to_country", 1, {FIELD_TO_COUNTRY}, country_subject}};
+
+/**
+ * @brief The routes of one member within one partition.
+ */
+typedef struct
+{
+    uint32_t part;
+    uint32_t member;
+    long count;
+} pair_t;
+
+/**
+ * Function:  rm_partition_by
+ * --------------------------
+ * @brief  Looks up a partition by the name route_manager's --PARTITION takes.
+ *
+ * @param name airline, from_country or to_country.
+ *
+ * @return int The rm_partition_t, or -1 if there is no such partition.
+ *
+ */
+int rm_partition_by(const char *name)
+{
+    int p;
+
+    for (p = RM_BY_AIRLINE; p <= RM_BY_TO_COUNTRY; p++)
+    {
+        if (strcmp(name, PARTITIONS[p].name) == 0)
+        {
+            return p;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Function:  partition_fields
+ * ---------------------------
+ * @brief  Returns the set of fields a partition reads.
+ *
+ * @param partition The partition.
+ *
+ * @return unsigned The fields (0 for RM_BY_NONE).
+ *
+ */
+static unsigned partition_fields(rm_partition_t partition)
+{
+    unsigned fields = 0;
+    int k;
+
+    for (k = 0; k < PARTITIONS[partition].width; k++)
+    {
+        fields |= FIELD_BIT(PARTITIONS[partition].fields[k]);
+    }
+    return fields;
+}
+
+/**
+ * Function:  rank_subjects
+ * ------------------------
+ * @brief  Builds the subject of every member of a map and numbers the distinct subjects in strcmp() order.
+ *
+ * @param ds The dataset.
+ * @param map The members.
+ * @param subject Builds the subject column of a member.
+ * @param bare Whether to drop the subjects' trailing commas (to sort them as names).
+ * @param rank Set to the number of each member's subject (map->nmembers entries).
+ * @param nsubjects Set to the number of distinct subjects.
+ *
+ * @return char** The distinct subjects in strcmp() order (efree each, then the array).
+ *
+ */
+static char **rank_subjects(const dataset_t *ds, const idmap_t *map, member_fn subject, int bare, uint32_t *rank,
+                            size_t *nsubjects)
+{
+    char key[MAX_KEY_LENGTH];
+    rolled_t *rows = (rolled_t *)emalloc((map->nmembers + 1) * sizeof(rolled_t));
+    char **subjects = (char **)emalloc((map->nmembers + 1) * sizeof(char *));
+    size_t m, n = 0;
+
+    // count holds the member's number
+    for (m = 0; m < map->nmembers; m++)
+    {
+        subject(key, ds, map->ids + m * map->width);
+        if (bare)
+        {
+            key[strlen(key) - 1] = '\0';
+        }
+        rows[m].key = estrdup(MEM_NODE_STRINGS, key);
+        rows[m].count = (long)m;
+    }
+    qsort(rows, map->nmembers, sizeof(rolled_t), compare_rolled);
+
+    for (m = 0; m < map->nmembers; m++)
+    {
+        if (n > 0 && strcmp(rows[m].key, subjects[n - 1]) == 0)
+        {
+            efree(rows[m].key);
+        }
+        else
+        {
+            subjects[n++] = rows[m].key;
+        }
+        rank[rows[m].count] = (uint32_t)(n - 1);
+    }
+    efree(rows);
+    *nsubjects = n;
+    return subjects;
+}
+
+/**
+ * Function:  compare_pairs
+ * ------------------------
+ * @brief  qsort() comparator grouping pairs by partition, then member.
+ *
+ */
+static int compare_pairs(const void *a, const void *b)
+{
+    const pair_t *x = (const pair_t *)a;
+    const pair_t *y = (const pair_t *)b;
+
+    if (x->part != y->part)
+    {
+        return x->part < y->part ? -1 : 1;
+    }
+    if (x->member != y->member)
+    {
+        return x->member < y->member ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Function:  partitioned
+ * ----------------------
+ * @brief  Ranks the members of question 1, 2 or 3 separately within each partition, from one pass over the routes.
+ *
+ * The pass counts every (partition, member) pair that occurs. Partitions
+ * and members are then numbered by the names and subjects they print as,
+ * so that equal ones are counted together as in the single ranking, and
+ * each partition's pairs are ranked into a list kept to its top N.
+ * Partitions come in strcmp() order of their names, with the partition as
+ * a leading column.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param fn The function called with the header and then each row, in order.
+ * @param arg The argument passed through to fn.
+ *
+ */
+static void partitioned(const dataset_t *ds, const rm_query_t *query, rm_row_fn fn, void *arg)
+{
+    const member_def_t *by = &PARTITIONS[query->partition];
+    const member_def_t *of = &QUESTION_MEMBERS[query->question];
+    const char *country = query->country != NULL ? query->country : RM_DEFAULT_COUNTRY;
+    int filter = query->question == 1 && strcmp(country, RM_ALL_COUNTRIES) != 0;
+    uint32_t country_id = filter ? find_country(ds, country) : 0;
+    char line[2 * MAX_KEY_LENGTH + 32];
+    const char *part;
+    idmap_t pairs, parts, members;
+    uint32_t ids[8], *part_rank, *member_rank;
+    char **part_names, **subjects;
+    size_t nparts, nsubjects, npairs, i, j, r;
+    pair_t *cells;
+    ranking_t ranking;
+    node_t *curr;
+    int k;
+
+    if (query->approx_counters > 0 || query->memory_limit > 0)
+    {
+        fprintf(stderr, "--APPROX and --MEMORY_LIMIT do not apply to partitioned rankings; counting exactly\n");
+    }
+
+    // the one pass: count each (partition, member) pair by its ids
+    idmap_init(&pairs, by->width + of->width, 1024);
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        if (filter && ds->columns[FIELD_TO_COUNTRY][r] != country_id)
+        {
+            continue;
+        }
+        for (k = 0; k < by->width; k++)
+        {
+            ids[k] = ds->columns[by->fields[k]][r];
+        }
+        for (k = 0; k < of->width; k++)
+        {
+            ids[by->width + k] = ds->columns[of->fields[k]][r];
+        }
+        idmap_add(&pairs, ids);
+    }
+
+    // number the partitions and members, then their subjects
+    npairs = pairs.nmembers;
+    cells = (pair_t *)emalloc((npairs + 1) * sizeof(pair_t));
+    idmap_init(&parts, by->width, 256);
+    idmap_init(&members, of->width, 1024);
+    for (i = 0; i < npairs; i++)
+    {
+        cells[i].part = idmap_add(&parts, pairs.ids + i * pairs.width);
+        cells[i].member = idmap_add(&members, pairs.ids + i * pairs.width + by->width);
+        cells[i].count = pairs.counts[i];
+    }
+    idmap_free(&pairs);
+    part_rank = (uint32_t *)emalloc((parts.nmembers + 1) * sizeof(uint32_t));
+    member_rank = (uint32_t *)emalloc((members.nmembers + 1) * sizeof(uint32_t));
+    part_names = rank_subjects(ds, &parts, by->subject, 1, part_rank, &nparts);
+    subjects = rank_subjects(ds, &members, of->subject, 0, member_rank, &nsubjects);
+    for (i = 0; i < npairs; i++)
+    {
+        cells[i].part = part_rank[cells[i].part];
+        cells[i].member = member_rank[cells[i].member];
+    }
+    qsort(cells, npairs, sizeof(pair_t), compare_pairs);
+
+    sprintf(line, "%s,subject,statistic", by->name);
+    fn(line, arg);
+    for (i = 0; i < npairs; i = j)
+    {
+        ranking.list = NULL;
+        ranking.limit = query->n;
+        ranking.partial = NULL;
+        ranking.sampled = NULL;
+        ranking.order = query->question == 2 ? ASCENDING : DECENDING;
+        for (j = i; j < npairs && cells[j].part == cells[i].part;)
+        {
+            long count = 0;
+            size_t m = j;
+
+            for (; j < npairs && cells[j].part == cells[m].part && cells[j].member == cells[m].member; j++)
+            {
+                count += cells[j].count;
+            }
+            rank_node(subjects[cells[m].member], (int)count, &ranking);
+        }
+
+        // the partition is quoted if it holds a comma
+        part = part_names[cells[i].part];
+        for (curr = ranking.list; curr != NULL; curr = curr->next)
+        {
+            sprintf(line, strchr(part, ',') != NULL ? "\"%s\",%s" : "%s,%s", part, curr->word);
+            fn(line, arg);
+        }
+        free_list(ranking.list);
+    }
+
+    for (i = 0; i < nparts; i++)
+    {
+        efree(part_names[i]);
+    }
+    for (i = 0; i < nsubjects; i++)
+    {
+        efree(subjects[i]);
+    }
+    efree(part_names);
+    efree(subjects);
+    efree(part_rank);
+    efree(member_rank);
+    efree(cells);
+    idmap_free(&parts);
+    idmap_free(&members);
+}
+
+/**
+ * Function:  question_two
+ * -----------------------
+ * @brief  Ranks the destination countries with the fewest routes.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_two(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    tally_t countries;
+
+    ranking->order = ASCENDING;
+    if (ds->cube != NULL && query->approx_counters == 0)
+    {
+        const unsigned char *keep[DIM_COUNT] = {NULL, NULL, NULL, NULL};
+
+        ranking->header = "subject,statistic";
+        rank_rollup(ds, DIM_TO_COUNTRY, keep, country_subject, ranking);
+        return;
+    }
+    tally_init(&countries, ranking, query, ds, 1, country_subject);
+    tally_routes(&countries, country_member, NULL);
+    tally_finish(&countries, ranking);
+}
+
+/**
+ * Function:  question_three
+ * -------------------------
+ * @brief  Ranks the destination airports with the most routes.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_three(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    tally_t airports;
+
+    ranking->order = DECENDING;
+    if (ds->cube != NULL && query->approx_counters == 0)
+    {
+        const unsigned char *keep[DIM_COUNT] = {NULL, NULL, NULL, NULL};
+
+        ranking->header = "subject,statistic";
+        rank_rollup(ds, DIM_TO_AIRPORT, keep, airport_subject, ranking);
+        return;
+    }
+    tally_init(&airports, ranking, query, ds, 4, airport_subject);
+    tally_routes(&airports, airport_member, NULL);
+    tally_finish(&airports, ranking);
+}
+
+/**
+ * Function:  partial_member
+ * -------------------------
+ * @brief  Writes one member of a distinct count to a partial file, keyed by its group and itself.
+ *
+ * @param group The group (the subject column, with its trailing comma).
+ * @param member The member of the group.
+ * @param arg The partial_t being written.
+ *
+ */
+static void partial_member(const char *group, const char *member, void *arg)
+{
+    char key[MAX_KEY_LENGTH + MAX_VALUE_LENGTH + 2];
+
+    snprintf(key, sizeof(key), "%s%c%s", group, PARTIAL_SEPARATOR, member);
+    partial_add((partial_t *)arg, key, 1);
+}
+
+/**
+ * Function:  distinct_done
+ * ------------------------
+ * @brief  Ranks every group of a distinct count, or writes its members to the ranking's partial file.
+ *
+ * @param d The distinct count to finish.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void distinct_done(distinct_t *d, ranking_t *ranking)
+{
+    if (ranking->partial != NULL)
+    {
+        distinct_members(d, partial_member, ranking->partial);
+    }
+    else
+    {
+        distinct_finish(d, rank_node, ranking);
+    }
+}
+
+/**
+ * Function:  question_four
+ * ------------------------
+ * @brief  Ranks the airlines serving the most distinct destination airports.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_four(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    char required[MAX_KEY_LENGTH];
+    distinct_t airlines;
+    size_t r;
+
+    ranking->order = DECENDING;
+    ranking->header = "subject,statistic";
+    distinct_init(&airlines, query->hll_precision);
+
+    if (ds->cube != NULL)
+    {
+        // cells come grouped by airline, and each holds a destination airport
+        const cube_t *cube = ds->cube;
+        size_t c;
+
+        for (c = 0; c < cube->ncells; c++)
+        {
+            if (c == 0 || cube->cells[c].coords[DIM_AIRLINE] != cube->cells[c - 1].coords[DIM_AIRLINE])
+            {
+                airline_subject(required, ds, cube_member(cube, DIM_AIRLINE, cube->cells[c].coords[DIM_AIRLINE]));
+            }
+            distinct_add(&airlines, required,
+                         dataset_string(ds, cube_member(cube, DIM_TO_AIRPORT, cube->cells[c].coords[DIM_TO_AIRPORT])[1]));
+        }
+        distinct_done(&airlines, ranking);
+        return;
+    }
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        sprintf(required, "%s (%s),", dataset_value(ds, FIELD_AIRLINE_NAME, r),
+                dataset_value(ds, FIELD_AIRLINE_ICAO, r));
+        distinct_add(&airlines, required, dataset_value(ds, FIELD_TO_ICAO, r));
+    }
+    distinct_done(&airlines, ranking);
+}
+
+/**
+ * Function:  question_five
+ * ------------------------
+ * @brief  Ranks the destination countries reached from the most distinct source countries.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_five(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    char required[MAX_KEY_LENGTH];
+    char source[MAX_VALUE_LENGTH];
+    distinct_t countries;
+    size_t r;
+
+    ranking->order = DECENDING;
+    ranking->header = "subject,statistic";
+    distinct_init(&countries, query->hll_precision);
+
+    if (ds->cube != NULL)
+    {
+        const cube_t *cube = ds->cube;
+        size_t c;
+
+        for (c = 0; c < cube->ncells; c++)
+        {
+            country_subject(required, ds, cube_member(cube, DIM_TO_COUNTRY, cube->cells[c].coords[DIM_TO_COUNTRY]));
+            unquote(source, dataset_string(ds, *cube_member(cube, DIM_FROM_COUNTRY, cube->cells[c].coords[DIM_FROM_COUNTRY])));
+            distinct_add(&countries, required, source);
+        }
+        distinct_done(&countries, ranking);
+        return;
+    }
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        unquote(required, dataset_value(ds, FIELD_TO_COUNTRY, r));
+        strcat(required, ",");
+        distinct_add(&countries, required, unquote(source, dataset_value(ds, FIELD_FROM_COUNTRY, r)));
+    }
+    distinct_done(&countries, ranking);
+}
+
+/**
+ * Function:  parse_altitude
+ * -------------------------
+ * @brief  Reads an altitude as the file has it, quoted ('17.0') or not.
+ *
+ * @param value The raw value.
+ *
+ * @return double The altitude, or NAN if the value is not a number.
+ *
+ */
+static double parse_altitude(const char *value)
+{
+    char quote = value[0] == '\'' || value[0] == '"' ? value[0] : '\0';
+    const char *start = quote != '\0' ? value + 1 : value;
+    char *end;
+    double altitude = strtod(start, &end);
+
+    if (end == start || *end != quote || (quote != '\0' && end[1] != '\0'))
+    {
+        return NAN;
+    }
+    return altitude;
+}
+
+/**
+ * Function:  sketch_altitudes
+ * ---------------------------
+ * @brief  Pool task sketching the altitude gain of each route of a run into its destination country's sketch.
+ *
+ * @param arg The altitude_job_t.
+ *
+ */
+static void sketch_altitudes(void *arg)
+{
+    altitude_job_t *job = (altitude_job_t *)arg;
+    const uint32_t *to = job->ds->columns[FIELD_TO_ALTITUDE];
+    double altitude, from;
+    size_t r;
+    int g;
+
+    job->sketches = (kll_t *)emalloc((job->ngroups + 1) * sizeof(kll_t));
+    for (g = 0; g < job->ngroups; g++)
+    {
+        kll_init(&job->sketches[g], job->k);
+    }
+    for (r = job->first; r < job->last; r++)
+    {
+        altitude = job->altitudes[to[r]];
+        from = job->altitudes[job->ds->columns[FIELD_FROM_ALTITUDE][r]];
+        if (!isnan(altitude) && !isnan(from))
+        {
+            kll_add(&job->sketches[job->groups[job->ds->columns[FIELD_TO_COUNTRY][r]]], altitude - from);
+        }
+    }
+}
+
+/**
+ * Function:  sketch_routes
+ * ------------------------
+ * @brief  Sketches the altitude gains of every route, splitting the routes between threads and merging their sketches.
+ *
+ * Every string is read as an altitude once, up front; the runs of
+ * ROUTE_CHUNK routes are then sketched side by side and their sketches
+ * merged in route order, so the answer does not depend on the threads.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered (kll_k sets the size of the sketches).
+ * @param groups The group of each destination country.
+ * @param ngroups The number of groups.
+ *
+ * @return kll_t* The sketch of each group (kll_free() each, then efree()).
+ *
+ */
+static kll_t *sketch_routes(const dataset_t *ds, const rm_query_t *query, const uint32_t *groups, int ngroups)
+{
+    double *altitudes = (double *)emalloc_as(MEM_INDEXES, (size_t)ds->nstrings * sizeof(double));
+    size_t njobs = ds->nroutes / ROUTE_CHUNK + 1;
+    altitude_job_t *jobs = (altitude_job_t *)emalloc(njobs * sizeof(altitude_job_t));
+    kll_t *sketches;
+    pool_t *pool = NULL;
+    uint32_t id;
+    size_t j;
+    int g;
+
+    for (id = 0; id < ds->nstrings; id++)
+    {
+        altitudes[id] = parse_altitude(dataset_string(ds, id));
+    }
+    if (njobs > 1)
+    {
+        pool = pool_new(pool_default_workers() < (int)njobs ? pool_default_workers() : (int)njobs);
+    }
+    for (j = 0; j < njobs; j++)
+    {
+        jobs[j].ds = ds;
+        jobs[j].altitudes = altitudes;
+        jobs[j].groups = groups;
+        jobs[j].first = j * ROUTE_CHUNK;
+        jobs[j].last = j + 1 < njobs ? (j + 1) * ROUTE_CHUNK : ds->nroutes;
+        jobs[j].ngroups = ngroups;
+        jobs[j].k = query->kll_k;
+        if (pool != NULL)
+        {
+            pool_submit(pool, sketch_altitudes, &jobs[j]);
+        }
+        else
+        {
+            sketch_altitudes(&jobs[j]);
+        }
+    }
+    if (pool != NULL)
+    {
+        pool_free(pool);
+    }
+
+    sketches = jobs[0].sketches;
+    for (j = 1; j < njobs; j++)
+    {
+        for (g = 0; g < ngroups; g++)
+        {
+            kll_merge(&sketches[g], &jobs[j].sketches[g]);
+            kll_free(&jobs[j].sketches[g]);
+        }
+        efree(jobs[j].sketches);
+    }
+    efree(jobs);
+    efree(altitudes);
+    return sketches;
+}
+
+/**
+ * Function:  question_six
+ * -----------------------
+ * @brief  Ranks the destination countries with the most routes of known altitudes, with the
+ * median, 90th and 99th percentile of the altitude gained flying into them (destination minus source).
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_six(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    static const double RANKS[3] = {0.5, 0.9, 0.99};
+    char key[MAX_VALUE_LENGTH + 1];
+    char word[MAX_VALUE_LENGTH + 80];
+    uint32_t *groups = (uint32_t *)emalloc_as(MEM_INDEXES, ((size_t)ds->nstrings + 1) * sizeof(uint32_t));
+    rolled_t *countries = (rolled_t *)emalloc(sizeof(rolled_t));
+    kll_t *sketches;
+    double gains[3];
+    int ngroups = 0;
+    uint32_t id;
+    size_t r;
+    int c;
+
+    ranking->order = DECENDING;
+    ranking->header = "subject,statistic,p50,p90,p99";
+
+    // each destination country is a group, numbered as it first appears
+    memset(groups, 0xFF, (size_t)ds->nstrings * sizeof(uint32_t));
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        id = ds->columns[FIELD_TO_COUNTRY][r];
+        if (groups[id] == UINT32_MAX)
+        {
+            groups[id] = ngroups++;
+            countries = (rolled_t *)erealloc(MEM_SCRATCH, countries, ngroups * sizeof(rolled_t));
+            countries[ngroups - 1].key = estrdup(MEM_NODE_STRINGS, unquote(key, dataset_string(ds, id)));
+            countries[ngroups - 1].count = ngroups - 1;
+        }
+    }
+    sketches = sketch_routes(ds, query, groups, ngroups);
+
+    // countries are ranked in strcmp() order so that ties keep it
+    qsort(countries, ngroups, sizeof(rolled_t), by_country);
+    for (c = 0; c < ngroups; c++)
+    {
+        const kll_t *sketch = &sketches[countries[c].count];
+
+        if (sketch->n > 0)
+        {
+            kll_quantiles(sketch, RANKS, 3, gains);
+            sprintf(word, strchr(countries[c].key, ',') != NULL ? "\"%s\",%lu,%.1f,%.1f,%.1f" : "%s,%lu,%.1f,%.1f,%.1f",
+                    countries[c].key, (unsigned long)sketch->n, gains[0], gains[1], gains[2]);
+            rank_insert(ranking, word, (int)sketch->n);
+        }
+        efree(countries[c].key);
+    }
+    for (c = 0; c < ngroups; c++)
+    {
+        kll_free(&sketches[c]);
+    }
+    efree(sketches);
+    efree(countries);
+    efree(groups);
+}
+
+/**
+ * Function:  question_seven
+ * -------------------------
+ * @brief  Counts the routes by destination altitude in N equal bins from the lowest destination to the highest.
+ *
+ * Rows are the bins in increasing altitude, each with its lower and upper
+ * edge; the last bin includes its upper edge. The routes are counted by
+ * destination altitude string first, so each distinct altitude is read
+ * once and the bins, filled from those counts, are exact.
+ *
+ * @param ds The dataset.
+ * @param query The query being answered.
+ * @param ranking The ranking to fill.
+ *
+ */
+static void question_seven(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    const uint32_t *to = ds->columns[FIELD_TO_ALTITUDE];
+    uint64_t *routes = (uint64_t *)emalloc_as(MEM_INDEXES, (size_t)ds->nstrings * sizeof(uint64_t));
+    double *altitudes = (double *)emalloc_as(MEM_INDEXES, (size_t)ds->nstrings * sizeof(double));
+    double lower = INFINITY, upper = -INFINITY, width, bin;
+    char word[96];
+    uint64_t *counts;
+    uint32_t id;
+    size_t r;
+    int nbins, b;
+
+    ranking->header = "lower,upper,statistic";
+    memset(routes, 0, (size_t)ds->nstrings * sizeof(uint64_t));
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        routes[to[r]]++;
+    }
+    for (id = 0; id < ds->nstrings; id++)
+    {
+        altitudes[id] = routes[id] > 0 ? parse_altitude(dataset_string(ds, id)) : NAN;
+        if (!isnan(altitudes[id]))
+        {
+            lower = altitudes[id] < lower ? altitudes[id] : lower;
+            upper = altitudes[id] > upper ? altitudes[id] : upper;
+        }
+    }
+
+    if (lower <= upper && query->n > 0)
+    {
+        nbins = upper > lower ? query->n : 1;
+        width = (upper - lower) / nbins;
+        counts = (uint64_t *)emalloc(nbins * sizeof(uint64_t));
+        memset(counts, 0, nbins * sizeof(uint64_t));
+        for (id = 0; id < ds->nstrings; id++)
+        {
+            if (!isnan(altitudes[id]))
+            {
+                bin = width > 0 ? floor((altitudes[id] - lower) / width) : 0;
+                b = bin >= nbins ? nbins - 1 : (int)bin;
+                counts[b] += routes[id];
+            }
+        }
+        for (b = nbins - 1; b >= 0; b--)
+        {
+            sprintf(word, "%.1f,%.1f,%lu", lower + b * width, b == nbins - 1 ? upper : lower + (b + 1) * width,
+                    (unsigned long)counts[b]);
+            ranking->list = add_front(ranking->list, new_node(word, (int)counts[b]));
+        }
+        efree(counts);
+    }
+    efree(altitudes);
+    efree(routes);
+}
+
+/**
+ * Function:  ask
+ * --------------
+ * @brief  Answers one question into a ranking.
+ *
+ * @param ds The dataset.
+ * @param query The question to answer.
+ * @param ranking The ranking to fill.
+ *
+ * @return int 0: No errors; 1: The question does not exist.
+ *
+ */
+static int ask(const dataset_t *ds, const rm_query_t *query, ranking_t *ranking)
+{
+    switch (query->question)
+    {
+    case 1:
+        question_one(ds, query, ranking);
+        break;
+    case 2:
+        question_two(ds, query, ranking);
+        break;
+    case 3:
+        question_three(ds, query, ranking);
+        break;
+    case 4:
+        question_four(ds, query, ranking);
+        break;
+    case 5:
+        question_five(ds, query, ranking);
+        break;
+    case 6:
+        question_six(ds, query, ranking);
+        break;
+    case 7:
+        question_seven(ds, query, ranking);
+        break;
+    default:
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function:  report
+ * -----------------
+ * @brief  Passes the header and the rows of a finished ranking to a callback, and releases the ranking.
+ *
+ * @param ranking The finished ranking.
+ * @param fn The function called with the header and then each row, in order.
+ * @param arg The argument passed through to fn.
+ *
+ */
+static void report(ranking_t *ranking, rm_row_fn fn, void *arg)
+{
+    node_t *curr;
+
+    fn(ranking->header, arg);
+    for (curr = ranking->list; curr != NULL; curr = curr->next)
+    {
+        fn(curr->word, arg);
+    }
+    free_list(ranking->list);
+    ranking->list = NULL;
+}
+
+/**
+ * Function:  rm_query
+ * -------------------
+ * @brief  Answers one question, passing the CSV lines of the answer to a callback.
+ *
+ * @param ds The dataset.
+ * @param query The question to answer.
+ * @param fn The function called with the header and then each row, in order.
+ * @param arg The argument passed through to fn.
+ *
+ * @return int 0: No errors; 1: The question does not exist, its fields were not loaded, or it cannot be answered from a sample.
+ *
+ */
+int rm_query(const rm_dataset_t *ds, const rm_query_t *query, rm_row_fn fn, void *arg)
+{
+    ranking_t ranking = {NULL, query->n, DECENDING, NULL, NULL, NULL};
+    unsigned fields = question_fields(query->question);
+
+    if (query->partition < RM_BY_NONE || query->partition > RM_BY_TO_COUNTRY ||
+        (query->partition != RM_BY_NONE && query->question > 3))
+    {
+        return 1;
+    }
+
+    // a sample is scaled up only for the plain counts of questions 1 to 3
+    if (ds->sample > 0 && (query->question > 3 || query->partition != RM_BY_NONE || query->approx_counters > 0 ||
+                           (query->country != NULL && strcmp(query->country, RM_ALL_COUNTRIES) == 0)))
+    {
+        return 1;
+    }
+    fields |= partition_fields(query->partition);
+    if (fields == 0 || (ds->fields & fields) != fields)
+    {
+        return 1;
+    }
+
+    // question 1 per destination country reads the airline by country matrix
+    if (query->question == 1 && query->partition == RM_BY_TO_COUNTRY)
+    {
+        every_country(ds, query, PARTITIONS[RM_BY_TO_COUNTRY].name, fn, arg);
+        return 0;
+    }
+    if (query->partition != RM_BY_NONE)
+    {
+        partitioned(ds, query, fn, arg);
+        return 0;
+    }
+    if (query->question == 1 && query->country != NULL && strcmp(query->country, RM_ALL_COUNTRIES) == 0)
+    {
+        every_country(ds, query, "country", fn, arg);
+        return 0;
+    }
+
+    if (ds->sample > 0)
+    {
+        ranking.sampled = ds;
+    }
+    if (ask(ds, query, &ranking) != 0)
+    {
+        return 1;
+    }
+    if (ranking.sampled != NULL)
+    {
+        ranking.header = "subject,statistic,margin";
+    }
+    report(&ranking, fn, arg);
+    return 0;
+}
+
+/**
+ * Function:  tally_window
+ * -----------------------
+ * @brief  dataset_window_fn counting the members of one window of a streamed file into its question's tally.
+ *
+ * @param ds The table holding the window's routes.
+ * @param arg The stream_t.
+ *
+ */
+static void tally_window(const dataset_t *ds, void *arg)
+{
+    stream_t *stream = (stream_t *)arg;
+    uint32_t ids[4];
+    size_t r;
+
+    // string ids are stable once given, so question 1's country is looked up until it first appears
+    if (stream->country != NULL && stream->country_id == UINT32_MAX)
+    {
+        stream->country_id = find_country(ds, stream->country);
+        stream->country_id = stream->country_id < ds->nstrings ? stream->country_id : UINT32_MAX;
+    }
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        if (stream->member(ds, r, &stream->country_id, ids))
+        {
+            tally_add(&stream->tally, ids);
+        }
+    }
+}
+
+/**
+ * Function:  rm_query_stream
+ * --------------------------
+ * @brief  Answers one of the questions 1 to 3 straight from a route file, counting its routes as they are read.
+ *
+ * Meant for one-shot reads of standard input: the routes are parsed
+ * ROUTE_CHUNK at a time and counted, then dropped, so only their distinct
+ * values and the counts are held, however many routes there are. Partitions
+ * and question 1 for RM_ALL_COUNTRIES need every route and are refused.
+ *
+ * @param path The route file, or "-" for standard input.
+ * @param query The question to answer.
+ * @param fn The function called with the header and then each row, in order (only if the whole file was read).
+ * @param arg The argument passed through to fn.
+ *
+ * @return int 0: No errors; 1: The question cannot be streamed, or the file could not be read.
+ *
+ */
+int rm_query_stream(const char *path, const rm_query_t *query, rm_row_fn fn, void *arg)
+{
+    static const route_fn MEMBERS[] = {NULL, airline_member, country_member, airport_member};
+    ranking_t ranking = {NULL, query->n, DECENDING, NULL, NULL, NULL};
+    const member_def_t *def;
+    dataset_t *ds;
+    stream_t stream;
+    int failed;
+
+    if (query->question < 1 || query->question > 3 || query->partition != RM_BY_NONE ||
+        (query->country != NULL && strcmp(query->country, RM_ALL_COUNTRIES) == 0))
+    {
+        return 1;
+    }
+    def = &QUESTION_MEMBERS[query->question];
+    ds = (dataset_t *)emalloc_as(MEM_ROUTE_FIELDS, sizeof(dataset_t));
+    ranking.order = query->question == 2 ? ASCENDING : DECENDING;
+    tally_init(&stream.tally, &ranking, query, ds, def->width, def->subject);
+    stream.member = MEMBERS[query->question];
+    stream.country = NULL;
+    stream.country_id = UINT32_MAX;
+    if (query->question == 1)
+    {
+        stream.country = query->country != NULL ? query->country : RM_DEFAULT_COUNTRY;
+    }
+
+    failed = dataset_stream(ds, path, question_fields(query->question), ROUTE_CHUNK, tally_window, &stream);
+    if (failed && stream.tally.by_id)
+    {
+        // the members' ids point into the strings the failed load has freed
+        idmap_free(&stream.tally.members);
+    }
+    else
+    {
+        tally_finish(&stream.tally, &ranking);
+    }
+    if (failed)
+    {
+        free_list(ranking.list);
+    }
+    else
+    {
+        report(&ranking, fn, arg);
+    }
+    rm_close(ds);
+    return failed;
+}
+
+/**
+ * Function:  partial_signature
+ * ----------------------------
+ * @brief  Describes the question a partial file answers, so only files answering the same one are merged.
+ *
+ * @param signature Where to write it (PARTIAL_MAX_SIGNATURE bytes).
+ * @param query The question.
+ *
+ */
+static void partial_signature(char *signature, const rm_query_t *query)
+{
+    const char *country = query->country != NULL ? query->country : RM_DEFAULT_COUNTRY;
+
+    if (query->question == 1)
+    {
+        snprintf(signature, PARTIAL_MAX_SIGNATURE, "question 1 into %s", country);
+    }
+    else
+    {
+        snprintf(signature, PARTIAL_MAX_SIGNATURE, "question %d", query->question);
+    }
+}
+
+/**
+ * Function:  rm_partial
+ * ---------------------
+ * @brief  Writes the grouped counts of a question, before ranking, to a partial file for rm_merge().
+ *
+ * The counts are always exact and cover every subject, whatever query->n
+ * is, so partials of disjoint inputs merge into the answer for their union.
+ * Questions 1 to 3 store each subject with its count; questions 4 and 5
+ * store each subject with each of its distinct members.
+ *
+ * @param ds The dataset (not sampled).
+ * @param query The question to count (not partitioned, approximate or for every country).
+ * @param path Where to write the partial file.
+ *
+ * @return int 0: No errors; 1: The question cannot be stored, or the file could not be written.
+ *
+ */
+int rm_partial(const rm_dataset_t *ds, const rm_query_t *query, const char *path)
+{
+    ranking_t ranking = {NULL, query->n, DECENDING, NULL, NULL, NULL};
+    char signature[PARTIAL_MAX_SIGNATURE];
+    unsigned fields = question_fields(query->question);
+    partial_t partial;
+
+    if (fields == 0 || (ds->fields & fields) != fields || ds->sample > 0 || query->question > 5 ||
+        query->partition != RM_BY_NONE || query->approx_counters > 0 || query->hll_precision > 0 ||
+        (query->country != NULL && strcmp(query->country, RM_ALL_COUNTRIES) == 0))
+    {
+        return 1;
+    }
+    partial_signature(signature, query);
+    if (partial_create(&partial, path, signature) != 0)
+    {
+        return 1;
+    }
+    ranking.partial = &partial;
+    ask(ds, query, &ranking);
+    return partial_close(&partial);
+}
+
+/**
+ * Function:  rm_merge
+ * -------------------
+ * @brief  Combines partial files written by rm_partial() and answers their question from the totals.
+ *
+ * The answer is the one rm_query() gives for all the files' inputs at once.
+ * Nothing is passed to fn unless every file was read to its end.
+ *
+ * @param spec The partial files: one file, a directory or a glob pattern, as for rm_open().
+ * @param query The question the files must answer (query->n rows are ranked).
+ * @param fn The function called with the header and then each row, in order.
+ * @param arg The argument passed through to fn.
+ *
+ * @return int 0: No errors; 1: A file could not be read, is damaged, or answers another question.
+ *
+ */
+int rm_merge(const char *spec, const rm_query_t *query, rm_row_fn fn, void *arg)
+{
+    ranking_t ranking = {NULL, query->n, DECENDING, "subject,statistic", NULL, NULL};
+    char signature[PARTIAL_MAX_SIGNATURE];
+    char wanted[PARTIAL_MAX_SIGNATURE];
+    partial_reader_t reader;
+    const char *key;
+    const char *separator;
+    char *group = NULL;
+    char **paths;
+    size_t cap = 0;
+    uint64_t count;
+    int npaths, i;
+    int members = 0;
+    int failed = 0;
+
+    paths = dataset_paths(spec, &npaths);
+    if (paths == NULL)
+    {
+        return 1;
+    }
+    failed = partial_open(&reader, (const char *const *)paths, npaths, signature);
+    for (i = 0; i < npaths; i++)
+    {
+        efree(paths[i]);
+    }
+    efree(paths);
+    if (failed)
+    {
+        return 1;
+    }
+    partial_signature(wanted, query);
+    if (strcmp(signature, wanted) != 0)
+    {
+        fprintf(stderr, "%s answers %s, not %s\n", spec, signature, wanted);
+        partial_finish(&reader);
+        return 1;
+    }
+    ranking.order = query->question == 2 ? ASCENDING : DECENDING;
+
+    while (partial_next(&reader, &key, &count))
+    {
+        if (query->question <= 3)
+        {
+            rank_node((char *)key, (int)count, &ranking);
+            continue;
+        }
+
+        // questions 4 and 5 count the distinct members that follow each group
+        separator = strchr(key, PARTIAL_SEPARATOR);
+        if (separator == NULL)
+        {
+            failed = 1;
+            break;
+        }
+        if (group == NULL || strncmp(group, key, separator - key) != 0 || group[separator - key] != '\0')
+        {
+            if (group != NULL)
+            {
+                rank_node(group, members, &ranking);
+            }
+            if ((size_t)(separator - key) + 1 > cap)
+            {
+                cap = 2 * (separator - key + 1);
+                group = (char *)erealloc(MEM_SCRATCH, group, cap);
+            }
+            memcpy(group, key, separator - key);
+            group[separator - key] = '\0';
+            members = 0;
+        }
+        members++;
+    }
+    if (group != NULL)
+    {
+        rank_node(group, members, &ranking);
+        efree(group);
+    }
+
+    failed |= partial_finish(&reader);
+    if (failed)
+    {
+        free_list(ranking.list);
+        return 1;
+    }
+    report(&ranking, fn, arg);
+    return 0;
+}
+
+/**
+ * Function:  run_job
+ * ------------------
+ * @brief  Pool task answering one query of rm_query_many().
+ *
+ * @param arg The job_t.
+ *
+ */
+static void run_job(void *arg)
+{
+    job_t *job = (job_t *)arg;
+
+    job->failed = rm_query(job->ds, job->query, job->fn, job->arg);
+}
+
+/**
+ * Function:  rm_query_many
+ * ------------------------
+ * @brief  Answers several questions at once, each as a task of a work-stealing thread pool.
+ *
+ * The questions only read the dataset, so they run side by side and the
+ * whole batch takes about as long as its slowest question. Within a
+ * question, the exact counts of questions 1 to 3 and the sketches of
+ * question 6 split the routes into tasks of their own. fn may be
+ * called from several threads at once, but the lines of one answer always
+ * come from one thread, in order.
+ *
+ * @param ds The dataset.
+ * @param queries The questions to answer.
+ * @param nqueries The number of questions.
+ * @param fn The function called with the lines of each answer.
+ * @param args The argument passed to fn with the lines of each question's answer.
+ * @param nthreads The number of threads to use (0 for one per CPU).
+ *
+ * @return int 0: No errors; 1: Some question does not exist or its fields were not loaded.
+ *
+ */
+int rm_query_many(const rm_dataset_t *ds, const rm_query_t *queries, int nqueries, rm_row_fn fn,
+                  void *const *args, int nthreads)
+{
+    job_t *jobs = (job_t *)emalloc((nqueries + 1) * sizeof(job_t));
+    pool_t *pool;
+    int i, failed = 0;
+
+    if (nthreads <= 0)
+    {
+        nthreads = pool_default_workers();
+    }
+    pool = pool_new(nthreads < nqueries ? nthreads : nqueries);
+    for (i = 0; i < nqueries; i++)
+    {
+        jobs[i].ds = ds;
+        jobs[i].query = &queries[i];
+        jobs[i].fn = fn;
+        jobs[i].arg = args[i];
+        jobs[i].failed = 0;
+        pool_submit(pool, run_job, &jobs[i]);
+    }
+    pool_free(pool);
+
+    for (i = 0; i < nqueries; i++)
+    {
+        failed |= jobs[i].failed;
+    }
+    efree(jobs);
+    return failed;
+}
+
+/**
+ * Function:  append_row
+ * ---------------------
+ * @brief  rm_row_fn that appends a line to a buffer_t, keeping it NUL-terminated.
+ *
+ * @param row The line to append.
+ * @param arg The buffer_t.
+ *
+ */
+static void append_row(const char *row, void *arg)
+{
+    buffer_t *out = (buffer_t *)arg;
+    size_t len = strlen(row);
+    size_t room, n;
+
+    // whatever does not fit is only counted
+    if (out->len < out->size)
+    {
+        room = out->size - out->len - 1;
+        n = len < room ? len : room;
+        memcpy(out->buf + out->len, row, n);
+        if (len < room)
+        {
+            out->buf[out->len + n++] = '\n';
+        }
+        out->buf[out->len + n] = '\0';
+    }
+    out->len += len + 1;
+}
+
+/**
+ * Function:  rm_query_buffer
+ * --------------------------
+ * @brief  Answers one question into a caller's buffer, as the text of the CSV file.
+ *
+ * Like snprintf(), the answer is cut short if it does not fit (the buffer
+ * is still NUL-terminated), and the full length is returned so the caller
+ * can retry with a buffer of length + 1 bytes.
+ *
+ * @param ds The dataset.
+ * @param query The question to answer.
+ * @param buf Where to write the answer (may be NULL if size is 0).
+ * @param size The size of buf.
+ *
+ * @return long The length of the full answer, or -1 if rm_query() would fail.
+ *
+ */
+long rm_query_buffer(const rm_dataset_t *ds, const rm_query_t *query, char *buf, size_t size)
+{
+    buffer_t out = {buf, size, 0};
+
+    if (size > 0)
+    {
+        buf[0] = '\0';
+    }
+    if (rm_query(ds, query, append_row, &out) != 0)
+    {
+        return -1;
+    }
+    return (long)out.len;
+}
@@ -0,0 +1,123 @@
+/** @file routemanager.h
+ *  @brief Public interface of libroutemanager, the route questions as a library.
+ *
+ * A route file is loaded once with rm_open() and can then be queried any
+ * number of times. The library keeps no global state, and a dataset is never
+ * modified after rm_open() returns, so any number of threads may query the
+ * same dataset at the same time. Only rm_build_cube() and rm_close() need
+ * the dataset to themselves.
+ *
+ * rm_open_sample() loads a random fraction of the routes instead, for
+ * quick answers scaled to the whole file with their margins of error.
+ * rm_open_shared() parses a file once for every process on the machine,
+ * which then map the same parsed routes from shared memory.
+ * rm_query_stream() answers one question straight from a file read once,
+ * such as standard input, counting the routes without keeping them.
+ *
+ * rm_partial() saves the counts behind an answer instead of the answer, and
+ * rm_merge() answers from any number of such files, so the inputs of one
+ * question can be counted separately (on different machines, say) and
+ * ranked together.
+ *
+ * For long-lived use, rm_live_open() holds a file that rm_live_reload() can
+ * replace while it is being queried: each query runs on the snapshot it
+ * acquired, and a replaced snapshot is freed once its last query releases it.
+ *
+ * rm_export_arrow() writes the parsed routes, and rm_rows_arrow() an answer
+ * collected with rm_rows_add(), as Arrow IPC (Feather) files that pyarrow
+ * and pandas map without parsing.
+ *
+ */
+#ifndef _ROUTEMANAGER_H_
+#define _ROUTEMANAGER_H_
+
+#include <stddef.h>
+
+/**
+ * @brief A loaded route file (opaque).
+ */
+typedef struct dataset_t rm_dataset_t;
+
+/**
+ * @brief A route file that can be replaced while it is queried (opaque).
+ */
+typedef struct live_t rm_live_t;
+
+/**
+ * @brief The lines of an answer kept by rm_rows_add() (opaque).
+ */
+typedef struct rows_t rm_rows_t;
+
+/**
+ * @brief What the ranking of a question may be split by (see rm_partition_by()).
+ */
+typedef enum
+{
+    RM_BY_NONE,
+    RM_BY_AIRLINE,
+    RM_BY_FROM_COUNTRY,
+    RM_BY_TO_COUNTRY
+} rm_partition_t;
+
+/**
+ * @brief One question to ask of a dataset.
+ *
+ * question and n are the --QUESTION and --N of route_manager; the other
+ * fields are its optional flags and are all off when zero. country is the
+ * destination of question 1 (NULL for Canada, RM_ALL_COUNTRIES for a
+ * ranking per destination country, or for every destination when
+ * partitioned). partition splits the ranking of questions 1 to 3 into a
+ * top N for each airline or country, counted exactly in one pass. kll_k
+ * is the size of the quantile sketches of question 6 (200 when zero).
+ */
+typedef struct
+{
+    int question;
+    int n;
+    size_t memory_limit;
+    int approx_counters;
+    int count_min;
+    int hll_precision;
+    int kll_k;
+    const char *country;
+    rm_partition_t partition;
+} rm_query_t;
+
+#define RM_DEFAULT_COUNTRY "Canada"
+#define RM_ALL_COUNTRIES "ALL"
+
+/**
+ * @brief Receives the answer one CSV line at a time (header first, no newline).
+ */
+typedef void (*rm_row_fn)(const char *row, void *arg);
+
+/**
+ * Function protypes associated with the library.
+ */
+rm_dataset_t *rm_open(const char *path);
+rm_dataset_t *rm_open_for(const char *path, int question);
+rm_dataset_t *rm_open_sample(const char *path, int question, double fraction);
+rm_dataset_t *rm_open_shared(const char *path);
+int rm_partition_by(const char *name);
+int rm_build_cube(rm_dataset_t *);
+int rm_query(const rm_dataset_t *, const rm_query_t *, rm_row_fn fn, void *arg);
+int rm_query_many(const rm_dataset_t *, const rm_query_t *, int nqueries, rm_row_fn fn, void *const *args,
+                  int nthreads);
+long rm_query_buffer(const rm_dataset_t *, const rm_query_t *, char *buf, size_t size);
+int rm_query_stream(const char *path, const rm_query_t *, rm_row_fn fn, void *arg);
+int rm_partial(const rm_dataset_t *, const rm_query_t *, const char *path);
+int rm_merge(const char *spec, const rm_query_t *, rm_row_fn fn, void *arg);
+size_t rm_routes(const rm_dataset_t *);
+void rm_close(rm_dataset_t *);
+rm_live_t *rm_live_open(const char *path, int cube);
+const rm_dataset_t *rm_live_acquire(rm_live_t *, int *slot);
+void rm_live_release(rm_live_t *, int slot);
+int rm_live_reload(rm_live_t *, const char *path);
+void rm_live_close(rm_live_t *);
+int rm_export_arrow(const rm_dataset_t *, const char *path);
+rm_rows_t *rm_rows_new(void);
+void rm_rows_add(const char *row, void *rows);
+int rm_rows_arrow(const rm_rows_t *, const char *path);
+void rm_rows_free(rm_rows_t *);
+
+#endif
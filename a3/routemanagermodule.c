@@ -0,0 +1,1050 @@
+/** @file routemanagermodule.c
+ *  @brief The routemanager Python extension module over libroutemanager.
+ *
+ * routemanager.load() joins the a2 airlines, airports and routes files and
+ * routemanager.open() loads an a3 route file. Both return a Dataset, which
+ * answers the a3 questions as CSV text (query), the a2 questions as lists of
+ * (subject, statistic) tuples computed exactly like a2/route_manager.py
+ * does with pandas (answer), and hands out its columns of string ids as
+ * read-only buffers that share the dataset's memory (column).
+ *
+ * routemanager.live() loads an a3 route file into a Live, which answers
+ * the a3 questions like a Dataset and can reload the file while it is being
+ * queried, for long-running services fed a new file every night.
+ *
+ * The GIL is released while loading and querying, so Python threads can
+ * query one Dataset, or one Live, at the same time.
+ *
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "strmap.h"
+#include "distinct.h"
+#include "dataset.h"
+#include "routemanager.h"
+
+/**
+ * @brief A loaded dataset; strings caches the tuple of every pooled value.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    dataset_t ds;
+    PyObject *strings;
+} DatasetObject;
+
+/**
+ * @brief One column of a Dataset, exported through the buffer protocol.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    DatasetObject *owner;
+    int field;
+    Py_ssize_t shape;
+    Py_ssize_t stride;
+} ColumnObject;
+
+/**
+ * @brief A route file that reload() replaces while other threads query it.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    rm_live_t *live;
+} LiveObject;
+
+/**
+ * @brief A growing text buffer collecting the lines of a query.
+ */
+typedef struct
+{
+    char *buf;
+    size_t len;
+    size_t cap;
+} text_t;
+
+/**
+ * @brief One group of an a2 answer.
+ */
+typedef struct
+{
+    const char *subject;
+    long count;
+    double value;
+} group_t;
+
+static PyTypeObject DatasetType;
+static PyTypeObject ColumnType;
+static PyTypeObject LiveType;
+
+/**
+ * Function:  append_line
+ * ----------------------
+ * @brief  rm_row_fn that appends a line and its newline to a text_t.
+ *
+ * @param row The line.
+ * @param arg The text_t.
+ *
+ */
+static void append_line(const char *row, void *arg)
+{
+    text_t *text = (text_t *)arg;
+    size_t len = strlen(row);
+
+    if (text->len + len + 2 > text->cap)
+    {
+        while (text->len + len + 2 > text->cap)
+        {
+            text->cap = text->cap == 0 ? 4096 : 2 * text->cap;
+        }
+        text->buf = (char *)erealloc(MEM_SCRATCH, text->buf, text->cap);
+    }
+    memcpy(text->buf + text->len, row, len);
+    text->len += len;
+    text->buf[text->len++] = '\n';
+    text->buf[text->len] = '\0';
+}
+
+/**
+ * Function:  value
+ * ----------------
+ * @brief  Returns one field of one route, or NULL where it is missing.
+ *
+ * @param ds The dataset.
+ * @param field The field.
+ * @param route The route.
+ *
+ * @return const char* The value, or NULL.
+ *
+ */
+static const char *value(const dataset_t *ds, field_t field, size_t route)
+{
+    return ds->columns[field][route] == MISSING_ID ? NULL : dataset_value(ds, field, route);
+}
+
+/**
+ * Function:  nan_or
+ * -----------------
+ * @brief  Returns a value as pandas' astype(str) prints it, "nan" where it is missing.
+ *
+ * @param text The value (may be NULL).
+ *
+ * @return const char* The text to print.
+ *
+ */
+static const char *nan_or(const char *text)
+{
+    return text == NULL ? "nan" : text;
+}
+
+/**
+ * Function:  count_group
+ * ----------------------
+ * @brief  Counts one more route in the group of a subject.
+ *
+ * @param groups The groups, keyed by subject; values are counts.
+ * @param subject The subject.
+ *
+ */
+static void count_group(strmap_t *groups, const char *subject)
+{
+    strmap_entry_t *e = strmap_insert(groups, subject, NULL);
+
+    e->value = (void *)((uintptr_t)e->value + 1);
+}
+
+/**
+ * Function:  by_count_desc
+ * ------------------------
+ * @brief  qsort() comparator: larger counts first, then subjects in code point order.
+ *
+ */
+static int by_count_desc(const void *a, const void *b)
+{
+    const group_t *x = (const group_t *)a;
+    const group_t *y = (const group_t *)b;
+
+    if (x->count != y->count)
+    {
+        return x->count > y->count ? -1 : 1;
+    }
+    return strcmp(x->subject, y->subject);
+}
+
+/**
+ * Function:  by_count_asc
+ * -----------------------
+ * @brief  qsort() comparator: smaller counts first, then subjects in code point order.
+ *
+ */
+static int by_count_asc(const void *a, const void *b)
+{
+    const group_t *x = (const group_t *)a;
+    const group_t *y = (const group_t *)b;
+
+    if (x->count != y->count)
+    {
+        return x->count < y->count ? -1 : 1;
+    }
+    return strcmp(x->subject, y->subject);
+}
+
+/**
+ * Function:  by_value_desc
+ * ------------------------
+ * @brief  qsort() comparator: larger values first, then subjects in reverse code point order.
+ *
+ */
+static int by_value_desc(const void *a, const void *b)
+{
+    const group_t *x = (const group_t *)a;
+    const group_t *y = (const group_t *)b;
+
+    if (x->value != y->value)
+    {
+        return x->value > y->value ? -1 : 1;
+    }
+    return -strcmp(x->subject, y->subject);
+}
+
+/**
+ * Function:  collect
+ * ------------------
+ * @brief  Turns counted groups into a sorted array.
+ *
+ * @param groups The groups; values are counts.
+ * @param ngroups Set to the number of groups.
+ * @param compare The order to sort the groups in.
+ *
+ * @return group_t* The groups; subjects point into the map.
+ *
+ */
+static group_t *collect(strmap_t *groups, size_t *ngroups, int (*compare)(const void *, const void *))
+{
+    group_t *sorted = (group_t *)emalloc((groups->size + 1) * sizeof(group_t));
+    size_t i, n = 0;
+
+    for (i = 0; i < groups->cap; i++)
+    {
+        if (groups->entries[i].key != NULL)
+        {
+            sorted[n].subject = groups->entries[i].key;
+            sorted[n].count = (long)(uintptr_t)groups->entries[i].value;
+            sorted[n].value = 0;
+            n++;
+        }
+    }
+    qsort(sorted, n, sizeof(group_t), compare);
+    *ngroups = n;
+    return sorted;
+}
+
+/**
+ * Function:  parse_altitude
+ * -------------------------
+ * @brief  Reads an altitude like pd.to_numeric(errors='coerce') does.
+ *
+ * @param text The altitude (may be NULL).
+ *
+ * @return double The altitude, or NAN if it is missing or not a number.
+ *
+ */
+static double parse_altitude(const char *text)
+{
+    char *end;
+    double altitude;
+
+    if (text == NULL || text[0] == '\0')
+    {
+        return NAN;
+    }
+    altitude = strtod(text, &end);
+    return *end == '\0' ? altitude : NAN;
+}
+
+/**
+ * Function:  a2_answer
+ * --------------------
+ * @brief  Answers one of the a2 questions.
+ *
+ * Groups with a missing key are dropped and rows are ordered as
+ * a2/route_manager.py orders them: q1, q3 and q4 by most routes, q2 by
+ * fewest routes, ties by subject; q5 (routes within Canada) by largest
+ * altitude difference, ties by subject in reverse.
+ *
+ * @param ds The dataset (joined from the a2 files).
+ * @param question The question, 1 to 5.
+ * @param ngroups Set to the number of rows.
+ * @param groups Set to the map the row subjects point into (free with strmap_free()).
+ *
+ * @return group_t* The rows, best first.
+ *
+ */
+static group_t *a2_answer(const dataset_t *ds, int question, size_t *ngroups, strmap_t *groups)
+{
+    int (*compare)(const void *, const void *) = by_count_desc;
+    char subject[4 * MAX_VALUE_LENGTH + 16];
+    const char *name, *icao, *city, *country, *from, *origin;
+    double *diff;
+    group_t *sorted;
+    size_t r, i;
+
+    strmap_init(groups, 1024);
+    for (r = 0; r < ds->nroutes; r++)
+    {
+        switch (question)
+        {
+        case 1:
+            name = value(ds, FIELD_AIRLINE_NAME, r);
+            icao = value(ds, FIELD_AIRLINE_ICAO, r);
+            country = value(ds, FIELD_TO_COUNTRY, r);
+            if (name != NULL && icao != NULL && country != NULL && strcmp(country, "Canada") == 0)
+            {
+                sprintf(subject, "%s (%s)", name, icao);
+                count_group(groups, subject);
+            }
+            break;
+        case 2:
+            compare = by_count_asc;
+            country = value(ds, FIELD_TO_COUNTRY, r);
+            if (country != NULL)
+            {
+                count_group(groups, country);
+            }
+            break;
+        case 3:
+            sprintf(subject, "%s (%s), %s, %s", nan_or(value(ds, FIELD_TO_NAME, r)),
+                    nan_or(value(ds, FIELD_TO_ICAO, r)), nan_or(value(ds, FIELD_TO_CITY, r)),
+                    nan_or(value(ds, FIELD_TO_COUNTRY, r)));
+            count_group(groups, subject);
+            break;
+        case 4:
+            city = value(ds, FIELD_TO_CITY, r);
+            country = value(ds, FIELD_TO_COUNTRY, r);
+            if (city != NULL && country != NULL)
+            {
+                // pandas orders ties by city, then country: a separator below every character keeps that order
+                sprintf(subject, "%s\001%s", city, country);
+                count_group(groups, subject);
+            }
+            break;
+        case 5:
+            from = value(ds, FIELD_FROM_ICAO, r);
+            icao = value(ds, FIELD_TO_ICAO, r);
+            country = value(ds, FIELD_TO_COUNTRY, r);
+            origin = value(ds, FIELD_FROM_COUNTRY, r);
+            if (from == NULL || icao == NULL || country == NULL || strcmp(country, "Canada") != 0 ||
+                origin == NULL || strcmp(origin, "Canada") != 0 ||
+                isnan(parse_altitude(value(ds, FIELD_TO_ALTITUDE, r)) - parse_altitude(value(ds, FIELD_FROM_ALTITUDE, r))))
+            {
+                break;
+            }
+            sprintf(subject, "%s-%s", from, icao);
+            if (strmap_find(groups, subject) == NULL)
+            {
+                diff = (double *)emalloc(sizeof(double));
+                *diff = fabs(parse_altitude(value(ds, FIELD_TO_ALTITUDE, r)) -
+                             parse_altitude(value(ds, FIELD_FROM_ALTITUDE, r)));
+                strmap_insert(groups, subject, NULL)->value = diff;
+            }
+            break;
+        }
+    }
+
+    if (question != 5)
+    {
+        return collect(groups, ngroups, compare);
+    }
+
+    // a route pair always joins the same two airports, so it has one difference
+    sorted = collect(groups, ngroups, by_count_desc);
+    for (i = 0; i < *ngroups; i++)
+    {
+        sorted[i].value = *(double *)strmap_find(groups, sorted[i].subject)->value;
+    }
+    qsort(sorted, *ngroups, sizeof(group_t), by_value_desc);
+    return sorted;
+}
+
+/**
+ * Function:  free_groups
+ * ----------------------
+ * @brief  Releases the map of an a2 answer.
+ *
+ * @param groups The map.
+ * @param question The question it answered (only q5 owns its values).
+ *
+ */
+static void free_groups(strmap_t *groups, int question)
+{
+    strmap_free(groups, question == 5 ? efree : NULL);
+}
+
+/**
+ * Function:  Dataset_answer
+ * -------------------------
+ * @brief  Dataset.answer(question): the rows a2/route_manager.py writes for q1 to q5.
+ *
+ * @return PyObject* A list of (subject, statistic) tuples, or NULL with an exception set.
+ *
+ */
+static PyObject *Dataset_answer(DatasetObject *self, PyObject *args)
+{
+    static const int limits[] = {0, 20, 30, 10, 15, 10};
+    char subject[4 * MAX_VALUE_LENGTH + 16];
+    const char *name, *split;
+    int question;
+    strmap_t groups;
+    group_t *sorted;
+    size_t ngroups, i;
+    PyObject *rows, *row;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+    {
+        return NULL;
+    }
+    if (name[0] != 'q' || name[1] < '1' || name[1] > '5' || name[2] != '\0')
+    {
+        PyErr_Format(PyExc_ValueError, "unknown question %s (expected q1 to q5)", name);
+        return NULL;
+    }
+    question = name[1] - '0';
+
+    Py_BEGIN_ALLOW_THREADS
+    sorted = a2_answer(&self->ds, question, &ngroups, &groups);
+    Py_END_ALLOW_THREADS
+
+    rows = PyList_New(0);
+    for (i = 0; rows != NULL && i < ngroups && i < (size_t)limits[question]; i++)
+    {
+        if (question == 5)
+        {
+            row = Py_BuildValue("(sd)", sorted[i].subject, sorted[i].value);
+        }
+        else if (question == 4)
+        {
+            split = strchr(sorted[i].subject, '\001');
+            sprintf(subject, "%.*s, %s", (int)(split - sorted[i].subject), sorted[i].subject, split + 1);
+            row = Py_BuildValue("(sl)", subject, sorted[i].count);
+        }
+        else
+        {
+            row = Py_BuildValue("(sl)", sorted[i].subject, sorted[i].count);
+        }
+        if (row == NULL || PyList_Append(rows, row) != 0)
+        {
+            Py_CLEAR(rows);
+        }
+        Py_XDECREF(row);
+    }
+
+    efree(sorted);
+    free_groups(&groups, question);
+    return rows;
+}
+
+/**
+ * Function:  parse_query
+ * ----------------------
+ * @brief  Reads the arguments of query(question, n, memory_limit=0, approx=0, count_min=False, hll=0, country=None, partition=None, kll=0).
+ *
+ * @param args The positional arguments.
+ * @param kwargs The keyword arguments.
+ * @param query Set to the question asked.
+ *
+ * @return int 0: No errors; 1: An argument is wrong (an exception is set).
+ *
+ */
+static int parse_query(PyObject *args, PyObject *kwargs, rm_query_t *query)
+{
+    static char *keywords[] = {"question", "n",       "memory_limit", "approx", "count_min",
+                               "hll",      "country", "partition",    "kll",    NULL};
+    const char *partition = NULL;
+    int by;
+
+    memset(query, 0, sizeof(*query));
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ii|npiizzi", keywords, &query->question, &query->n,
+                                     &query->memory_limit, &query->approx_counters, &query->count_min,
+                                     &query->hll_precision, &query->country, &partition, &query->kll_k))
+    {
+        return 1;
+    }
+    if (partition != NULL)
+    {
+        by = rm_partition_by(partition);
+        if (by < 0 || query->question > 3)
+        {
+            PyErr_SetString(PyExc_ValueError,
+                            "partition must be airline, from_country or to_country, for questions 1 to 3");
+            return 1;
+        }
+        query->partition = (rm_partition_t)by;
+    }
+    if (query->hll_precision != 0 &&
+        (query->hll_precision < HLL_MIN_PRECISION || query->hll_precision > HLL_MAX_PRECISION))
+    {
+        PyErr_Format(PyExc_ValueError, "hll must be between %d and %d", HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+        return 1;
+    }
+    if (query->kll_k < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "kll must be positive");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Function:  answer_query
+ * -----------------------
+ * @brief  Answers an a3 question with the GIL released.
+ *
+ * @param ds The dataset.
+ * @param query The question.
+ *
+ * @return PyObject* The CSV text route_manager would write, or NULL with an exception set.
+ *
+ */
+static PyObject *answer_query(const rm_dataset_t *ds, const rm_query_t *query)
+{
+    text_t text = {NULL, 0, 0};
+    PyObject *result;
+    int failed;
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = rm_query(ds, query, append_line, &text);
+    Py_END_ALLOW_THREADS
+
+    if (failed)
+    {
+        efree(text.buf);
+        PyErr_Format(PyExc_ValueError, "question %d cannot be answered from this dataset", query->question);
+        return NULL;
+    }
+    result = PyUnicode_DecodeUTF8(text.buf != NULL ? text.buf : "", text.len, "surrogateescape");
+    efree(text.buf);
+    return result;
+}
+
+/**
+ * Function:  Dataset_query
+ * ------------------------
+ * @brief  Dataset.query(question, n, memory_limit=0, approx=0, count_min=False, hll=0, country=None, partition=None, kll=0): an a3 answer.
+ *
+ * @return PyObject* The CSV text route_manager would write, or NULL with an exception set.
+ *
+ */
+static PyObject *Dataset_query(DatasetObject *self, PyObject *args, PyObject *kwargs)
+{
+    rm_query_t query;
+
+    if (parse_query(args, kwargs, &query) != 0)
+    {
+        return NULL;
+    }
+    return answer_query(&self->ds, &query);
+}
+
+/**
+ * Function:  Dataset_build_cube
+ * -----------------------------
+ * @brief  Dataset.build_cube(): rolls the routes up so later exact queries read the cube.
+ *
+ * The GIL is held throughout, so call it before the Dataset is shared with
+ * threads that query it.
+ *
+ * @return PyObject* None, or NULL with an exception set.
+ *
+ */
+static PyObject *Dataset_build_cube(DatasetObject *self, PyObject *args)
+{
+    if (rm_build_cube(&self->ds) != 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "this dataset lacks fields the cube needs");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * Function:  Dataset_column
+ * -------------------------
+ * @brief  Dataset.column(field): a field's string ids, shared with the dataset.
+ *
+ * @return PyObject* A read-only memoryview of format 'I', or NULL with an exception set.
+ *
+ */
+static PyObject *Dataset_column(DatasetObject *self, PyObject *args)
+{
+    ColumnObject *column;
+    PyObject *view;
+    const char *name;
+    int f;
+
+    if (!PyArg_ParseTuple(args, "s", &name))
+    {
+        return NULL;
+    }
+    for (f = 0; f < FIELD_COUNT && strcmp(name, FIELD_NAMES[f]) != 0; f++)
+        ;
+    if (f == FIELD_COUNT || !(self->ds.fields & FIELD_BIT(f)))
+    {
+        PyErr_Format(PyExc_KeyError, "%s", name);
+        return NULL;
+    }
+
+    column = PyObject_New(ColumnObject, &ColumnType);
+    if (column == NULL)
+    {
+        return NULL;
+    }
+    Py_INCREF(self);
+    column->owner = self;
+    column->field = f;
+    column->shape = (Py_ssize_t)self->ds.nroutes;
+    column->stride = sizeof(uint32_t);
+
+    view = PyMemoryView_FromObject((PyObject *)column);
+    Py_DECREF(column);
+    return view;
+}
+
+/**
+ * Function:  Dataset_get_strings
+ * ------------------------------
+ * @brief  Dataset.strings: every distinct value, indexed by string id.
+ *
+ * @return PyObject* A tuple of str, or NULL with an exception set.
+ *
+ */
+static PyObject *Dataset_get_strings(DatasetObject *self, void *closure)
+{
+    PyObject *text;
+    uint32_t id;
+
+    if (self->strings == NULL)
+    {
+        self->strings = PyTuple_New(self->ds.nstrings);
+        for (id = 0; self->strings != NULL && id < self->ds.nstrings; id++)
+        {
+            text = PyUnicode_DecodeUTF8(self->ds.pool + self->ds.offsets[id],
+                                        strlen(self->ds.pool + self->ds.offsets[id]), "surrogateescape");
+            if (text == NULL)
+            {
+                Py_CLEAR(self->strings);
+                return NULL;
+            }
+            PyTuple_SET_ITEM(self->strings, id, text);
+        }
+    }
+    Py_XINCREF(self->strings);
+    return self->strings;
+}
+
+/**
+ * Function:  Dataset_get_fields
+ * -----------------------------
+ * @brief  Dataset.fields: the names of the loaded columns, in file order.
+ *
+ * @return PyObject* A tuple of str, or NULL with an exception set.
+ *
+ */
+static PyObject *Dataset_get_fields(DatasetObject *self, void *closure)
+{
+    PyObject *fields = PyList_New(0);
+    PyObject *name, *result;
+    int f;
+
+    for (f = 0; fields != NULL && f < FIELD_COUNT; f++)
+    {
+        if (!(self->ds.fields & FIELD_BIT(f)))
+        {
+            continue;
+        }
+        name = PyUnicode_FromString(FIELD_NAMES[f]);
+        if (name == NULL || PyList_Append(fields, name) != 0)
+        {
+            Py_CLEAR(fields);
+        }
+        Py_XDECREF(name);
+    }
+    if (fields == NULL)
+    {
+        return NULL;
+    }
+    result = PyList_AsTuple(fields);
+    Py_DECREF(fields);
+    return result;
+}
+
+/**
+ * Function:  Dataset_len
+ * ----------------------
+ * @brief  len(Dataset): the number of routes.
+ *
+ */
+static Py_ssize_t Dataset_len(DatasetObject *self)
+{
+    return (Py_ssize_t)self->ds.nroutes;
+}
+
+/**
+ * Function:  Dataset_dealloc
+ * --------------------------
+ * @brief  Releases a Dataset once no column refers to it any more.
+ *
+ */
+static void Dataset_dealloc(DatasetObject *self)
+{
+    dataset_free(&self->ds);
+    Py_XDECREF(self->strings);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/**
+ * Function:  Column_getbuffer
+ * ---------------------------
+ * @brief  Exports a column as a read-only one-dimensional array of uint32.
+ *
+ */
+static int Column_getbuffer(ColumnObject *self, Py_buffer *view, int flags)
+{
+    if (flags & PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "dataset columns are read-only");
+        return -1;
+    }
+    view->obj = (PyObject *)self;
+    Py_INCREF(self);
+    view->buf = self->owner->ds.columns[self->field];
+    view->len = self->shape * self->stride;
+    view->readonly = 1;
+    view->itemsize = sizeof(uint32_t);
+    view->format = (flags & PyBUF_FORMAT) ? "I" : NULL;
+    view->ndim = 1;
+    view->shape = &self->shape;
+    view->strides = &self->stride;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+/**
+ * Function:  Column_dealloc
+ * -------------------------
+ * @brief  Releases a column and its hold on the dataset.
+ *
+ */
+static void Column_dealloc(ColumnObject *self)
+{
+    Py_DECREF(self->owner);
+    PyObject_Free(self);
+}
+
+/**
+ * Function:  new_dataset
+ * ----------------------
+ * @brief  Wraps a loaded table in a Dataset.
+ *
+ * @param ds The table (moved into the Dataset).
+ *
+ * @return PyObject* The Dataset, or NULL with an exception set.
+ *
+ */
+static PyObject *new_dataset(dataset_t *ds)
+{
+    DatasetObject *self = PyObject_New(DatasetObject, &DatasetType);
+
+    if (self == NULL)
+    {
+        dataset_free(ds);
+        return NULL;
+    }
+    self->ds = *ds;
+    self->strings = NULL;
+    return (PyObject *)self;
+}
+
+/**
+ * Function:  routemanager_load
+ * ----------------------------
+ * @brief  routemanager.load(airlines, airports, routes): joins the a2 files into a Dataset.
+ *
+ */
+static PyObject *routemanager_load(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"airlines", "airports", "routes", NULL};
+    const char *airlines, *airports, *routes;
+    dataset_t ds;
+    int failed;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sss", keywords, &airlines, &airports, &routes))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = dataset_load_joined(&ds, airlines, airports, routes);
+    Py_END_ALLOW_THREADS
+
+    if (failed)
+    {
+        PyErr_Format(PyExc_OSError, "cannot read %s, %s or %s", airlines, airports, routes);
+        return NULL;
+    }
+    return new_dataset(&ds);
+}
+
+/**
+ * Function:  routemanager_open
+ * ----------------------------
+ * @brief  routemanager.open(path): loads an a3 route file (.gz and .zst too), or a directory or pattern of shards, into a Dataset.
+ *
+ */
+static PyObject *routemanager_open(PyObject *module, PyObject *args)
+{
+    const char *path;
+    dataset_t ds;
+    int failed;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = dataset_load_sharded(&ds, path, ALL_FIELDS);
+    Py_END_ALLOW_THREADS
+
+    if (failed)
+    {
+        PyErr_Format(PyExc_OSError, "cannot read %s", path);
+        return NULL;
+    }
+    return new_dataset(&ds);
+}
+
+/**
+ * Function:  routemanager_live
+ * ----------------------------
+ * @brief  routemanager.live(path, cube=False): loads an a3 route file into a Live, optionally with its rollup cube.
+ *
+ */
+static PyObject *routemanager_live(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"path", "cube", NULL};
+    const char *path;
+    int cube = 0;
+    LiveObject *self;
+    rm_live_t *live;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|p", keywords, &path, &cube))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    live = rm_live_open(path, cube);
+    Py_END_ALLOW_THREADS
+
+    if (live == NULL)
+    {
+        PyErr_Format(PyExc_OSError, "cannot read %s", path);
+        return NULL;
+    }
+    self = PyObject_New(LiveObject, &LiveType);
+    if (self == NULL)
+    {
+        rm_live_close(live);
+        return NULL;
+    }
+    self->live = live;
+    return (PyObject *)self;
+}
+
+/**
+ * Function:  Live_query
+ * ---------------------
+ * @brief  Live.query(...): an a3 answer from the snapshot current when the query starts (see Dataset.query).
+ *
+ */
+static PyObject *Live_query(LiveObject *self, PyObject *args, PyObject *kwargs)
+{
+    const rm_dataset_t *ds;
+    rm_query_t query;
+    PyObject *result;
+    int slot;
+
+    if (parse_query(args, kwargs, &query) != 0)
+    {
+        return NULL;
+    }
+    ds = rm_live_acquire(self->live, &slot);
+    result = answer_query(ds, &query);
+    rm_live_release(self->live, slot);
+    return result;
+}
+
+/**
+ * Function:  Live_reload
+ * ----------------------
+ * @brief  Live.reload(path): loads a route file, then swaps it in; queries running meanwhile finish on the old one.
+ *
+ * @return PyObject* None, or NULL with an exception set (the old file stays).
+ *
+ */
+static PyObject *Live_reload(LiveObject *self, PyObject *args)
+{
+    const char *path;
+    int failed;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+    {
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    failed = rm_live_reload(self->live, path);
+    Py_END_ALLOW_THREADS
+
+    if (failed)
+    {
+        PyErr_Format(PyExc_OSError, "cannot read %s", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/**
+ * Function:  Live_len
+ * -------------------
+ * @brief  len(live): the number of routes in the current snapshot.
+ *
+ */
+static Py_ssize_t Live_len(LiveObject *self)
+{
+    int slot;
+    const rm_dataset_t *ds = rm_live_acquire(self->live, &slot);
+    Py_ssize_t n = (Py_ssize_t)rm_routes(ds);
+
+    rm_live_release(self->live, slot);
+    return n;
+}
+
+/**
+ * Function:  Live_dealloc
+ * -----------------------
+ * @brief  Releases a Live; no query can be running on it once it is unreachable.
+ *
+ */
+static void Live_dealloc(LiveObject *self)
+{
+    rm_live_close(self->live);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyMethodDef Dataset_methods[] = {
+    {"answer", (PyCFunction)Dataset_answer, METH_VARARGS,
+     "answer(question) -> list of (subject, statistic) for a2's 'q1' to 'q5'"},
+    {"query", (PyCFunction)(void (*)(void))Dataset_query, METH_VARARGS | METH_KEYWORDS,
+     "query(question, n, memory_limit=0, approx=0, count_min=False, hll=0, country=None) -> CSV text of an a3 question"},
+    {"build_cube", (PyCFunction)Dataset_build_cube, METH_NOARGS,
+     "build_cube() -> None; answer later exact queries from a rollup cube"},
+    {"column", (PyCFunction)Dataset_column, METH_VARARGS,
+     "column(field) -> read-only memoryview of the field's string ids (index into strings)"},
+    {NULL, NULL, 0, NULL}};
+
+static PyGetSetDef Dataset_getset[] = {
+    {"strings", (getter)Dataset_get_strings, NULL, "every distinct value, indexed by string id", NULL},
+    {"fields", (getter)Dataset_get_fields, NULL, "the names of the loaded columns", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PySequenceMethods Dataset_as_sequence = {
+    .sq_length = (lenfunc)Dataset_len,
+};
+
+static PyTypeObject DatasetType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "routemanager.Dataset",
+    .tp_doc = "Routes loaded once by routemanager.load() or routemanager.open().",
+    .tp_basicsize = sizeof(DatasetObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)Dataset_dealloc,
+    .tp_methods = Dataset_methods,
+    .tp_getset = Dataset_getset,
+    .tp_as_sequence = &Dataset_as_sequence,
+};
+
+static PyMethodDef Live_methods[] = {
+    {"query", (PyCFunction)(void (*)(void))Live_query, METH_VARARGS | METH_KEYWORDS,
+     "query(question, n, ...) -> CSV text of an a3 question, as Dataset.query"},
+    {"reload", (PyCFunction)Live_reload, METH_VARARGS,
+     "reload(path) -> None; replace the route file without pausing queries"},
+    {NULL, NULL, 0, NULL}};
+
+static PySequenceMethods Live_as_sequence = {
+    .sq_length = (lenfunc)Live_len,
+};
+
+static PyTypeObject LiveType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "routemanager.Live",
+    .tp_doc = "A route file loaded by routemanager.live() that reload() replaces under load.",
+    .tp_basicsize = sizeof(LiveObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)Live_dealloc,
+    .tp_methods = Live_methods,
+    .tp_as_sequence = &Live_as_sequence,
+};
+
+static PyBufferProcs Column_as_buffer = {
+    .bf_getbuffer = (getbufferproc)Column_getbuffer,
+};
+
+static PyTypeObject ColumnType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "routemanager.Column",
+    .tp_doc = "A column of string ids, exported through the buffer protocol.",
+    .tp_basicsize = sizeof(ColumnObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)Column_dealloc,
+    .tp_as_buffer = &Column_as_buffer,
+};
+
+static PyMethodDef routemanager_methods[] = {
+    {"load", (PyCFunction)(void (*)(void))routemanager_load, METH_VARARGS | METH_KEYWORDS,
+     "load(airlines, airports, routes) -> Dataset joined from the a2 YAML files"},
+    {"open", (PyCFunction)routemanager_open, METH_VARARGS,
+     "open(path) -> Dataset of an a3 route file"},
+    {"live", (PyCFunction)(void (*)(void))routemanager_live, METH_VARARGS | METH_KEYWORDS,
+     "live(path, cube=False) -> Live of an a3 route file, reloadable while queried"},
+    {NULL, NULL, 0, NULL}};
+
+static struct PyModuleDef routemanager_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "routemanager",
+    .m_doc = "Native route questions (libroutemanager).",
+    .m_size = -1,
+    .m_methods = routemanager_methods,
+};
+
+/**
+ * Function:  PyInit_routemanager
+ * ------------------------------
+ * @brief  Module initialisation.
+ *
+ */
+PyMODINIT_FUNC PyInit_routemanager(void)
+{
+    if (PyType_Ready(&DatasetType) < 0 || PyType_Ready(&ColumnType) < 0 || PyType_Ready(&LiveType) < 0)
+    {
+        return NULL;
+    }
+    return PyModule_Create(&routemanager_module);
+}
@@ -0,0 +1,506 @@
+/** @file segment.c
+ *  @brief Implementation of segment.h
+ *
+ * A parsed route file is published as one POSIX shared-memory object: a
+ * header, then the string pool, the string offsets and the loaded columns,
+ * each 8-byte aligned. A process that attaches maps the object read-only
+ * and points its dataset into the mapping, so it parses nothing, allocates
+ * nothing for the routes, and shares their pages with every other process
+ * mapping them.
+ *
+ * The object is named after the absolute path of the input. The first
+ * process to create it (O_EXCL) parses the input, fills the object and sets
+ * ready last; the others wait for ready as long as the writer is alive.
+ * The header holds a stamp of the input (device, inode, size and times of
+ * every shard), and an object whose stamp no longer matches is unlinked and
+ * published again; processes still mapping the old one keep it until they
+ * unmap it. Objects stay until they are replaced, unlinked or the machine
+ * restarts (on Linux they are the files of /dev/shm).
+ *
+ * Objects are created readable by their owner only, and a process only
+ * attaches to an object of its own user whose layout fits inside it;
+ * anything else is parsed privately, so a header cannot point a dataset
+ * outside its mapping.
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "emalloc.h"
+#include "hash.h"
+#include "reader.h"
+#include "segment.h"
+
+#define SEGMENT_MAGIC 0x3147455345544f52ULL // "ROTESEG1"
+#define SEGMENT_VERSION 1
+
+// times to try creating or attaching before parsing privately
+#define SEGMENT_ATTEMPTS 4
+
+// how long an object may stay without a header before its writer is taken for dead
+#define SEGMENT_HEADER_WAIT_MS 2000
+
+#define ALIGN8(n) (((n) + 7) & ~(uint64_t)7)
+
+/**
+ * @brief The states of a segment's ready word.
+ */
+enum
+{
+    SEGMENT_WRITING,
+    SEGMENT_READY,
+    SEGMENT_ABANDONED
+};
+
+/**
+ * @brief The start of a segment: what it holds and where.
+ */
+typedef struct
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ready;  // written last, with release order
+    int64_t writer;  // process id of the process filling it
+    uint64_t stamp;  // of the input it was parsed from
+    uint64_t size;   // of the whole segment
+    uint64_t fields;
+    uint64_t nroutes;
+    uint64_t nscanned;
+    uint64_t nstrings;
+    uint64_t pool_size;
+    uint64_t pool_at;
+    uint64_t offsets_at;
+    uint64_t columns_at[FIELD_COUNT];
+} header_t;
+
+/**
+ * Function:  segment_name
+ * -----------------------
+ * @brief  Names the shared-memory object of an input, after its absolute path.
+ *
+ * @param name Where to write the name (SEGMENT_NAME_LENGTH bytes).
+ * @param spec The route file, directory of shards or pattern of shards.
+ *
+ */
+void segment_name(char *name, const char *spec)
+{
+    char resolved[PATH_MAX];
+    char cwd[PATH_MAX];
+    uint64_t h;
+
+    if (realpath(spec, resolved) != NULL)
+    {
+        h = hash_string(resolved);
+    }
+    else
+    {
+        // a glob pattern resolves to no file of its own
+        h = hash_string(spec);
+        if (spec[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL)
+        {
+            h = hash_bytes(cwd, strlen(cwd), h);
+        }
+    }
+    sprintf(name, "/routemanager-%016" PRIx64, h);
+}
+
+/**
+ * Function:  input_stamp
+ * ----------------------
+ * @brief  Stamps the current version of an input, so that any change to one of its files changes the stamp.
+ *
+ * @param spec The route file, directory of shards or pattern of shards.
+ * @param stamp Set to the stamp.
+ *
+ * @return int 0: No errors; 1: The input is standard input, no file was found or one could not be examined.
+ *
+ */
+static int input_stamp(const char *spec, uint64_t *stamp)
+{
+    struct stat info;
+    uint64_t facts[7];
+    char **paths;
+    int npaths, i, failed = 0;
+
+    if (strcmp(spec, READER_STDIN) == 0)
+    {
+        return 1;
+    }
+    paths = dataset_paths(spec, &npaths);
+    if (paths == NULL)
+    {
+        return 1;
+    }
+    *stamp = (uint64_t)npaths;
+    for (i = 0; i < npaths; i++)
+    {
+        if (stat(paths[i], &info) != 0)
+        {
+            failed = 1;
+        }
+        else
+        {
+            facts[0] = (uint64_t)info.st_dev;
+            facts[1] = (uint64_t)info.st_ino;
+            facts[2] = (uint64_t)info.st_size;
+            facts[3] = (uint64_t)info.st_mtim.tv_sec;
+            facts[4] = (uint64_t)info.st_mtim.tv_nsec;
+            facts[5] = (uint64_t)info.st_ctim.tv_sec;
+            facts[6] = (uint64_t)info.st_ctim.tv_nsec;
+            *stamp = hash_bytes(facts, sizeof(facts), *stamp);
+        }
+        efree(paths[i]);
+    }
+    efree(paths);
+    return failed;
+}
+
+/**
+ * Function:  fits
+ * ---------------
+ * @brief  Tells whether a region of a segment lies inside it, without overflowing.
+ *
+ * @param at The offset of the region.
+ * @param count The number of items in it.
+ * @param item The size of an item.
+ * @param size The size of the segment.
+ *
+ * @return int 1: It fits; 0: It does not.
+ *
+ */
+static int fits(uint64_t at, uint64_t count, uint64_t item, uint64_t size)
+{
+    return at <= size && count <= (size - at) / item;
+}
+
+/**
+ * Function:  valid_layout
+ * -----------------------
+ * @brief  Checks that the header of a segment describes a layout inside the object actually there.
+ *
+ * @param header The header.
+ * @param object_size The size of the shared-memory object.
+ *
+ * @return int 1: Every part lies inside the segment; 0: Some part does not.
+ *
+ */
+static int valid_layout(const header_t *header, uint64_t object_size)
+{
+    int f;
+
+    if (header->size < sizeof(header_t) || header->size > object_size || (header->fields & ~(uint64_t)ALL_FIELDS) ||
+        header->nstrings > UINT32_MAX || !fits(header->pool_at, header->pool_size, 1, header->size) ||
+        !fits(header->offsets_at, header->nstrings, sizeof(uint64_t), header->size))
+    {
+        return 0;
+    }
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        if (header->fields & FIELD_BIT(f) && !fits(header->columns_at[f], header->nroutes, sizeof(uint32_t), header->size))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Function:  attach
+ * -----------------
+ * @brief  Maps a ready segment read-only and points a dataset into it.
+ *
+ * @param ds The dataset to fill.
+ * @param fd The segment.
+ * @param header Its header.
+ *
+ * @return int 0: No errors; 1: The segment is another user's, its layout does not fit in it, or it could not be mapped.
+ *
+ */
+static int attach(dataset_t *ds, int fd, const header_t *header)
+{
+    struct stat info;
+    char *base;
+    int f;
+
+    if (fstat(fd, &info) != 0 || info.st_uid != geteuid() || !valid_layout(header, (uint64_t)info.st_size))
+    {
+        return 1;
+    }
+    base = (char *)mmap(NULL, header->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        return 1;
+    }
+    memset(ds, 0, sizeof(dataset_t));
+    ds->pool = base + header->pool_at;
+    ds->pool_size = header->pool_size;
+    ds->offsets = (uint64_t *)(base + header->offsets_at);
+    ds->nstrings = (uint32_t)header->nstrings;
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        ds->columns[f] = header->fields & FIELD_BIT(f) ? (uint32_t *)(base + header->columns_at[f]) : NULL;
+    }
+    ds->nroutes = header->nroutes;
+    ds->nscanned = header->nscanned;
+    ds->fields = (unsigned)header->fields;
+    ds->segment = base;
+    ds->segment_size = header->size;
+    return 0;
+}
+
+/**
+ * Function:  publish
+ * ------------------
+ * @brief  Copies a loaded dataset into a segment and marks it ready.
+ *
+ * The whole segment is reserved before it is written, so a full
+ * shared-memory filesystem fails here rather than faulting later.
+ *
+ * @param fd The segment, created by this process.
+ * @param ds The dataset.
+ * @param header The header written so far; its layout is filled in.
+ *
+ * @return int 0: No errors; 1: The segment could not be sized or mapped.
+ *
+ */
+static int publish(int fd, const dataset_t *ds, header_t *header)
+{
+    uint64_t at = ALIGN8(sizeof(header_t));
+    size_t column = ds->nroutes * sizeof(uint32_t);
+    char *base;
+    int f;
+
+    header->fields = ds->fields;
+    header->nroutes = ds->nroutes;
+    header->nscanned = ds->nscanned;
+    header->nstrings = ds->nstrings;
+    header->pool_size = ds->pool_size;
+    header->pool_at = at;
+    at = ALIGN8(at + ds->pool_size);
+    header->offsets_at = at;
+    at = ALIGN8(at + ds->nstrings * sizeof(uint64_t));
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        header->columns_at[f] = at;
+        at = ds->fields & FIELD_BIT(f) ? ALIGN8(at + column) : at;
+    }
+    header->size = at;
+
+    if (posix_fallocate(fd, 0, (off_t)header->size) != 0)
+    {
+        return 1;
+    }
+    base = (char *)mmap(NULL, header->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        return 1;
+    }
+    memcpy(base + header->pool_at, ds->pool, ds->pool_size);
+    memcpy(base + header->offsets_at, ds->offsets, ds->nstrings * sizeof(uint64_t));
+    for (f = 0; f < FIELD_COUNT; f++)
+    {
+        if (ds->fields & FIELD_BIT(f) && column > 0)
+        {
+            memcpy(base + header->columns_at[f], ds->columns[f], column);
+        }
+    }
+    memcpy(base, header, sizeof(header_t));
+    __atomic_store_n(&((header_t *)base)->ready, SEGMENT_READY, __ATOMIC_RELEASE);
+    munmap(base, header->size);
+    return 0;
+}
+
+/**
+ * Function:  write_segment
+ * ------------------------
+ * @brief  Parses an input into a segment this process has just created, then attaches to it.
+ *
+ * If the segment cannot be filled, it is marked abandoned and unlinked, and
+ * the dataset keeps the private copy that was parsed.
+ *
+ * @param ds The dataset to fill.
+ * @param spec The route file, directory of shards or pattern of shards.
+ * @param name The segment's name.
+ * @param fd The segment.
+ * @param stamp The stamp of the input.
+ *
+ * @return int 0: No errors; 1: The input could not be read.
+ *
+ */
+static int write_segment(dataset_t *ds, const char *spec, const char *name, int fd, uint64_t stamp)
+{
+    uint32_t abandoned = SEGMENT_ABANDONED;
+    header_t header;
+    int written;
+
+    // the header goes first, so that waiting processes know whom they wait for
+    memset(&header, 0, sizeof(header_t));
+    header.magic = SEGMENT_MAGIC;
+    header.version = SEGMENT_VERSION;
+    header.ready = SEGMENT_WRITING;
+    header.writer = (int64_t)getpid();
+    header.stamp = stamp;
+    written = write(fd, &header, sizeof(header_t)) == (ssize_t)sizeof(header_t);
+
+    if (dataset_load_sharded(ds, spec, ALL_FIELDS) != 0)
+    {
+        pwrite(fd, &abandoned, sizeof(abandoned), offsetof(header_t, ready));
+        shm_unlink(name);
+        close(fd);
+        return 1;
+    }
+    if (!written || publish(fd, ds, &header) != 0)
+    {
+        pwrite(fd, &abandoned, sizeof(abandoned), offsetof(header_t, ready));
+        shm_unlink(name);
+        close(fd);
+        return 0;
+    }
+
+    // the private copy goes, so this process shares the pages like the others
+    dataset_free(ds);
+    written = attach(ds, fd, &header) == 0;
+    close(fd);
+    return written ? 0 : dataset_load_sharded(ds, spec, ALL_FIELDS);
+}
+
+/**
+ * Function:  wait_ready
+ * ---------------------
+ * @brief  Waits until another process has filled a segment, or has given up on it.
+ *
+ * @param fd The segment.
+ * @param header Set to its header.
+ *
+ * @return int 0: The segment is ready; 1: It was abandoned, its writer died, or it is not a segment of this version.
+ *
+ */
+static int wait_ready(int fd, header_t *header)
+{
+    struct timespec pause = {0, 1000000};
+    struct stat info;
+    header_t *mapped;
+    uint32_t ready;
+    int waited;
+
+    memset(header, 0, sizeof(header_t));
+    for (waited = 0;; waited++)
+    {
+        if (fstat(fd, &info) != 0)
+        {
+            return 1;
+        }
+        if ((size_t)info.st_size >= sizeof(header_t))
+        {
+            mapped = (header_t *)mmap(NULL, sizeof(header_t), PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                return 1;
+            }
+            ready = __atomic_load_n(&mapped->ready, __ATOMIC_ACQUIRE);
+            memcpy(header, mapped, sizeof(header_t));
+            munmap(mapped, sizeof(header_t));
+
+            if (header->magic != 0 && (header->magic != SEGMENT_MAGIC || header->version != SEGMENT_VERSION))
+            {
+                return 1;
+            }
+            if (ready == SEGMENT_READY)
+            {
+                return 0;
+            }
+            if (ready == SEGMENT_ABANDONED ||
+                (header->magic != 0 && kill((pid_t)header->writer, 0) != 0 && errno == ESRCH))
+            {
+                return 1;
+            }
+        }
+        if (header->magic == 0 && waited > SEGMENT_HEADER_WAIT_MS)
+        {
+            return 1;
+        }
+        nanosleep(&pause, NULL);
+    }
+}
+
+/**
+ * Function:  segment_open
+ * -----------------------
+ * @brief  Attaches to the shared copy of a parsed input, parsing and publishing it first if there is none.
+ *
+ * Every field is loaded. If shared memory cannot be used, the input is
+ * parsed into a private table as dataset_load_sharded() does. A table
+ * attached to a segment is freed with dataset_free() like any other; the
+ * segment stays for the next process.
+ *
+ * @param ds The table to fill.
+ * @param spec The route file, a directory of shards, or a glob(7) pattern of shards.
+ *
+ * @return int 0: No errors; 1: No file was found or one could not be read.
+ *
+ */
+int segment_open(dataset_t *ds, const char *spec)
+{
+    char name[SEGMENT_NAME_LENGTH];
+    struct stat info;
+    header_t header;
+    uint64_t stamp;
+    int fd, attempt, failed;
+
+    // standard input and missing files have no stamp: they are read (or fail) privately
+    memset(ds, 0, sizeof(dataset_t));
+    if (input_stamp(spec, &stamp) != 0)
+    {
+        return dataset_load_sharded(ds, spec, ALL_FIELDS);
+    }
+    segment_name(name, spec);
+
+    for (attempt = 0; attempt < SEGMENT_ATTEMPTS; attempt++)
+    {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd >= 0)
+        {
+            return write_segment(ds, spec, name, fd, stamp);
+        }
+        if (errno != EEXIST)
+        {
+            break;
+        }
+        fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0)
+        {
+            continue; // unlinked meanwhile: try to create it again
+        }
+        if (fstat(fd, &info) != 0 || info.st_uid != geteuid())
+        {
+            // another user's object is neither trusted nor ours to replace
+            close(fd);
+            break;
+        }
+        if (wait_ready(fd, &header) == 0 && header.stamp == stamp)
+        {
+            failed = attach(ds, fd, &header);
+            close(fd);
+            if (!failed)
+            {
+                return 0;
+            }
+            break;
+        }
+
+        // stale, abandoned or of another version: replace it
+        close(fd);
+        shm_unlink(name);
+    }
+    return dataset_load_sharded(ds, spec, ALL_FIELDS);
+}
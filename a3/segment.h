@@ -0,0 +1,19 @@
+/** @file segment.h
+ *  @brief Function prototypes for sharing a parsed route file between processes.
+ *
+ */
+#ifndef _SEGMENT_H_
+#define _SEGMENT_H_
+
+#include "dataset.h"
+
+// "/routemanager-" and 16 hex digits
+#define SEGMENT_NAME_LENGTH 32
+
+/**
+ * Function protypes associated with shared datasets.
+ */
+void segment_name(char *name, const char *spec);
+int segment_open(dataset_t *, const char *spec);
+
+#endif
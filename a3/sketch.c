@@ -0,0 +1,409 @@
+/** @file sketch.c
+ *  @brief Implementation of sketch.h
+ *
+ * Space-Saving (Metwally et al.) keeps the capacity most frequent keys seen
+ * so far. A key that is not monitored replaces the counter with the smallest
+ * count and inherits that count as its error. Any key occurring more than
+ * total / capacity times is guaranteed to be monitored.
+ *
+ * The optional Count-Min sketch sees every key as well and gives a second,
+ * independent upper bound that tightens the estimate of replaced counters.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "hash.h"
+#include "sketch.h"
+
+/**
+ * Function:  cm_new
+ * -----------------
+ * @brief  Allocates an empty Count-Min sketch.
+ *
+ * @param width The number of counters in each row.
+ *
+ * @return cm_t* The new sketch.
+ *
+ */
+static cm_t *cm_new(int width)
+{
+    cm_t *cm = (cm_t *)emalloc_as(MEM_INDEXES, sizeof(cm_t));
+
+    cm->width = width;
+    cm->cells = (int *)emalloc_as(MEM_INDEXES, CM_DEPTH * width * sizeof(int));
+    memset(cm->cells, 0, CM_DEPTH * width * sizeof(int));
+
+    return cm;
+}
+
+/**
+ * Function:  cm_add
+ * -----------------
+ * @brief  Counts one occurrence of a key in every row of a Count-Min sketch.
+ *
+ * @param cm The sketch.
+ * @param key The key to count.
+ *
+ */
+static void cm_add(cm_t *cm, const char *key)
+{
+    size_t len = strlen(key);
+    int row;
+
+    for (row = 0; row < CM_DEPTH; row++)
+    {
+        cm->cells[row * cm->width + hash_bytes(key, len, row + 1) % cm->width]++;
+    }
+}
+
+/**
+ * Function:  cm_estimate
+ * ----------------------
+ * @brief  Returns the Count-Min upper bound for a key.
+ *
+ * @param cm The sketch.
+ * @param key The key to look up.
+ *
+ * @return int The smallest of the key's counters.
+ *
+ */
+static int cm_estimate(cm_t *cm, const char *key)
+{
+    size_t len = strlen(key);
+    int best = -1;
+    int row, cell;
+
+    for (row = 0; row < CM_DEPTH; row++)
+    {
+        cell = cm->cells[row * cm->width + hash_bytes(key, len, row + 1) % cm->width];
+        if (best < 0 || cell < best)
+        {
+            best = cell;
+        }
+    }
+    return best;
+}
+
+/**
+ * Function:  ss_new
+ * -----------------
+ * @brief  Allocates an empty Space-Saving summary.
+ *
+ * @param capacity The number of keys to monitor.
+ * @param cm_width The row width of the backing Count-Min sketch (0 for none).
+ *
+ * @return ss_t* The new summary.
+ *
+ */
+ss_t *ss_new(int capacity, int cm_width)
+{
+    ss_t *ss = (ss_t *)emalloc_as(MEM_INDEXES, sizeof(ss_t));
+    int nslots = 1;
+    int i;
+
+    // keep the index at most half full
+    while (nslots < 2 * capacity)
+    {
+        nslots *= 2;
+    }
+
+    ss->counters = (ss_counter_t *)emalloc_as(MEM_INDEXES, capacity * sizeof(ss_counter_t));
+    ss->capacity = capacity;
+    ss->size = 0;
+    ss->heap = (int *)emalloc_as(MEM_INDEXES, capacity * sizeof(int));
+    ss->pos = (int *)emalloc_as(MEM_INDEXES, capacity * sizeof(int));
+    ss->slots = (int *)emalloc_as(MEM_INDEXES, nslots * sizeof(int));
+    ss->mask = nslots - 1;
+    ss->total = 0;
+    ss->cm = cm_width > 0 ? cm_new(cm_width) : NULL;
+
+    for (i = 0; i < nslots; i++)
+    {
+        ss->slots[i] = -1;
+    }
+
+    return ss;
+}
+
+/**
+ * Function:  sift_down
+ * --------------------
+ * @brief  Moves a counter down the min-heap after its count grew.
+ *
+ * @param ss The summary.
+ * @param i The heap slot to sift down from.
+ *
+ */
+static void sift_down(ss_t *ss, int i)
+{
+    int smallest, left, right, temp;
+
+    for (;;)
+    {
+        smallest = i;
+        left = 2 * i + 1;
+        right = left + 1;
+
+        if (left < ss->size && ss->counters[ss->heap[left]].count < ss->counters[ss->heap[smallest]].count)
+        {
+            smallest = left;
+        }
+        if (right < ss->size && ss->counters[ss->heap[right]].count < ss->counters[ss->heap[smallest]].count)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+
+        temp = ss->heap[i];
+        ss->heap[i] = ss->heap[smallest];
+        ss->heap[smallest] = temp;
+        ss->pos[ss->heap[i]] = i;
+        ss->pos[ss->heap[smallest]] = smallest;
+        i = smallest;
+    }
+}
+
+/**
+ * Function:  sift_up
+ * ------------------
+ * @brief  Moves a newly inserted counter up the min-heap.
+ *
+ * @param ss The summary.
+ * @param i The heap slot to sift up from.
+ *
+ */
+static void sift_up(ss_t *ss, int i)
+{
+    int parent, temp;
+
+    while (i > 0)
+    {
+        parent = (i - 1) / 2;
+        if (ss->counters[ss->heap[parent]].count <= ss->counters[ss->heap[i]].count)
+        {
+            return;
+        }
+
+        temp = ss->heap[i];
+        ss->heap[i] = ss->heap[parent];
+        ss->heap[parent] = temp;
+        ss->pos[ss->heap[i]] = i;
+        ss->pos[ss->heap[parent]] = parent;
+        i = parent;
+    }
+}
+
+/**
+ * Function:  find_slot
+ * --------------------
+ * @brief  Finds the index slot holding a key, or the empty slot where it would go.
+ *
+ * @param ss The summary.
+ * @param key The key to look for.
+ * @param hash The hash of key.
+ *
+ * @return int The slot number.
+ *
+ */
+static int find_slot(ss_t *ss, const char *key, uint64_t hash)
+{
+    int slot = hash & ss->mask;
+    ss_counter_t *c;
+
+    while (ss->slots[slot] != -1)
+    {
+        c = &ss->counters[ss->slots[slot]];
+        if (c->hash == hash && strcmp(c->key, key) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & ss->mask;
+    }
+    return slot;
+}
+
+/**
+ * Function:  remove_slot
+ * ----------------------
+ * @brief  Empties an index slot, shifting later entries of its probe run back.
+ *
+ * @param ss The summary.
+ * @param slot The slot to empty.
+ *
+ */
+static void remove_slot(ss_t *ss, int slot)
+{
+    int next = slot;
+    int home;
+
+    for (;;)
+    {
+        next = (next + 1) & ss->mask;
+        if (ss->slots[next] == -1)
+        {
+            break;
+        }
+        home = ss->counters[ss->slots[next]].hash & ss->mask;
+
+        // leave the entry where it is if its home lies cyclically in (slot, next]
+        if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next))
+        {
+            continue;
+        }
+        ss->slots[slot] = ss->slots[next];
+        slot = next;
+    }
+    ss->slots[slot] = -1;
+}
+
+/**
+ * Function:  ss_add
+ * -----------------
+ * @brief  Counts one occurrence of a key.
+ *
+ * @param ss The summary.
+ * @param key The key to count.
+ *
+ */
+void ss_add(ss_t *ss, const char *key)
+{
+    uint64_t hash = hash_string(key);
+    int slot = find_slot(ss, key, hash);
+    ss_counter_t *c;
+    int i;
+
+    ss->total++;
+    if (ss->cm != NULL)
+    {
+        cm_add(ss->cm, key);
+    }
+
+    if (ss->slots[slot] != -1)
+    {
+        i = ss->slots[slot];
+        ss->counters[i].count++;
+        sift_down(ss, ss->pos[i]);
+        return;
+    }
+
+    if (ss->size < ss->capacity)
+    {
+        i = ss->size++;
+        c = &ss->counters[i];
+        c->key = estrdup(MEM_NODE_STRINGS, key);
+        c->hash = hash;
+        c->count = 1;
+        c->error = 0;
+
+        ss->heap[i] = i;
+        ss->pos[i] = i;
+        ss->slots[slot] = i;
+        sift_up(ss, i);
+        return;
+    }
+
+    // replace the least frequent key, which hands its count over as error
+    i = ss->heap[0];
+    c = &ss->counters[i];
+    remove_slot(ss, find_slot(ss, c->key, c->hash));
+    efree(c->key);
+
+    c->key = estrdup(MEM_NODE_STRINGS, key);
+    c->hash = hash;
+    c->error = c->count;
+    c->count++;
+    ss->slots[find_slot(ss, key, hash)] = i;
+    sift_down(ss, 0);
+}
+
+/**
+ * Function:  compare_keys
+ * -----------------------
+ * @brief  qsort() comparator ordering counters by key.
+ *
+ * @param a The first counter.
+ * @param b The second counter.
+ *
+ * @return int The strcmp() of the two keys.
+ *
+ */
+static int compare_keys(const void *a, const void *b)
+{
+    return strcmp((*(ss_counter_t *const *)a)->key, (*(ss_counter_t *const *)b)->key);
+}
+
+/**
+ * Function:  ss_report
+ * --------------------
+ * @brief  Reports every monitored key in strcmp() order with its estimate and error bound.
+ *
+ * The estimate is the smallest upper bound known for the key, and the error
+ * is how far above the true count it can be.
+ *
+ * @param ss The summary.
+ * @param fn The function called once per monitored key.
+ * @param arg The argument passed through to fn.
+ *
+ */
+void ss_report(ss_t *ss, void (*fn)(char *key, int estimate, int error, void *), void *arg)
+{
+    ss_counter_t **sorted = (ss_counter_t **)emalloc((ss->size + 1) * sizeof(ss_counter_t *));
+    int estimate, lower, upper;
+    int i;
+
+    for (i = 0; i < ss->size; i++)
+    {
+        sorted[i] = &ss->counters[i];
+    }
+    qsort(sorted, ss->size, sizeof(ss_counter_t *), compare_keys);
+
+    for (i = 0; i < ss->size; i++)
+    {
+        estimate = sorted[i]->count;
+        lower = sorted[i]->count - sorted[i]->error;
+        if (ss->cm != NULL)
+        {
+            upper = cm_estimate(ss->cm, sorted[i]->key);
+            if (upper < estimate)
+            {
+                estimate = upper;
+            }
+        }
+        fn(sorted[i]->key, estimate, estimate - lower, arg);
+    }
+
+    efree(sorted);
+}
+
+/**
+ * Function:  ss_free
+ * ------------------
+ * @brief  Releases a summary and its Count-Min sketch.
+ *
+ * @param ss The summary.
+ *
+ */
+void ss_free(ss_t *ss)
+{
+    int i;
+
+    for (i = 0; i < ss->size; i++)
+    {
+        efree(ss->counters[i].key);
+    }
+    if (ss->cm != NULL)
+    {
+        efree(ss->cm->cells);
+        efree(ss->cm);
+    }
+    efree(ss->counters);
+    efree(ss->heap);
+    efree(ss->pos);
+    efree(ss->slots);
+    efree(ss);
+}
@@ -0,0 +1,63 @@
+/** @file sketch.h
+ *  @brief Function prototypes for the fixed-memory frequency sketches.
+ *
+ */
+#ifndef _SKETCH_H_
+#define _SKETCH_H_
+
+#include <stdint.h>
+
+#define CM_DEPTH 4
+
+/**
+ * @brief One monitored key of a Space-Saving summary.
+ *
+ * The true number of occurrences of key lies in [count - error, count].
+ */
+typedef struct
+{
+    char *key;
+    uint64_t hash;
+    int count;
+    int error;
+} ss_counter_t;
+
+/**
+ * @brief A Count-Min sketch of CM_DEPTH rows of width counters.
+ */
+typedef struct
+{
+    int width;
+    int *cells;
+} cm_t;
+
+/**
+ * @brief A Space-Saving heavy-hitters summary over at most capacity keys.
+ *
+ * Counters sit in a min-heap on count so the least frequent one can be
+ * replaced in O(log capacity), and an open-addressing index finds the
+ * counter of a key in O(1). Memory depends only on capacity (and the
+ * optional Count-Min width), never on the number of keys added.
+ */
+typedef struct
+{
+    ss_counter_t *counters;
+    int capacity;
+    int size;
+    int *heap;
+    int *pos;
+    int *slots;
+    int mask;
+    long total;
+    cm_t *cm;
+} ss_t;
+
+/**
+ * Function protypes associated with the sketches.
+ */
+ss_t *ss_new(int capacity, int cm_width);
+void ss_add(ss_t *, const char *key);
+void ss_report(ss_t *, void (*fn)(char *key, int estimate, int error, void *), void *arg);
+void ss_free(ss_t *);
+
+#endif
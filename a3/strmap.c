@@ -0,0 +1,223 @@
+/** @file strmap.c
+ *  @brief Implementation of strmap.h
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "hash.h"
+#include "strmap.h"
+
+/**
+ * Function:  strmap_init
+ * ----------------------
+ * @brief  Prepares an empty map.
+ *
+ * @param map The map to initialise.
+ * @param hint The number of keys expected (the map grows past it if needed).
+ *
+ */
+void strmap_init(strmap_t *map, size_t hint)
+{
+    size_t cap = 16;
+
+    while (cap < 2 * hint)
+    {
+        cap *= 2;
+    }
+
+    map->entries = (strmap_entry_t *)emalloc_as(MEM_INDEXES, cap * sizeof(strmap_entry_t));
+    memset(map->entries, 0, cap * sizeof(strmap_entry_t));
+    map->size = 0;
+    map->cap = cap;
+}
+
+/**
+ * Function:  probe
+ * ----------------
+ * @brief  Finds the slot holding a key, or the empty slot where it would go.
+ *
+ * @param map The map to search.
+ * @param key The key to look for.
+ * @param hash The hash of key.
+ *
+ * @return strmap_entry_t* The slot.
+ *
+ */
+static strmap_entry_t *probe(strmap_t *map, const char *key, uint64_t hash)
+{
+    size_t mask = map->cap - 1;
+    size_t i = hash & mask;
+
+    while (map->entries[i].key != NULL)
+    {
+        if (map->entries[i].hash == hash && strcmp(map->entries[i].key, key) == 0)
+        {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return &map->entries[i];
+}
+
+/**
+ * Function:  grow
+ * ---------------
+ * @brief  Doubles the table and re-inserts every entry.
+ *
+ * @param map The map to grow.
+ *
+ */
+static void grow(strmap_t *map)
+{
+    strmap_entry_t *old = map->entries;
+    size_t old_cap = map->cap;
+    size_t mask, i, j;
+
+    map->cap *= 2;
+    mask = map->cap - 1;
+    map->entries = (strmap_entry_t *)emalloc_as(MEM_INDEXES, map->cap * sizeof(strmap_entry_t));
+    memset(map->entries, 0, map->cap * sizeof(strmap_entry_t));
+
+    for (i = 0; i < old_cap; i++)
+    {
+        if (old[i].key == NULL)
+        {
+            continue;
+        }
+        for (j = old[i].hash & mask; map->entries[j].key != NULL; j = (j + 1) & mask)
+            ;
+        map->entries[j] = old[i];
+    }
+    efree(old);
+}
+
+/**
+ * Function:  strmap_find
+ * ----------------------
+ * @brief  Looks up a key.
+ *
+ * @param map The map to search.
+ * @param key The key to look for.
+ *
+ * @return strmap_entry_t* The entry of the key, or NULL if it is not in the map.
+ *
+ */
+strmap_entry_t *strmap_find(strmap_t *map, const char *key)
+{
+    strmap_entry_t *e = probe(map, key, hash_string(key));
+
+    return e->key != NULL ? e : NULL;
+}
+
+/**
+ * Function:  strmap_insert
+ * ------------------------
+ * @brief  Looks up a key, adding it with a NULL value if it is missing.
+ *
+ * @param map The map to add to.
+ * @param key The key to look for.
+ * @param created Set to 1 if the key was added, 0 if it already existed (may be NULL).
+ *
+ * @return strmap_entry_t* The entry of the key; valid until the next insertion.
+ *
+ */
+strmap_entry_t *strmap_insert(strmap_t *map, const char *key, int *created)
+{
+    uint64_t hash = hash_string(key);
+    strmap_entry_t *e = probe(map, key, hash);
+
+    if (created != NULL)
+    {
+        *created = e->key == NULL;
+    }
+    if (e->key != NULL)
+    {
+        return e;
+    }
+
+    if (2 * (map->size + 1) > map->cap)
+    {
+        grow(map);
+        e = probe(map, key, hash);
+    }
+    e->key = estrdup(MEM_NODE_STRINGS, key);
+    e->hash = hash;
+    e->value = NULL;
+    map->size++;
+
+    return e;
+}
+
+/**
+ * Function:  compare_entries
+ * --------------------------
+ * @brief  qsort() comparator ordering entry pointers by key.
+ *
+ * @param a The first entry.
+ * @param b The second entry.
+ *
+ * @return int The strcmp() of the two keys.
+ *
+ */
+static int compare_entries(const void *a, const void *b)
+{
+    return strcmp((*(strmap_entry_t *const *)a)->key, (*(strmap_entry_t *const *)b)->key);
+}
+
+/**
+ * Function:  strmap_sorted
+ * ------------------------
+ * @brief  Lists the entries of a map in strcmp() order of their keys.
+ *
+ * @param map The map to list.
+ *
+ * @return strmap_entry_t** An array of map->size entries; the caller frees it with efree().
+ *
+ */
+strmap_entry_t **strmap_sorted(strmap_t *map)
+{
+    strmap_entry_t **sorted = (strmap_entry_t **)emalloc((map->size + 1) * sizeof(strmap_entry_t *));
+    size_t i, n = 0;
+
+    for (i = 0; i < map->cap; i++)
+    {
+        if (map->entries[i].key != NULL)
+        {
+            sorted[n++] = &map->entries[i];
+        }
+    }
+    qsort(sorted, n, sizeof(strmap_entry_t *), compare_entries);
+
+    return sorted;
+}
+
+/**
+ * Function:  strmap_free
+ * ----------------------
+ * @brief  Releases a map, its keys and optionally its values.
+ *
+ * @param map The map to release.
+ * @param free_value Called on every value (NULL to leave the values alone).
+ *
+ */
+void strmap_free(strmap_t *map, void (*free_value)(void *))
+{
+    size_t i;
+
+    for (i = 0; i < map->cap; i++)
+    {
+        if (map->entries[i].key != NULL)
+        {
+            if (free_value != NULL)
+            {
+                free_value(map->entries[i].value);
+            }
+            efree(map->entries[i].key);
+        }
+    }
+    efree(map->entries);
+    map->entries = NULL;
+    map->size = 0;
+    map->cap = 0;
+}
@@ -0,0 +1,43 @@
+/** @file strmap.h
+ *  @brief Function prototypes for the string-keyed hash map.
+ *
+ */
+#ifndef _STRMAP_H_
+#define _STRMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief One slot of a string map; key is NULL for empty slots.
+ */
+typedef struct
+{
+    char *key;
+    uint64_t hash;
+    void *value;
+} strmap_entry_t;
+
+/**
+ * @brief An open-addressing hash map from strings to pointers.
+ *
+ * The map owns copies of its keys. Entries are never removed, and the
+ * table doubles whenever it becomes more than half full.
+ */
+typedef struct
+{
+    strmap_entry_t *entries;
+    size_t size;
+    size_t cap;
+} strmap_t;
+
+/**
+ * Function protypes associated with a string map.
+ */
+void strmap_init(strmap_t *, size_t hint);
+strmap_entry_t *strmap_find(strmap_t *, const char *key);
+strmap_entry_t *strmap_insert(strmap_t *, const char *key, int *created);
+strmap_entry_t **strmap_sorted(strmap_t *);
+void strmap_free(strmap_t *, void (*free_value)(void *));
+
+#endif